@@ -0,0 +1,105 @@
+
+#include "anyscheduler.h"
+#include "checkpoint.h"
+
+namespace
+{
+    template <typename Policy>
+    class SchedulerModel : public AnyScheduler
+    {
+    public:
+        SchedulerModel(unsigned numprocs, unsigned groupsize) : sch(numprocs, groupsize) {}
+
+        const char* policyName() const override                                 { return Policy::name();                }
+
+        bool        addJob(const JobInfo& jobinfo) override                     { return sch.addJob(jobinfo);           }
+        std::size_t addJobs(const JobInfo* jobs, std::size_t count) override    { return sch.addJobs(jobs, count);      }
+        jobid_t     submitJob(const JobInfo& jobinfo) override                  { return sch.submitJob(jobinfo);        }
+
+        void        tick() override                                             { sch.tick();                           }
+        void        advance(tick_t ticks) override                              { sch.advance(ticks);                   }
+        void        drain() override                                            { sch.drain();                          }
+        void        schedule() override                                         { sch.schedule();                       }
+        bool        finishJob(jobid_t id) override                              { return sch.finishJob(id);             }
+        bool        cancelJob(jobid_t id) override                              { return sch.cancelJob(id);             }
+        bool        updateJob(jobid_t id, unsigned numTicks, unsigned numProcs) override    { return sch.updateJob(id, numTicks, numProcs);     }
+        tick_t      nextCompletion() const override                             { return sch.nextCompletion();          }
+
+        unsigned    numProcs() const override                                   { return sch.numProcs();                }
+        tick_t      now() const override                                        { return sch.now();                     }
+        bool        idle() const override                                       { return sch.idle();                    }
+        double      fragmentation() const override                              { return sch.fragmentation();           }
+        JobState    getJobState(jobid_t id) const override                      { return sch.getJobState(id);           }
+        const std::string&  getDescription(const ScheduledJob& job) const override  { return sch.getDescription(job);   }
+        bool        queuePosition(jobid_t id, std::size_t& pos) const override  { return sch.queuePosition(id, pos);    }
+        bool        jobsAhead(jobid_t id, unsigned maxProcs, std::size_t& count) const override     { return sch.jobsAhead(id, maxProcs, count);    }
+        void        setJobHandler(std::function<void(EventKind, const ScheduledJob&)> fn) override      { sch.setJobHandler(std::move(fn));     }
+
+        void        saveCheckpoint(const std::string& path) override            { sch.saveCheckpoint(path);             }
+        void        loadCheckpoint(const std::string& path) override            { sch.loadCheckpoint(path);             }
+
+        void        openEventLog(const std::string& path, const EventLogOptions& opts) override   { sch.openEventLog(path, opts);   }
+        EventLogStats   closeEventLog() override                                { return sch.closeEventLog();           }
+        EventLogStats   eventLogStats() const override                          { return sch.eventLogStats();           }
+
+        void        dumpActiveJobs(DumpWriter& out, DumpFormat fmt, std::size_t limit) const override  { sch.dumpActiveJobs(out, fmt, limit);   }
+        void        dumpWaitQueue(DumpWriter& out, DumpFormat fmt, std::size_t limit) const override   { sch.dumpWaitQueue(out, fmt, limit);    }
+
+        SchedulerStats  getStats() const override                               { return sch.getStats();                }
+        void        resetStats() override                                       { sch.resetStats();                     }
+        void        dumpStats(DumpWriter& out) const override                   { sch.dumpStats(out);                   }
+
+        SchedulerMetrics    getMetrics() const override                         { return sch.getMetrics();              }
+        void        resetMetrics() override                                     { sch.resetMetrics();                   }
+        void        dumpMetrics(DumpWriter& out) const override                 { sch.dumpMetrics(out);                 }
+
+    private:
+        BasicScheduler<Policy>  sch;
+    };
+
+    struct PolicyEntry
+    {
+        const char*     name;
+        std::unique_ptr<AnyScheduler>   (*make)(unsigned numprocs, unsigned groupsize);
+    };
+
+    template <typename Policy>
+    std::unique_ptr<AnyScheduler> make(unsigned numprocs, unsigned groupsize)
+    {
+        return std::unique_ptr<AnyScheduler>( new SchedulerModel<Policy>(numprocs, groupsize) );
+    }
+
+    // Every policy scheduler.cpp instantiates, default first
+    const PolicyEntry policies[] = {
+        { ShortestJobFirst::name(),         &make<ShortestJobFirst>         },
+        { FirstComeFirstServed::name(),     &make<FirstComeFirstServed>     },
+        { FairShare::name(),                &make<FairShare>                },
+        { EasyBackfill::name(),             &make<EasyBackfill>             },
+    };
+}
+
+std::unique_ptr<AnyScheduler> makeScheduler(const std::string& policy, unsigned numprocs, unsigned groupsize)
+{
+    for(auto& p : policies)
+    {
+        if(policy == p.name)
+            return p.make(numprocs, groupsize);
+    }
+    throw SchedulerException("Unknown scheduling policy '" + policy + "'");
+}
+
+std::unique_ptr<AnyScheduler> restoreScheduler(const std::string& path)
+{
+    CheckpointHeader hdr = readCheckpointHeader(path);
+    auto sch = makeScheduler(hdr.policy, hdr.numProcs, hdr.groupSize);
+    sch->loadCheckpoint(path);
+    return sch;
+}
+
+std::vector<std::string> schedulerPolicies()
+{
+    std::vector<std::string> names;
+    for(auto& p : policies)
+        names.push_back(p.name);
+    return names;
+}
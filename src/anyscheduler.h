@@ -0,0 +1,73 @@
+
+#ifndef ANYSCHEDULER_H_INCLUDED
+#define ANYSCHEDULER_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "scheduler.h"
+
+//  AnyScheduler is a BasicScheduler whose policy is picked at run time (by name, with
+//  makeScheduler).  Only the calls into the scheduler are virtual.  Each one does a whole batch
+//  of work, and everything inside it is still compiled for the one policy.
+class AnyScheduler
+{
+public:
+    virtual ~AnyScheduler() {}
+
+    virtual const char* policyName() const = 0;
+
+    virtual bool        addJob(const JobInfo& jobinfo) = 0;
+    virtual std::size_t addJobs(const JobInfo* jobs, std::size_t count) = 0;
+    virtual jobid_t     submitJob(const JobInfo& jobinfo) = 0;
+
+    virtual void        tick() = 0;
+    virtual void        advance(tick_t ticks) = 0;
+    virtual void        drain() = 0;
+    virtual void        schedule() = 0;
+    virtual bool        finishJob(jobid_t id) = 0;
+    virtual bool        cancelJob(jobid_t id) = 0;
+    virtual bool        updateJob(jobid_t id, unsigned numTicks, unsigned numProcs) = 0;
+    virtual tick_t      nextCompletion() const = 0;
+
+    virtual unsigned    numProcs() const = 0;
+    virtual tick_t      now() const = 0;
+    virtual bool        idle() const = 0;
+    virtual double      fragmentation() const = 0;
+    virtual JobState    getJobState(jobid_t id) const = 0;
+    virtual const std::string&  getDescription(const ScheduledJob& job) const = 0;
+    virtual bool        queuePosition(jobid_t id, std::size_t& pos) const = 0;
+    virtual bool        jobsAhead(jobid_t id, unsigned maxProcs, std::size_t& count) const = 0;
+    virtual void        setJobHandler(std::function<void(EventKind, const ScheduledJob&)> fn) = 0;
+
+    virtual void        saveCheckpoint(const std::string& path) = 0;
+    virtual void        loadCheckpoint(const std::string& path) = 0;
+
+    virtual void            openEventLog(const std::string& path, const EventLogOptions& opts = EventLogOptions()) = 0;
+    virtual EventLogStats   closeEventLog() = 0;
+    virtual EventLogStats   eventLogStats() const = 0;
+
+    virtual void        dumpActiveJobs(DumpWriter& out, DumpFormat fmt = DumpFormat::Table, std::size_t limit = DumpAll) const = 0;
+    virtual void        dumpWaitQueue(DumpWriter& out, DumpFormat fmt = DumpFormat::Table, std::size_t limit = DumpAll) const = 0;
+
+    virtual SchedulerStats  getStats() const = 0;
+    virtual void        resetStats() = 0;
+    virtual void        dumpStats(DumpWriter& out) const = 0;
+
+    virtual SchedulerMetrics    getMetrics() const = 0;
+    virtual void        resetMetrics() = 0;
+    virtual void        dumpMetrics(DumpWriter& out) const = 0;
+};
+
+// Builds a scheduler with the named policy ("sjf", "fcfs", "fairshare", "easy" -- see
+//   schedulerPolicies).  Throws SchedulerException for an unknown name.
+std::unique_ptr<AnyScheduler>   makeScheduler(const std::string& policy, unsigned numprocs, unsigned groupsize = 0);
+
+// Builds a scheduler with the policy and processors a checkpoint was saved with, and loads it.
+//   Throws SchedulerException if the checkpoint can't be read or restored.
+std::unique_ptr<AnyScheduler>   restoreScheduler(const std::string& path);
+
+// Every name makeScheduler accepts, default first
+std::vector<std::string>        schedulerPolicies();
+
+#endif
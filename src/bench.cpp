@@ -0,0 +1,533 @@
+
+//  Scheduler microbenchmarks.
+//
+//  Runs reproducible synthetic workloads through Scheduler, compares TreeList and BlockList
+//  against std::multiset, and times checkpoints against rebuilding the queue job by job.  Every
+//  run uses a fixed seed, so numbers from two builds are directly comparable (build with
+//  'make QUEUE=block' to run the workloads on a BlockList wait queue).
+//
+//  Usage:   ./bench [max_jobs]         (max_jobs defaults to 100000, and can go up to 10000000)
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <functional>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+#include "scheduler.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define BENCH_HAVE_FORK
+#endif
+
+//////////////////////////////////////////////
+//  Allocation counting
+
+namespace
+{
+    std::uint64_t allocCount = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocCount;
+    if(void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size)                      { return operator new(size);    }
+void  operator delete(void* p) noexcept                     { std::free(p);                 }
+void  operator delete[](void* p) noexcept                   { std::free(p);                 }
+void  operator delete(void* p, std::size_t) noexcept        { std::free(p);                 }
+void  operator delete[](void* p, std::size_t) noexcept      { std::free(p);                 }
+
+namespace
+{
+    typedef std::chrono::steady_clock   Clock;
+
+    // Results that are only computed to be timed get stored here, so the work can't be optimized out
+    volatile std::uint64_t sink = 0;
+
+    double nsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    // Peak resident set size of this process, in MB (0 if we can't tell)
+    double peakRssMB()
+    {
+#if defined(BENCH_HAVE_FORK)
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+    #if defined(__APPLE__)
+        return ru.ru_maxrss / (1024.0 * 1024.0);
+    #else
+        return ru.ru_maxrss / 1024.0;
+    #endif
+#else
+        return 0;
+#endif
+    }
+
+    // Small, fully specified RNG (splitmix64) so workloads are identical on every platform
+    class Rng
+    {
+    public:
+        explicit Rng(std::uint64_t seed) : state(seed) {}
+
+        std::uint64_t next()
+        {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        double          uniform()                           { return (next() >> 11) * (1.0 / 9007199254740992.0);  }   // [0, 1)
+        unsigned        range(unsigned lo, unsigned hi)     { return lo + static_cast<unsigned>(next() % (hi - lo + 1));  }
+
+        // Pareto distribution with shape 'alpha' and minimum 'xm'
+        unsigned pareto(double alpha, double xm, unsigned cap)
+        {
+            double v = xm / std::pow(1.0 - uniform(), 1.0 / alpha);
+            return v >= cap ? cap : static_cast<unsigned>(std::ceil(v));
+        }
+
+    private:
+        std::uint64_t   state;
+    };
+
+    //////////////////////////////////////////////
+    //  Workloads
+
+    const unsigned  machineProcs = 1024;
+    const double    targetLoad = 0.9;           // offered load, as a fraction of the machine
+
+    struct Arrival
+    {
+        tick_t      tick;
+        unsigned    numProcs;
+        unsigned    numTicks;
+    };
+
+    enum class LengthDist   { Uniform, Pareto };
+    enum class WidthDist    { Mixed, Narrow, Wide };
+
+    struct Workload
+    {
+        const char*     name;
+        LengthDist      length;
+        WidthDist       width;
+        unsigned        burst;          // jobs arriving on the same tick
+    };
+
+    const Workload workloads[] =
+    {
+        { "uniform",        LengthDist::Uniform,    WidthDist::Mixed,   1   },
+        { "pareto",         LengthDist::Pareto,     WidthDist::Mixed,   1   },
+        { "bursty",         LengthDist::Uniform,    WidthDist::Mixed,   500 },
+        { "narrow",         LengthDist::Uniform,    WidthDist::Narrow,  1   },
+        { "wide",           LengthDist::Uniform,    WidthDist::Wide,    1   },
+    };
+
+    std::vector<Arrival> makeWorkload(const Workload& w, std::size_t count)
+    {
+        Rng rng(12345);
+        std::vector<Arrival> out;
+        out.reserve(count);
+
+        double meanprocs = 0, meanticks = 0;
+        switch(w.width)
+        {
+        case WidthDist::Mixed:      meanprocs = (1 + 32) / 2.0;         break;
+        case WidthDist::Narrow:     meanprocs = (1 + 2) / 2.0;          break;
+        case WidthDist::Wide:       meanprocs = (128 + 512) / 2.0;      break;
+        }
+        meanticks = (w.length == LengthDist::Uniform) ? (1 + 200) / 2.0 : 30.0;
+
+        // average ticks between arrivals (or bursts) to hit the target load
+        double gap = w.burst * meanprocs * meanticks / (machineProcs * targetLoad);
+        double t = 0;
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(i % w.burst == 0)
+                t += gap * 2 * rng.uniform();
+
+            Arrival a;
+            a.tick = static_cast<tick_t>(t);
+            switch(w.width)
+            {
+            case WidthDist::Mixed:      a.numProcs = rng.range(1, 32);          break;
+            case WidthDist::Narrow:     a.numProcs = rng.range(1, 2);           break;
+            case WidthDist::Wide:       a.numProcs = rng.range(128, 512);       break;
+            }
+            a.numTicks = (w.length == LengthDist::Uniform) ? rng.range(1, 200) : rng.pareto(1.5, 10, 100000);
+            out.push_back(a);
+        }
+        return out;
+    }
+
+    //////////////////////////////////////////////
+    //  Scheduler benchmark
+
+    struct SchedResult
+    {
+        double          jobsPerSec;
+        double          nsPerAdd;
+        double          nsPerTick;
+        double          allocsPerJob;
+        double          peakRss;
+        tick_t          makespan;
+    };
+
+    SchedResult runScheduler(const std::vector<Arrival>& arrivals)
+    {
+        SchedResult res;
+        Scheduler sch(machineProcs);
+        JobInfo info;
+        info.description = "benchjob";
+
+        double addns = 0, advancens = 0;
+        auto allocs = allocCount;
+        auto start = Clock::now();
+
+        std::size_t i = 0;
+        while(i < arrivals.size())
+        {
+            tick_t at = arrivals[i].tick;
+            if(at > sch.now())
+            {
+                auto t = Clock::now();
+                sch.advance(at - sch.now());
+                advancens += nsSince(t);
+            }
+
+            auto t = Clock::now();
+            for(; i < arrivals.size() && arrivals[i].tick == at; ++i)
+            {
+                info.numProcs = arrivals[i].numProcs;
+                info.numTicks = arrivals[i].numTicks;
+                sch.addJob(info);
+            }
+            addns += nsSince(t);
+        }
+
+        auto t = Clock::now();
+        sch.drain();
+        advancens += nsSince(t);
+
+        double total = nsSince(start);
+        res.jobsPerSec = arrivals.size() / (total * 1e-9);
+        res.nsPerAdd = addns / arrivals.size();
+        res.nsPerTick = sch.now() ? advancens / sch.now() : 0;
+        res.allocsPerJob = static_cast<double>(allocCount - allocs) / arrivals.size();
+        res.peakRss = peakRssMB();
+        res.makespan = sch.now();
+        return res;
+    }
+
+    //////////////////////////////////////////////
+    //  Container benchmark
+
+    struct ContainerResult
+    {
+        double          nsPerInsert;
+        double          nsPerVisit;
+        double          nsPerScan;
+        double          nsPerErase;
+    };
+
+    // The same summary the scheduler keeps on its wait queue
+    struct ProcRange
+    {
+        struct value_type
+        {
+            unsigned        procs;
+            unsigned        maxProcs;
+        };
+        static value_type   value(const ScheduledJob& job)      { return value_type{job.numProcs, job.numProcs};        }
+        static value_type   value(const JobKey& key)            { return value_type{key.numProcs, key.numProcs};        }
+        static value_type   combine(value_type a, value_type b)
+        {
+            return value_type{ a.procs < b.procs ? a.procs : b.procs, a.maxProcs > b.maxProcs ? a.maxProcs : b.maxProcs };
+        }
+    };
+    struct JobKeyOf
+    {
+        typedef JobKey      key_type;
+        static JobKey       key(const ScheduledJob& job)        { return job.key();             }
+    };
+
+    typedef TreeList<ScheduledJob, TreeListRedBlack, PoolAllocator<ScheduledJob>, TreeListAggregate<ProcRange>>   treelist_t;
+    typedef BlockList<ScheduledJob, JobKeyOf, PoolAllocator<ScheduledJob>, BlockListSummary<ProcRange>>          blocklist_t;
+    typedef std::multiset<ScheduledJob>                                                                         multiset_t;
+
+    // What assignProcs does when only a few processors are free:  find every job in order that
+    //   fits in 'procs'
+    template <typename Container>
+    std::size_t countFits(Container& c, unsigned procs)
+    {
+        std::size_t found = 0;
+        auto pred = [procs](ProcRange::value_type s) { return s.procs <= procs; };
+        for(auto i = c.findNext(c.begin(), pred); i != c.end(); i = c.findNext(++i, pred))
+            ++found;
+        return found;
+    }
+
+    std::size_t countFits(multiset_t& c, unsigned procs)
+    {
+        std::size_t found = 0;
+        for(auto& i : c)
+            found += (i.numProcs <= procs) ? 1 : 0;
+        return found;
+    }
+
+    ScheduledJob makeJob(Rng& rng, jobid_t id)
+    {
+        ScheduledJob job;
+        job.numProcs = rng.range(1, 32);
+        job.numTicks = rng.range(1, 1000);
+        job.ticksRemaining = job.numTicks;
+        job.description = 0;
+        job.rank = job.ticksRemaining;      // ordered the way the default policy orders the wait queue
+        job.id = id;
+        return job;
+    }
+
+    // Insert 'count' jobs in random order, walk them in order, search them for jobs that fit on one
+    //   processor, then pop them all off the front.
+    template <typename Container>
+    ContainerResult runContainer(std::size_t count)
+    {
+        ContainerResult res;
+        Rng rng(777);
+        Container c;
+
+        auto t = Clock::now();
+        for(std::size_t i = 0; i < count; ++i)
+            c.insert( makeJob(rng, i + 1) );
+        res.nsPerInsert = nsSince(t) / count;
+
+        t = Clock::now();
+        std::uint64_t sum = 0;
+        for(auto& i : c)
+            sum += i.numProcs;
+        res.nsPerVisit = nsSince(t) / count;
+        sink = sum;
+
+        static const int scans = 10;
+        t = Clock::now();
+        std::size_t found = 0;
+        for(int i = 0; i < scans; ++i)
+            found += countFits(c, 1);
+        res.nsPerScan = nsSince(t) / (count * scans);
+        sink = found;
+
+        t = Clock::now();
+        while(!c.empty())
+            c.erase(c.begin());
+        res.nsPerErase = nsSince(t) / count;
+
+        return res;
+    }
+
+    //////////////////////////////////////////////
+    //  Checkpoint benchmark
+
+    struct CheckpointResult
+    {
+        double          nsPerAdd;           // building the queue from scratch (what a restart without a checkpoint costs)
+        double          nsPerSave;
+        double          nsPerLoad;
+        double          fileMB;
+    };
+
+    // Queues 'count' jobs (the machine's worth of them running), then saves the scheduler and
+    //   restores it into a new one
+    CheckpointResult runCheckpoint(std::size_t count)
+    {
+        static const char* path = "bench.ckpt";
+
+        CheckpointResult res;
+        Rng rng(4242);
+        std::vector<JobInfo> jobs(count);
+        for(auto& j : jobs)
+        {
+            j.description = "account" + std::to_string(rng.range(0, 99));
+            j.numProcs = rng.range(1, 32);
+            j.numTicks = rng.range(1, 1000);
+        }
+
+        Scheduler sch(machineProcs);
+        auto t = Clock::now();
+        for(auto& j : jobs)
+            sch.addJob(j);
+        sch.tick();
+        res.nsPerAdd = nsSince(t) / count;
+
+        t = Clock::now();
+        sch.saveCheckpoint(path);
+        res.nsPerSave = nsSince(t) / count;
+
+        Scheduler restored(machineProcs);
+        t = Clock::now();
+        restored.loadCheckpoint(path);
+        res.nsPerLoad = nsSince(t) / count;
+
+        std::FILE* f = std::fopen(path, "rb");
+        std::fseek(f, 0, SEEK_END);
+        res.fileMB = std::ftell(f) / (1024.0 * 1024.0);
+        std::fclose(f);
+        std::remove(path);
+        return res;
+    }
+
+    struct CancelResult
+    {
+        double          nsPerUpdate;        // a random queued job gets new ticks, and so a new place in the queue
+        double          nsPerCancel;
+    };
+
+    // Queues 'count' jobs, updates half of them and then cancels half, each picked at random
+    CancelResult runCancel(std::size_t count)
+    {
+        CancelResult res;
+        Rng rng(777);
+        std::vector<JobInfo> jobs(count);
+        for(auto& j : jobs)
+        {
+            j.description = "job";
+            j.numProcs = rng.range(1, 32);
+            j.numTicks = rng.range(1, 1000);
+        }
+
+        Scheduler sch(machineProcs);
+        sch.addJobs(jobs.data(), jobs.size());
+        sch.tick();
+
+        std::vector<jobid_t> ids(count);
+        for(std::size_t i = 0; i < count; ++i)
+            ids[i] = i + 1;
+        auto shuffle = [&]()
+        {
+            for(std::size_t i = count - 1; i > 0; --i)
+                std::swap(ids[i], ids[rng.next() % (i + 1)]);
+        };
+
+        shuffle();
+        std::size_t half = count / 2;
+        auto t = Clock::now();
+        for(std::size_t i = 0; i < half; ++i)
+            sch.updateJob(ids[i], rng.range(1, 1000), jobs[ids[i] - 1].numProcs);
+        res.nsPerUpdate = nsSince(t) / half;
+
+        shuffle();
+        t = Clock::now();
+        for(std::size_t i = 0; i < half; ++i)
+            sch.cancelJob(ids[i]);
+        res.nsPerCancel = nsSince(t) / half;
+        return res;
+    }
+
+    //////////////////////////////////////////////
+    //  Running each benchmark in its own process (where possible), so peak RSS is per run
+
+    template <typename Result>
+    Result isolate(const std::function<Result()>& fn)
+    {
+#if defined(BENCH_HAVE_FORK)
+        int fds[2];
+        if(pipe(fds) == 0)
+        {
+            std::fflush(stdout);
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                close(fds[0]);
+                Result r = fn();
+                ssize_t written = write(fds[1], &r, sizeof(r));
+                _exit(written == sizeof(r) ? 0 : 1);
+            }
+            close(fds[1]);
+
+            Result r;
+            bool ok = (pid > 0) && (read(fds[0], &r, sizeof(r)) == sizeof(r));
+            close(fds[0]);
+            if(pid > 0)
+                waitpid(pid, nullptr, 0);
+            if(ok)
+                return r;
+        }
+#endif
+        return fn();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t maxjobs = 100000;
+    if(argc >= 2)
+        maxjobs = std::stoul(argv[1]);
+    if(maxjobs < 1000)
+        maxjobs = 1000;
+
+    std::printf("Scheduler workloads (%u processors, %.0f%% offered load)\n", machineProcs, targetLoad * 100);
+    std::printf("%-10s %10s %12s %11s %11s %11s %10s %12s\n", "workload", "jobs", "jobs/sec", "ns/addJob", "ns/tick", "allocs/job", "RSS (MB)", "makespan");
+    std::printf("----------------------------------------------------------------------------------------------\n");
+
+    for(std::size_t n = 1000; n <= maxjobs; n *= 10)
+    {
+        for(auto& w : workloads)
+        {
+            auto arrivals = makeWorkload(w, n);
+            auto r = isolate<SchedResult>( [&]{ return runScheduler(arrivals); } );
+            std::printf("%-10s %10zu %12.0f %11.1f %11.1f %11.2f %10.1f %12llu\n", w.name, n, r.jobsPerSec, r.nsPerAdd,
+                        r.nsPerTick, r.allocsPerJob, r.peakRss, static_cast<unsigned long long>(r.makespan));
+        }
+    }
+
+    std::printf("\nWait queue containers (random insert, in-order walk, search for 1-proc jobs, pop front)\n");
+    std::printf("%-10s %10s %12s %12s %12s %12s\n", "container", "size", "ns/insert", "ns/visit", "ns/scan", "ns/erase");
+    std::printf("-----------------------------------------------------------------------\n");
+
+    // The containers alone are cheap to run, so these always go up to a million (where the cost
+    //   of keeping a big queue in order shows)
+    for(std::size_t n = 1000; n <= std::max<std::size_t>(maxjobs, 1000000); n *= 10)
+    {
+        auto a = isolate<ContainerResult>( [&]{ return runContainer<treelist_t>(n); } );
+        std::printf("%-10s %10zu %12.1f %12.1f %12.1f %12.1f\n", "TreeList", n, a.nsPerInsert, a.nsPerVisit, a.nsPerScan, a.nsPerErase);
+        auto b = isolate<ContainerResult>( [&]{ return runContainer<blocklist_t>(n); } );
+        std::printf("%-10s %10zu %12.1f %12.1f %12.1f %12.1f\n", "BlockList", n, b.nsPerInsert, b.nsPerVisit, b.nsPerScan, b.nsPerErase);
+        auto c = isolate<ContainerResult>( [&]{ return runContainer<multiset_t>(n); } );
+        std::printf("%-10s %10zu %12.1f %12.1f %12.1f %12.1f\n", "multiset", n, c.nsPerInsert, c.nsPerVisit, c.nsPerScan, c.nsPerErase);
+    }
+
+    std::printf("\nCheckpoints (queue built with addJob, then saved and restored)\n");
+    std::printf("%-10s %12s %12s %12s %10s\n", "jobs", "ns/addJob", "ns/save", "ns/load", "file (MB)");
+    std::printf("------------------------------------------------------------\n");
+
+    for(std::size_t n = 1000; n <= maxjobs; n *= 10)
+    {
+        auto r = isolate<CheckpointResult>( [&]{ return runCheckpoint(n); } );
+        std::printf("%-10zu %12.1f %12.1f %12.1f %10.1f\n", n, r.nsPerAdd, r.nsPerSave, r.nsPerLoad, r.fileMB);
+    }
+
+    std::printf("\nChanging queued jobs by ID (half the queue updated, then half cancelled)\n");
+    std::printf("%-10s %12s %12s\n", "jobs", "ns/update", "ns/cancel");
+    std::printf("------------------------------------\n");
+
+    for(std::size_t n = 1000; n <= maxjobs; n *= 10)
+    {
+        auto r = isolate<CancelResult>( [&]{ return runCancel(n); } );
+        std::printf("%-10zu %12.1f %12.1f\n", n, r.nsPerUpdate, r.nsPerCancel);
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+
+#ifndef BITOPS_H_INCLUDED
+#define BITOPS_H_INCLUDED
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//  Portable wrappers around the bit scanning intrinsics.
+//  ctz64/clz64 are undefined for 0, just like the builtins they wrap.
+
+inline unsigned ctz64(std::uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return i;
+#elif defined(_MSC_VER)
+    unsigned long i;
+    if(_BitScanForward(&i, static_cast<unsigned long>(x)))
+        return i;
+    _BitScanForward(&i, static_cast<unsigned long>(x >> 32));
+    return i + 32;
+#else
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+}
+
+inline unsigned clz64(std::uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return 63 - i;
+#elif defined(_MSC_VER)
+    unsigned long i;
+    if(_BitScanReverse(&i, static_cast<unsigned long>(x >> 32)))
+        return 31 - i;
+    _BitScanReverse(&i, static_cast<unsigned long>(x));
+    return 63 - i;
+#else
+    return static_cast<unsigned>(__builtin_clzll(x));
+#endif
+}
+
+inline unsigned popcount64(std::uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<unsigned>(__popcnt64(x));
+#elif defined(_MSC_VER)
+    return __popcnt(static_cast<unsigned>(x)) + __popcnt(static_cast<unsigned>(x >> 32));
+#else
+    return static_cast<unsigned>(__builtin_popcountll(x));
+#endif
+}
+
+#endif
@@ -0,0 +1,258 @@
+
+#ifndef BLOCKLIST_H_INCLUDED
+#define BLOCKLIST_H_INCLUDED
+
+#include <string>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include "nodepool.h"
+
+//  BlockList is a sorted container with the same interface as TreeList, laid out for fast
+//  in-order scans.
+//
+//  Elements are kept in order in fixed size blocks.  A block holds its elements' keys (the small,
+//  hot part that ordering and searching look at) in one array and pointers to the elements
+//  themselves in another, so scanning keys reads consecutive memory instead of chasing a node
+//  pointer per element.  The blocks are the leaves of a B+-tree:  they are linked to each other
+//  for walking in order, and index nodes above them hold each child's first key, summary and
+//  element count.  Finding where an element goes is a search down the index plus a search of
+//  one block, a block splitting or merging only changes the one index node above it (unless
+//  that one fills up or thins out in turn), and findNext can skip whole subtrees.
+//
+//  Unlike TreeList, iterators are invalidated by insert and erase (erase returns a valid
+//  iterator to the element after the one removed).  The elements themselves never move, though:
+//  a handle (a pointer to the element) stays valid until that element is erased, and 'locate'
+//  turns it back into an iterator.
+
+// 'Key' policies say how to get the hot key from an element.  The key has to order elements the
+//   same way T's operator < would.  This one is for elements that are their own key.
+template <typename T>
+struct BlockListKeyIsValue
+{
+    typedef T           key_type;
+    static const T&     key(const T& obj)           { return obj;   }
+};
+
+// 'Summary' policies:  like TreeListAggregate, but the value comes from the key.  No summary:
+struct BlockListNoSummary
+{
+    typedef char        value_type;
+    static const bool   enabled = false;
+
+    template <typename K>   static char value(const K&)         { return 0;     }
+    static char             combine(char, char)                 { return 0;     }
+};
+
+//  Folds a value taken from every key with an associative 'combine'.  'Traits' must provide:
+//      typedef ... value_type;
+//      static value_type value(const key_type& key);
+//      static value_type combine(const value_type& a, const value_type& b);
+template <typename Traits>
+struct BlockListSummary
+{
+    typedef typename Traits::value_type     value_type;
+    static const bool   enabled = true;
+
+    template <typename K>
+    static value_type   value(const K& key)                                     { return Traits::value(key);    }
+    static value_type   combine(const value_type& a, const value_type& b)       { return Traits::combine(a, b); }
+};
+
+template <typename T, typename Key = BlockListKeyIsValue<T>, typename Alloc = PoolAllocator<T>, typename Summary = BlockListNoSummary>
+class BlockList
+{
+public:
+    template <bool Const>   class basic_iterator;
+    typedef basic_iterator<false>   iterator;
+    typedef basic_iterator<true>    const_iterator;
+
+    typedef typename Key::key_type          key_type;
+    typedef typename Summary::value_type    summary_type;
+
+    // A stable reference to an element:  valid until the element is erased
+    typedef T*      handle_type;
+
+    static const unsigned           Capacity = 16;          // elements per block
+    static const unsigned           Fanout = 16;            // children per index node
+    static const std::ptrdiff_t     BulkMinBatch = 32;      // smaller batches are always inserted one at a time
+
+    BlockList() : blockAlloc(itemAlloc), innerAlloc(itemAlloc) {}
+    explicit BlockList(const Alloc& a) : itemAlloc(a), blockAlloc(a), innerAlloc(a) {}
+    ~BlockList()                { clear();      }
+
+    // no copying
+    BlockList(const BlockList&) = delete;
+    BlockList& operator = (const BlockList&) = delete;
+
+    // but moving is OK
+    BlockList(BlockList&& rhs);
+    BlockList& operator = (BlockList&& rhs);
+
+
+    iterator        insert(const T& obj)            { return insertItem( createItem(obj) );             }
+    iterator        insert(T&& obj)                 { return insertItem( createItem(std::move(obj)) );  }
+
+    // Adds every element in the range [first, last), which is walked twice (once to count it),
+    //   so it needs forward iterators.  Big batches are sorted by key, merged with the existing
+    //   elements, and packed into fresh blocks:  O(n + k log k).  The second form also writes a
+    //   handle to each new element to 'positions', in the same order as the input.
+    template <typename ForwardIt>
+    void            insert_bulk(ForwardIt first, ForwardIt last);
+    template <typename ForwardIt, typename OutputIt>
+    OutputIt        insert_bulk(ForwardIt first, ForwardIt last, OutputIt positions);
+
+    void clear();
+
+    iterator        erase(const iterator& i);
+
+    iterator        begin()                         { return iterator(head, 0);             }
+    const_iterator  begin() const                   { return const_iterator(head, 0);       }
+    iterator        end()                           { return iterator();                    }
+    const_iterator  end() const                     { return const_iterator();              }
+
+    iterator        find(const T& v);
+    const_iterator  find(const T& v) const          { return const_cast<BlockList*>(this)->find(v);         }
+
+    // first element not less than 'v' / first element greater than 'v' (end() if there is none)
+    iterator        lower_bound(const T& v)         { return bound(Key::key(v), false);                     }
+    const_iterator  lower_bound(const T& v) const   { return const_cast<BlockList*>(this)->lower_bound(v);  }
+    iterator        upper_bound(const T& v)         { return bound(Key::key(v), true);                      }
+    const_iterator  upper_bound(const T& v) const   { return const_cast<BlockList*>(this)->upper_bound(v);  }
+
+    // Summarized lists only:  the first element at or after 'from' whose summary satisfies
+    //   'pred', which has to be monotone (see TreeList::findNext).  Skips whole subtrees.
+    template <typename Pred>
+    iterator        findNext(const iterator& from, Pred pred);
+
+    // Summarized lists only:  the summary of every element from 'from' to the end.  'from' must
+    //   not be end().
+    summary_type    summarizeFrom(const const_iterator& from) const;
+
+    // Summarized lists only:  the first element where the summary of everything up to and
+    //   including it satisfies 'pred' (see TreeList::findPrefix).  Skips whole subtrees.
+    template <typename Pred>
+    iterator        findPrefix(Pred pred, summary_type& sum);
+
+    // Order statistics, like TreeList's:  the index nodes know how many elements are under each
+    //   child, so these are walks up or down the index, O(log n).
+    std::size_t     rank(const const_iterator& i) const;
+    iterator        nth(std::size_t k);
+    const_iterator  nth(std::size_t k) const            { return const_cast<BlockList*>(this)->nth(k);  }
+    std::size_t     count(const const_iterator& first, const const_iterator& last) const    { return rank(last) - rank(first);  }
+
+    // Summarized lists only:  how many elements in [first, last) satisfy 'pred', with an optional
+    //   'whole' that says every element under a summary does (see TreeList::countIf).  Skips
+    //   whole subtrees either way.
+    template <typename Pred>
+    std::size_t     countIf(const const_iterator& first, const const_iterator& last, Pred pred) const
+    {
+        return countIf(first, last, pred, Never());
+    }
+    template <typename Pred, typename Whole>
+    std::size_t     countIf(const const_iterator& first, const const_iterator& last, Pred pred, Whole whole) const
+    {
+        return countBefore(last, pred, whole) - countBefore(first, pred, whole);
+    }
+
+    handle_type     handle(const iterator& i) const     { return &*i;   }
+    T&              get(handle_type h)                  { return *h;    }
+    const T&        get(handle_type h) const            { return *h;    }
+    iterator        locate(handle_type h);
+    const_iterator  locate(handle_type h) const         { return const_cast<BlockList*>(this)->locate(h);   }
+
+    std::size_t     size() const  {     return numItems;    }
+    bool            empty() const {     return !numItems;   }
+
+    // Testing/debugging
+    void validate() const;
+
+private:
+    struct Inner;
+    struct Block
+    {
+        Inner*      parent = nullptr;
+        unsigned    pos = 0;            // index in the parent
+        Block*      prev = nullptr;
+        Block*      next = nullptr;
+        unsigned    count = 0;
+        key_type    keys[Capacity];
+        T*          items[Capacity];
+    };
+    union Link
+    {
+        Block*      block;
+        Inner*      inner;
+    };
+    struct Inner
+    {
+        Inner*          parent = nullptr;
+        unsigned        pos = 0;
+        unsigned        count = 0;
+        bool            overBlocks;                 // the children are blocks (else index nodes)
+        key_type        low[Fanout];                // first key under each child
+        summary_type    summary[Fanout];
+        std::size_t     size[Fanout];               // elements under each child
+        Link            child[Fanout];
+    };
+    typedef std::allocator_traits<Alloc>                                    ItemTraits;
+    typedef typename ItemTraits::template rebind_alloc<Block>               BlockAlloc;
+    typedef std::allocator_traits<BlockAlloc>                               BlockTraits;
+    typedef typename ItemTraits::template rebind_alloc<Inner>               InnerAlloc;
+    typedef std::allocator_traits<InnerAlloc>                               InnerTraits;
+
+    Link                    root = Link{nullptr};   // a block while height is 0 (null when empty)
+    unsigned                height = 0;             // index levels above the blocks
+    Block*                  head = nullptr;         // first block
+    std::size_t             numItems = 0;
+    Alloc                   itemAlloc;
+    BlockAlloc              blockAlloc;
+    InnerAlloc              innerAlloc;
+
+    template <typename... Args>
+    T*          createItem(Args&&... args);
+    void        destroyItem(T* item);
+    Block*      createBlock();
+    void        destroyBlock(Block* b);
+    Inner*      createInner(bool overBlocks);
+    void        destroyInner(Inner* n);
+    void        destroyTree(Link l, unsigned h);
+
+    static Link link(Block* b)          { Link l;  l.block = b;  return l;     }
+    static Link link(Inner* n)          { Link l;  l.inner = n;  return l;     }
+    static void adopt(Inner* p, unsigned i);
+    void        fill(Inner* p, unsigned i);
+    void        refreshFrom(Inner* p, unsigned i);
+    void        growRoot();
+    void        shrinkRoot();
+    void        addChild(Inner* p, unsigned i, Link c);
+    Inner*      removeChild(Inner* p, unsigned i);
+    Inner*      splitInner(Inner* p);
+    Block*      splitBlock(Block* blk);
+    void        unlinkBlock(Block* blk);
+
+    iterator    insertItem(T* item);
+    Block*      blockFor(const key_type& k, bool upper) const;
+    iterator    bound(const key_type& k, bool upper);
+    static iterator normalize(Block* blk, unsigned s);
+    void        rebuild(std::vector<T*>& added);
+
+    struct Never
+    {
+        template <typename V>   bool operator () (const V&) const   { return false;     }
+    };
+    template <typename Pred, typename Whole>
+    std::size_t countBefore(const const_iterator& i, Pred& pred, Whole& whole) const;
+    template <typename Pred, typename Whole>
+    std::size_t countUnder(const Inner* p, unsigned i, Pred& pred, Whole& whole) const;
+    template <typename Pred>
+    iterator    firstUnder(const Inner* p, unsigned i, Pred pred);
+    std::size_t validateNode(Link l, unsigned h, const Inner* parent, unsigned pos, const Block*& last, const key_type*& prev) const;
+};
+
+#include "blocklist.hpp"
+
+#endif
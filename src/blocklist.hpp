@@ -0,0 +1,998 @@
+template <typename T, typename K, typename A, typename S>
+template <bool Const>
+class BlockList<T,K,A,S>::basic_iterator
+{
+    typedef typename std::conditional<Const, const Block, Block>::type  block_t;
+    typedef typename std::conditional<Const, const T, T>::type          value_t;
+
+public:
+    basic_iterator() = default;
+    basic_iterator(const basic_iterator& rhs) = default;
+    basic_iterator& operator = (const basic_iterator& rhs) = default;
+
+    // iterator -> const_iterator
+    template <bool C, typename = typename std::enable_if<Const && !C>::type>
+    basic_iterator(const basic_iterator<C>& rhs) : blk(rhs.blk), slot(rhs.slot) {}
+
+    bool operator == (const basic_iterator& rhs) const  { return (blk == rhs.blk) && (slot == rhs.slot);   }
+    bool operator != (const basic_iterator& rhs) const  { return !(*this == rhs);                           }
+    basic_iterator& operator ++ ()
+    {
+        if(++slot == blk->count)
+        {
+            blk = blk->next;
+            slot = 0;
+        }
+        return *this;
+    }
+    basic_iterator  operator ++ (int)       { auto tmp = *this; ++(*this);  return tmp;     }
+
+    value_t& operator * () const            { return *blk->items[slot];     }
+    value_t* operator -> () const           { return blk->items[slot];      }
+
+private:
+    friend class BlockList<T,K,A,S>;
+    template <bool C> friend class basic_iterator;
+    basic_iterator(block_t* b, unsigned s) : blk(b), slot(s) {}
+
+    block_t*        blk = nullptr;      // null at the end
+    unsigned        slot = 0;           // index in the block
+};
+
+template <typename T, typename K, typename A, typename S>
+const unsigned BlockList<T,K,A,S>::Capacity;
+template <typename T, typename K, typename A, typename S>
+const unsigned BlockList<T,K,A,S>::Fanout;
+template <typename T, typename K, typename A, typename S>
+const std::ptrdiff_t BlockList<T,K,A,S>::BulkMinBatch;
+
+//////////////////////////////////////////////
+
+template <typename T, typename K, typename A, typename S>
+BlockList<T,K,A,S>::BlockList(BlockList&& rhs)
+    : root( rhs.root )
+    , height( rhs.height )
+    , head( rhs.head )
+    , numItems( rhs.numItems )
+    , itemAlloc( rhs.itemAlloc )    // items and blocks have to go back to the pool they came from
+    , blockAlloc( rhs.blockAlloc )
+    , innerAlloc( rhs.innerAlloc )
+{
+    rhs.root.block = nullptr;
+    rhs.height = 0;
+    rhs.head = nullptr;
+    rhs.numItems = 0;
+}
+
+template <typename T, typename K, typename A, typename S>
+BlockList<T,K,A,S>& BlockList<T,K,A,S>::operator = (BlockList&& rhs)
+{
+    if(this != &rhs)
+    {
+        clear();
+        root = rhs.root;
+        height = rhs.height;
+        head = rhs.head;
+        numItems = rhs.numItems;
+        itemAlloc = rhs.itemAlloc;
+        blockAlloc = rhs.blockAlloc;
+        innerAlloc = rhs.innerAlloc;
+
+        rhs.root.block = nullptr;
+        rhs.height = 0;
+        rhs.head = nullptr;
+        rhs.numItems = 0;
+    }
+    return *this;
+}
+
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::clear()
+{
+    for(Block* b = head; b; b = b->next)
+    {
+        for(unsigned i = 0; i < b->count; ++i)
+            destroyItem(b->items[i]);
+    }
+    if(root.block)
+        destroyTree(root, height);
+    root.block = nullptr;
+    height = 0;
+    head = nullptr;
+    numItems = 0;
+}
+
+template <typename T, typename K, typename A, typename S>
+template <typename... Args>
+T* BlockList<T,K,A,S>::createItem(Args&&... args)
+{
+    T* item = ItemTraits::allocate(itemAlloc, 1);
+    try
+    {
+        ItemTraits::construct(itemAlloc, item, std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+        ItemTraits::deallocate(itemAlloc, item, 1);
+        throw;
+    }
+    return item;
+}
+
+template <typename T, typename K, typename A, typename S>
+inline void BlockList<T,K,A,S>::destroyItem(T* item)
+{
+    ItemTraits::destroy(itemAlloc, item);
+    ItemTraits::deallocate(itemAlloc, item, 1);
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::createBlock() -> Block*
+{
+    Block* b = BlockTraits::allocate(blockAlloc, 1);
+    BlockTraits::construct(blockAlloc, b);
+    return b;
+}
+
+template <typename T, typename K, typename A, typename S>
+inline void BlockList<T,K,A,S>::destroyBlock(Block* b)
+{
+    BlockTraits::destroy(blockAlloc, b);
+    BlockTraits::deallocate(blockAlloc, b, 1);
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::createInner(bool overBlocks) -> Inner*
+{
+    Inner* n = InnerTraits::allocate(innerAlloc, 1);
+    InnerTraits::construct(innerAlloc, n);
+    n->overBlocks = overBlocks;
+    return n;
+}
+
+template <typename T, typename K, typename A, typename S>
+inline void BlockList<T,K,A,S>::destroyInner(Inner* n)
+{
+    InnerTraits::destroy(innerAlloc, n);
+    InnerTraits::deallocate(innerAlloc, n, 1);
+}
+
+// Frees a subtree's blocks and index nodes (not the items in them)
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::destroyTree(Link l, unsigned h)
+{
+    if(!h)
+    {
+        destroyBlock(l.block);
+        return;
+    }
+    for(unsigned i = 0; i < l.inner->count; ++i)
+        destroyTree(l.inner->child[i], h - 1);
+    destroyInner(l.inner);
+}
+
+//////////////////////////////////////////////
+
+// Points child 'i' of 'p' back at its (new) place
+template <typename T, typename K, typename A, typename S>
+inline void BlockList<T,K,A,S>::adopt(Inner* p, unsigned i)
+{
+    if(p->overBlocks)
+    {
+        p->child[i].block->parent = p;
+        p->child[i].block->pos = i;
+    }
+    else
+    {
+        p->child[i].inner->parent = p;
+        p->child[i].inner->pos = i;
+    }
+}
+
+// Recomputes the entry 'p' keeps for child 'i' after the child's contents change
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::fill(Inner* p, unsigned i)
+{
+    if(p->overBlocks)
+    {
+        const Block* b = p->child[i].block;
+        p->low[i] = b->keys[0];
+        p->size[i] = b->count;
+        if(S::enabled)
+        {
+            auto sum = S::value(b->keys[0]);
+            for(unsigned j = 1; j < b->count; ++j)
+                sum = S::combine(sum, S::value(b->keys[j]));
+            p->summary[i] = sum;
+        }
+    }
+    else
+    {
+        const Inner* n = p->child[i].inner;
+        p->low[i] = n->low[0];
+        std::size_t size = n->size[0];
+        for(unsigned j = 1; j < n->count; ++j)
+            size += n->size[j];
+        p->size[i] = size;
+        if(S::enabled)
+        {
+            auto sum = n->summary[0];
+            for(unsigned j = 1; j < n->count; ++j)
+                sum = S::combine(sum, n->summary[j]);
+            p->summary[i] = sum;
+        }
+    }
+}
+
+// Recomputes the entries from child 'i' of 'p' up to the root
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::refreshFrom(Inner* p, unsigned i)
+{
+    for(; p; i = p->pos, p = p->parent)
+        fill(p, i);
+}
+
+// Puts a new index node with the old root as its only child on top
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::growRoot()
+{
+    Inner* r = createInner(height == 0);
+    r->child[0] = root;
+    r->count = 1;
+    adopt(r, 0);
+    fill(r, 0);
+    root = link(r);
+    ++height;
+}
+
+// Drops index nodes off the top while they have just one child
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::shrinkRoot()
+{
+    while(height && root.inner->count == 1)
+    {
+        Inner* r = root.inner;
+        root = r->child[0];
+        if(r->overBlocks)
+            root.block->parent = nullptr;
+        else
+            root.inner->parent = nullptr;
+        --height;
+        destroyInner(r);
+    }
+}
+
+// Makes 'c' child 'i' of 'p' and fills in its entry.  If 'p' is full it is split first, and 'c'
+//   ends up next to child 'i - 1' whichever half that lands in.  The entries above 'p' are left
+//   for the caller to refresh.
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::addChild(Inner* p, unsigned i, Link c)
+{
+    static const unsigned half = Fanout / 2;
+
+    if(p->count == Fanout)
+    {
+        Inner* q = splitInner(p);
+        if(i > half)
+        {
+            i -= half;
+            p = q;
+        }
+    }
+
+    for(unsigned j = p->count; j > i; --j)
+    {
+        p->low[j] = p->low[j-1];
+        p->summary[j] = p->summary[j-1];
+        p->size[j] = p->size[j-1];
+        p->child[j] = p->child[j-1];
+        adopt(p, j);
+    }
+    p->child[i] = c;
+    ++p->count;
+    adopt(p, i);
+    fill(p, i);
+}
+
+// Takes child 'i' out of 'p'.  If that leaves 'p' thin, it is merged with a neighbor (and if it
+//   leaves it empty, it goes too).  Returns the index node now holding what 'p' had left, whose
+//   entries up to the root need refreshing -- null if 'p' was emptied and nothing above it is
+//   left to refresh.
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::removeChild(Inner* p, unsigned i) -> Inner*
+{
+    for(unsigned j = i + 1; j < p->count; ++j)
+    {
+        p->low[j-1] = p->low[j];
+        p->summary[j-1] = p->summary[j];
+        p->size[j-1] = p->size[j];
+        p->child[j-1] = p->child[j];
+        adopt(p, j - 1);
+    }
+    --p->count;
+
+    Inner* gp = p->parent;
+    if(!gp)
+        return p;
+    if(!p->count)
+    {
+        unsigned pi = p->pos;
+        destroyInner(p);
+        return removeChild(gp, pi);
+    }
+
+    // same rule as for blocks:  fold a neighbor in if the two fit in half a node together
+    Inner* from = nullptr;
+    Inner* into = nullptr;
+    if(p->pos + 1 < gp->count && p->count + gp->child[p->pos + 1].inner->count <= Fanout / 2)
+    {
+        from = gp->child[p->pos + 1].inner;
+        into = p;
+    }
+    else if(p->pos > 0 && p->count + gp->child[p->pos - 1].inner->count <= Fanout / 2)
+    {
+        from = p;
+        into = gp->child[p->pos - 1].inner;
+    }
+    if(!from)
+        return p;
+
+    for(unsigned j = 0; j < from->count; ++j)
+    {
+        unsigned k = into->count++;
+        into->low[k] = from->low[j];
+        into->summary[k] = from->summary[j];
+        into->size[k] = from->size[j];
+        into->child[k] = from->child[j];
+        adopt(into, k);
+    }
+    unsigned fi = from->pos;
+    destroyInner(from);
+    removeChild(gp, fi);        // 'into' is still under whatever that returns
+    return into;
+}
+
+// Moves the top half of a full index node into a new node right after it
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::splitInner(Inner* p) -> Inner*
+{
+    static const unsigned half = Fanout / 2;
+
+    Inner* q = createInner(p->overBlocks);
+    for(unsigned j = half; j < Fanout; ++j)
+    {
+        q->low[j - half] = p->low[j];
+        q->summary[j - half] = p->summary[j];
+        q->size[j - half] = p->size[j];
+        q->child[j - half] = p->child[j];
+        adopt(q, j - half);
+    }
+    q->count = Fanout - half;
+    p->count = half;
+
+    if(!p->parent)
+        growRoot();
+    addChild(p->parent, p->pos + 1, link(q));
+    fill(p->parent, p->pos);
+    return q;
+}
+
+// Moves the top half of a full block into a new block right after it
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::splitBlock(Block* blk) -> Block*
+{
+    static const unsigned half = Capacity / 2;
+
+    Block* nb = createBlock();
+    std::copy(blk->keys + half, blk->keys + Capacity, nb->keys);
+    std::copy(blk->items + half, blk->items + Capacity, nb->items);
+    nb->count = Capacity - half;
+    blk->count = half;
+
+    nb->prev = blk;
+    nb->next = blk->next;
+    if(blk->next)
+        blk->next->prev = nb;
+    blk->next = nb;
+
+    if(!blk->parent)
+        growRoot();
+    addChild(blk->parent, blk->pos + 1, link(nb));
+    fill(blk->parent, blk->pos);
+    return nb;
+}
+
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::unlinkBlock(Block* blk)
+{
+    if(blk->prev)
+        blk->prev->next = blk->next;
+    else
+        head = blk->next;
+    if(blk->next)
+        blk->next->prev = blk->prev;
+}
+
+//////////////////////////////////////////////
+
+// The block a key belongs in:  at each level, the last child whose first key is less than (or,
+//   with 'upper', not greater than) 'k' -- the first child if there is no such child.
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::blockFor(const key_type& k, bool upper) const -> Block*
+{
+    Link l = root;
+    for(unsigned h = height; h > 0; --h)
+    {
+        const Inner* n = l.inner;
+        unsigned lo = 0, hi = n->count;     // answer is the last index in [lo, hi) that qualifies
+        while(hi - lo > 1)
+        {
+            unsigned mid = lo + (hi - lo) / 2;
+            bool before = upper ? !(k < n->low[mid]) : (n->low[mid] < k);
+            if(before)      lo = mid;
+            else            hi = mid;
+        }
+        l = n->child[lo];
+    }
+    return l.block;
+}
+
+// (blk, s) might be one past the end of the block -- if so, that's the start of the next one
+template <typename T, typename K, typename A, typename S>
+inline auto BlockList<T,K,A,S>::normalize(Block* blk, unsigned s) -> iterator
+{
+    if(s >= blk->count)
+        return iterator(blk->next, 0);
+    return iterator(blk, s);
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::insertItem(T* item) -> iterator
+{
+    if(!root.block)
+    {
+        root = link( createBlock() );
+        head = root.block;
+    }
+
+    // equal keys go after the ones already here, same as TreeList
+    key_type k = K::key(*item);
+    Block* blk = blockFor(k, true);
+    unsigned s = static_cast<unsigned>( std::upper_bound(blk->keys, blk->keys + blk->count, k) - blk->keys );
+
+    if(blk->count == Capacity)
+    {
+        Block* nb = splitBlock(blk);
+        if(s > Capacity / 2)
+        {
+            s -= Capacity / 2;
+            blk = nb;
+        }
+    }
+
+    std::copy_backward(blk->keys + s, blk->keys + blk->count, blk->keys + blk->count + 1);
+    std::copy_backward(blk->items + s, blk->items + blk->count, blk->items + blk->count + 1);
+    blk->keys[s] = k;
+    blk->items[s] = item;
+    ++blk->count;
+    ++numItems;
+    refreshFrom(blk->parent, blk->pos);
+
+    return iterator(blk, s);
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::erase(const iterator& i) -> iterator
+{
+    Block* blk = i.blk;
+    unsigned s = i.slot;
+
+    destroyItem(blk->items[s]);
+    std::copy(blk->keys + s + 1, blk->keys + blk->count, blk->keys + s);
+    std::copy(blk->items + s + 1, blk->items + blk->count, blk->items + s);
+    --blk->count;
+    --numItems;
+
+    if(!blk->count)
+    {
+        Block* next = blk->next;
+        unlinkBlock(blk);
+        if(blk->parent)
+        {
+            Inner* p = removeChild(blk->parent, blk->pos);
+            if(p)
+                refreshFrom(p->parent, p->pos);
+            shrinkRoot();
+        }
+        else
+            root.block = nullptr;
+        destroyBlock(blk);
+        return iterator(next, 0);
+    }
+
+    // Keep blocks from thinning out:  fold a neighbor under the same index node in if the two
+    //   fit in half a block together
+    Block* from = nullptr;
+    if(blk->next && blk->next->parent == blk->parent && blk->count + blk->next->count <= Capacity / 2)
+        from = blk->next;
+    else if(blk->prev && blk->prev->parent == blk->parent && blk->count + blk->prev->count <= Capacity / 2)
+    {
+        from = blk;
+        blk = blk->prev;
+        s += blk->count;
+    }
+    if(from)
+    {
+        std::copy(from->keys, from->keys + from->count, blk->keys + blk->count);
+        std::copy(from->items, from->items + from->count, blk->items + blk->count);
+        blk->count += from->count;
+        unlinkBlock(from);
+        removeChild(from->parent, from->pos);       // 'blk' is still under whatever that returns
+        destroyBlock(from);
+    }
+
+    refreshFrom(blk->parent, blk->pos);
+    if(from)
+        shrinkRoot();
+    return normalize(blk, s);
+}
+
+//////////////////////////////////////////////
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::bound(const key_type& k, bool upper) -> iterator
+{
+    if(!root.block)         return end();
+
+    Block* blk = blockFor(k, upper);
+    auto pos = upper ? std::upper_bound(blk->keys, blk->keys + blk->count, k)
+                     : std::lower_bound(blk->keys, blk->keys + blk->count, k);
+    return normalize(blk, static_cast<unsigned>(pos - blk->keys));
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::find(const T& v) -> iterator
+{
+    auto k = K::key(v);
+    auto i = bound(k, false);
+    if(i == end() || k < i.blk->keys[i.slot])
+        return end();
+    return i;
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::locate(handle_type h) -> iterator
+{
+    // find the first element with the same key, then look for this one among its equals
+    for(auto i = bound(K::key(*h), false); i != end(); ++i)
+    {
+        if(&*i == h)
+            return i;
+    }
+    return end();
+}
+
+template <typename T, typename K, typename A, typename S>
+std::size_t BlockList<T,K,A,S>::rank(const const_iterator& i) const
+{
+    if(!i.blk)      return numItems;
+
+    std::size_t r = i.slot;
+    unsigned pos = i.blk->pos;
+    for(const Inner* p = i.blk->parent; p; pos = p->pos, p = p->parent)
+    {
+        for(unsigned j = 0; j < pos; ++j)
+            r += p->size[j];
+    }
+    return r;
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::nth(std::size_t k) -> iterator
+{
+    if(k >= numItems)       return end();
+
+    Link l = root;
+    for(unsigned h = height; h > 0; --h)
+    {
+        const Inner* n = l.inner;
+        unsigned j = 0;
+        while(k >= n->size[j])
+            k -= n->size[j++];
+        l = n->child[j];
+    }
+    return iterator(l.block, static_cast<unsigned>(k));
+}
+
+// How many elements under child 'i' of 'p' satisfy 'pred'
+template <typename T, typename K, typename A, typename S>
+template <typename Pred, typename Whole>
+std::size_t BlockList<T,K,A,S>::countUnder(const Inner* p, unsigned i, Pred& pred, Whole& whole) const
+{
+    if(!pred(p->summary[i]))
+        return 0;
+    if(whole(p->summary[i]))
+        return p->size[i];
+
+    std::size_t c = 0;
+    if(p->overBlocks)
+    {
+        const Block* b = p->child[i].block;
+        for(unsigned s = 0; s < b->count; ++s)
+        {
+            if(pred(S::value(b->keys[s])))
+                ++c;
+        }
+    }
+    else
+    {
+        const Inner* n = p->child[i].inner;
+        for(unsigned j = 0; j < n->count; ++j)
+            c += countUnder(n, j, pred, whole);
+    }
+    return c;
+}
+
+// How many elements before 'i' satisfy 'pred'
+template <typename T, typename K, typename A, typename S>
+template <typename Pred, typename Whole>
+std::size_t BlockList<T,K,A,S>::countBefore(const const_iterator& i, Pred& pred, Whole& whole) const
+{
+    if(!root.block)
+        return 0;
+
+    std::size_t c = 0;
+    if(!i.blk && height)
+    {
+        for(unsigned j = 0; j < root.inner->count; ++j)
+            c += countUnder(root.inner, j, pred, whole);
+        return c;
+    }
+
+    // (the end of a list with just one block is the end of that block)
+    const Block* blk = i.blk ? i.blk : root.block;
+    unsigned stop = i.blk ? i.slot : blk->count;
+    for(unsigned s = 0; s < stop; ++s)
+    {
+        if(pred(S::value(blk->keys[s])))
+            ++c;
+    }
+    if(!i.blk)
+        return c;
+
+    unsigned pos = i.blk->pos;
+    for(const Inner* p = i.blk->parent; p; pos = p->pos, p = p->parent)
+    {
+        for(unsigned j = 0; j < pos; ++j)
+            c += countUnder(p, j, pred, whole);
+    }
+    return c;
+}
+
+// The first element under child 'i' of 'p' that satisfies 'pred' (end() if there is none)
+template <typename T, typename K, typename A, typename S>
+template <typename Pred>
+auto BlockList<T,K,A,S>::firstUnder(const Inner* p, unsigned i, Pred pred) -> iterator
+{
+    if(!pred(p->summary[i]))
+        return end();
+
+    if(p->overBlocks)
+    {
+        Block* b = p->child[i].block;
+        for(unsigned s = 0; s < b->count; ++s)
+        {
+            if(pred(S::value(b->keys[s])))
+                return iterator(b, s);
+        }
+        return end();
+    }
+
+    const Inner* n = p->child[i].inner;
+    for(unsigned j = 0; j < n->count; ++j)
+    {
+        auto found = firstUnder(n, j, pred);
+        if(found != end())
+            return found;
+    }
+    return end();
+}
+
+template <typename T, typename K, typename A, typename S>
+template <typename Pred>
+auto BlockList<T,K,A,S>::findNext(const iterator& from, Pred pred) -> iterator
+{
+    Block* blk = from.blk;
+    if(!blk)
+        return end();
+
+    for(unsigned s = from.slot; s < blk->count; ++s)
+    {
+        if(pred(S::value(blk->keys[s])))
+            return iterator(blk, s);
+    }
+
+    // then whatever comes after this block at each level up
+    unsigned pos = blk->pos;
+    for(const Inner* p = blk->parent; p; pos = p->pos, p = p->parent)
+    {
+        for(unsigned j = pos + 1; j < p->count; ++j)
+        {
+            auto found = firstUnder(p, j, pred);
+            if(found != end())
+                return found;
+        }
+    }
+    return end();
+}
+
+template <typename T, typename K, typename A, typename S>
+auto BlockList<T,K,A,S>::summarizeFrom(const const_iterator& from) const -> summary_type
+{
+    const Block* blk = from.blk;
+    auto sum = S::value(blk->keys[from.slot]);
+    for(unsigned s = from.slot + 1; s < blk->count; ++s)
+        sum = S::combine(sum, S::value(blk->keys[s]));
+
+    unsigned pos = blk->pos;
+    for(const Inner* p = blk->parent; p; pos = p->pos, p = p->parent)
+    {
+        for(unsigned j = pos + 1; j < p->count; ++j)
+            sum = S::combine(sum, p->summary[j]);
+    }
+    return sum;
+}
+
+template <typename T, typename K, typename A, typename S>
+template <typename Pred>
+auto BlockList<T,K,A,S>::findPrefix(Pred pred, summary_type& sum) -> iterator
+{
+    if(!root.block)
+        return end();
+
+    summary_type acc = summary_type();      // everything before the current child ('have' is false while that's nothing yet)
+    bool have = false;
+    Link l = root;
+    for(unsigned h = height; h > 0; --h)
+    {
+        const Inner* n = l.inner;
+        unsigned j = 0;
+        for(; j < n->count; ++j)
+        {
+            auto withchild = have ? S::combine(acc, n->summary[j]) : n->summary[j];
+            if(pred(withchild))
+                break;              // it ends under this child
+            acc = withchild;
+            have = true;
+        }
+        if(j == n->count)
+            return end();
+        l = n->child[j];
+    }
+
+    Block* blk = l.block;
+    for(unsigned s = 0; s < blk->count; ++s)
+    {
+        acc = have ? S::combine(acc, S::value(blk->keys[s])) : S::value(blk->keys[s]);
+        have = true;
+        if(pred(acc))
+        {
+            sum = acc;
+            return iterator(blk, s);
+        }
+    }
+    return end();
+}
+
+//////////////////////////////////////////////
+
+template <typename T, typename K, typename A, typename S>
+template <typename ForwardIt>
+void BlockList<T,K,A,S>::insert_bulk(ForwardIt first, ForwardIt last)
+{
+    std::vector<handle_type> unused;
+    insert_bulk(first, last, std::back_inserter(unused));
+}
+
+template <typename T, typename K, typename A, typename S>
+template <typename ForwardIt, typename OutputIt>
+OutputIt BlockList<T,K,A,S>::insert_bulk(ForwardIt first, ForwardIt last, OutputIt positions)
+{
+    static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<ForwardIt>::iterator_category>::value,
+                  "insert_bulk walks the range twice, so it needs forward iterators");
+
+    // Packing touches every element already here, so only do it for a batch that is big next to
+    //   the container.  Otherwise each insert is a search plus a shift within one block.
+    std::ptrdiff_t k = std::distance(first, last);
+    if(k < BulkMinBatch || static_cast<std::size_t>(k) * Capacity < numItems)
+    {
+        for(; first != last; ++first)
+            *positions++ = handle( insert(*first) );
+        return positions;
+    }
+
+    std::vector<T*> added;
+    try
+    {
+        for(; first != last; ++first)
+            added.push_back( createItem(*first) );
+    }
+    catch(...)
+    {
+        for(auto i : added)
+            destroyItem(i);
+        throw;
+    }
+
+    for(auto i : added)
+        *positions++ = i;
+    rebuild(added);
+    return positions;
+}
+
+// Merges 'added' with everything already here and repacks the blocks and index nodes 3/4 full,
+//   so the next few inserts into each one don't immediately split it.
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::rebuild(std::vector<T*>& added)
+{
+    struct Entry
+    {
+        key_type    key;
+        T*          item;
+        bool operator < (const Entry& rhs) const        { return key < rhs.key;     }
+    };
+
+    std::vector<Entry> fresh;
+    fresh.reserve(added.size());
+    for(auto i : added)
+        fresh.push_back( Entry{K::key(*i), i} );
+    if(!std::is_sorted(fresh.begin(), fresh.end()))      // (a restored checkpoint already is)
+        std::stable_sort(fresh.begin(), fresh.end());    // stable:  equal keys stay in input order
+
+    // merge -- ties go to the existing element first
+    std::vector<Entry> all;
+    all.reserve(numItems + fresh.size());
+    auto f = fresh.begin();
+    for(Block* b = head; b; b = b->next)
+    {
+        for(unsigned i = 0; i < b->count; ++i)
+        {
+            const key_type& key = b->keys[i];
+            for(; f != fresh.end() && f->key < key; ++f)
+                all.push_back(*f);
+            all.push_back( Entry{key, b->items[i]} );
+        }
+    }
+    all.insert(all.end(), f, fresh.end());
+    if(root.block)
+        destroyTree(root, height);
+
+    // the blocks, linked in order
+    static const unsigned blockFill = Capacity * 3 / 4;
+    std::vector<Link> level;
+    Block* prev = nullptr;
+    for(std::size_t i = 0; i < all.size(); i += blockFill)
+    {
+        Block* b = createBlock();
+        for(std::size_t j = i; j < all.size() && j < i + blockFill; ++j)
+        {
+            b->keys[b->count] = all[j].key;
+            b->items[b->count] = all[j].item;
+            ++b->count;
+        }
+        b->prev = prev;
+        if(prev)
+            prev->next = b;
+        prev = b;
+        level.push_back( link(b) );
+    }
+    head = level.empty() ? nullptr : level.front().block;
+    numItems = all.size();
+
+    // then the index, a level at a time
+    static const unsigned innerFill = Fanout * 3 / 4;
+    height = 0;
+    while(level.size() > 1)
+    {
+        std::vector<Link> up;
+        for(std::size_t i = 0; i < level.size(); i += innerFill)
+        {
+            Inner* n = createInner(height == 0);
+            for(std::size_t j = i; j < level.size() && j < i + innerFill; ++j)
+            {
+                n->child[n->count] = level[j];
+                adopt(n, n->count);
+                fill(n, n->count);
+                ++n->count;
+            }
+            up.push_back( link(n) );
+        }
+        level.swap(up);
+        ++height;
+    }
+    root = level.empty() ? Link{nullptr} : level.front();
+}
+
+//////////////////////////////////////////////
+//////////////////////////////////////////////
+template <typename T, typename K, typename A, typename S>
+std::size_t BlockList<T,K,A,S>::validateNode(Link l, unsigned h, const Inner* parent, unsigned pos, const Block*& last, const key_type*& prev) const
+{
+    if(!h)
+    {
+        const Block* blk = l.block;
+        if(!blk->count || blk->count > Capacity)    throw std::runtime_error("Block has a bad count");
+        if(blk->parent != parent || blk->pos != pos)
+            throw std::runtime_error("Block doesn't point back at its parent");
+        if(blk->prev != last || (last ? last->next : head) != blk)
+            throw std::runtime_error("Blocks are linked out of order");
+        last = blk;
+
+        for(unsigned i = 0; i < blk->count; ++i)
+        {
+            if(!blk->items[i])                      throw std::runtime_error("Block has a null item");
+            if(K::key(*blk->items[i]) < blk->keys[i] || blk->keys[i] < K::key(*blk->items[i]))
+                throw std::runtime_error("Block key doesn't match its item");
+            if(prev && blk->keys[i] < *prev)        throw std::runtime_error("Block is out of order");
+            prev = &blk->keys[i];
+        }
+        return blk->count;
+    }
+
+    const Inner* n = l.inner;
+    if(!n->count || n->count > Fanout)              throw std::runtime_error("Index node has a bad count");
+    if(n->parent != parent || n->pos != pos)        throw std::runtime_error("Index node doesn't point back at its parent");
+    if(n->overBlocks != (h == 1))                   throw std::runtime_error("Index node is at the wrong level");
+
+    std::size_t total = 0;
+    for(unsigned i = 0; i < n->count; ++i)
+    {
+        std::size_t size = validateNode(n->child[i], h - 1, n, i, last, prev);
+        if(size != n->size[i])                      throw std::runtime_error("Index node size is out of date");
+
+        const key_type& low = n->overBlocks ? n->child[i].block->keys[0] : n->child[i].inner->low[0];
+        if(n->low[i] < low || low < n->low[i])      throw std::runtime_error("Index node key is out of date");
+
+        if(S::enabled)
+        {
+            summary_type sum;
+            if(n->overBlocks)
+            {
+                const Block* b = n->child[i].block;
+                sum = S::value(b->keys[0]);
+                for(unsigned j = 1; j < b->count; ++j)
+                    sum = S::combine(sum, S::value(b->keys[j]));
+            }
+            else
+            {
+                const Inner* c = n->child[i].inner;
+                sum = c->summary[0];
+                for(unsigned j = 1; j < c->count; ++j)
+                    sum = S::combine(sum, c->summary[j]);
+            }
+            if(!(sum == n->summary[i]))             throw std::runtime_error("Index node summary is out of date");
+        }
+        total += size;
+    }
+    return total;
+}
+
+template <typename T, typename K, typename A, typename S>
+void BlockList<T,K,A,S>::validate() const
+{
+    std::size_t count = 0;
+    const Block* last = nullptr;
+    if(root.block)
+    {
+        const key_type* prev = nullptr;
+        count = validateNode(root, height, nullptr, 0, last, prev);
+        if(height && root.inner->count < 2)         throw std::runtime_error("Root index node has one child");
+    }
+    else if(height || head)
+        throw std::runtime_error("Empty list has blocks");
+    if(last && last->next)
+        throw std::runtime_error("Blocks are linked past the last one");
+
+    if(count != numItems)
+        throw std::runtime_error("item count / numItems mismatch");
+}
@@ -0,0 +1,163 @@
+
+#include <cstring>
+#include "checkpoint.h"
+
+namespace
+{
+    const char          CheckpointMagic[8] = { 'D','S','C','K','P','T','\0','\0' };
+    const std::uint32_t CheckpointVersion = 2;     // 2:  jobs carry their metrics
+
+    inline std::uint64_t rotl(std::uint64_t x, int r)       { return (x << r) | (x >> (64 - r));    }
+
+    // Checks everything in the header that doesn't depend on the rest of the file
+    void checkHeader(const CheckpointHeader& hdr, std::size_t fileSize, const std::string& path)
+    {
+        if(std::memcmp(hdr.magic, CheckpointMagic, sizeof(CheckpointMagic)))
+            throw SchedulerException("'" + path + "' is not a scheduler checkpoint");
+        if(hdr.version != CheckpointVersion)
+            throw SchedulerException("'" + path + "' has unsupported checkpoint version " + std::to_string(hdr.version));
+        if(hdr.headerSize != sizeof(CheckpointHeader))
+            throw SchedulerException("'" + path + "' has an unexpected header size");
+        if(hdr.payloadSize != fileSize - sizeof(CheckpointHeader) || hdr.payloadSize % 8)
+            throw SchedulerException("'" + path + "' is truncated or has trailing data");
+        if(!std::memchr(hdr.policy, '\0', sizeof(hdr.policy)))
+            throw SchedulerException("'" + path + "' has a bad policy name");
+    }
+}
+
+// MurmurHash3's 64-bit mixing, one word at a time
+std::uint64_t checkpointChecksum(const void* data, std::size_t len, std::uint64_t h)
+{
+    const char* p = static_cast<const char*>(data);
+    for(std::size_t i = 0; i + 8 <= len; i += 8)
+    {
+        std::uint64_t w;
+        std::memcpy(&w, p + i, sizeof(w));
+
+        w *= 0x87c37b91114253d5ull;
+        w = rotl(w, 31);
+        w *= 0x4cf5ad432745937full;
+        h ^= w;
+        h = rotl(h, 27) * 5 + 0x52dce729;
+    }
+    return h;
+}
+
+CheckpointHeader readCheckpointHeader(const std::string& path)
+{
+    MappedFile file(path);
+    if(file.size() < sizeof(CheckpointHeader))
+        throw SchedulerException("'" + path + "' is not a scheduler checkpoint");
+
+    CheckpointHeader hdr;
+    std::memcpy(&hdr, file.data(), sizeof(hdr));
+    checkHeader(hdr, file.size(), path);
+    return hdr;
+}
+
+//////////////////////////////////////////////
+
+CheckpointWriter::CheckpointWriter(const std::string& path_)
+    : path(path_)
+    , buffer(BufferSize)
+{
+    file = std::fopen(path.c_str(), "wb");
+    if(!file)
+        throw SchedulerException("Unable to open '" + path + "' for writing");
+
+    CheckpointHeader blank;
+    std::memset(&blank, 0, sizeof(blank));
+    std::fwrite(&blank, sizeof(blank), 1, file);       // filled in by finish
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    if(file)                // finish never happened:  don't leave half a checkpoint behind
+    {
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+}
+
+void CheckpointWriter::write(const void* data, std::size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while(len)
+    {
+        std::size_t n = std::min(len, BufferSize - used);
+        std::memcpy(buffer.data() + used, p, n);
+        used += n;
+        p += n;
+        len -= n;
+        if(used == BufferSize)
+            flush();
+    }
+}
+
+void CheckpointWriter::endSection()
+{
+    static const char zeros[8] = {};
+    std::size_t partial = (payload + used) % 8;
+    if(partial)
+        write(zeros, 8 - partial);
+}
+
+// Only ever called with a multiple of 8 bytes (a full buffer, or the end of a section)
+void CheckpointWriter::flush()
+{
+    sum = checkpointChecksum(buffer.data(), used, sum);
+    std::fwrite(buffer.data(), 1, used, file);
+    payload += used;
+    used = 0;
+}
+
+void CheckpointWriter::finish(CheckpointHeader& hdr)
+{
+    endSection();
+    flush();
+
+    std::memcpy(hdr.magic, CheckpointMagic, sizeof(hdr.magic));
+    hdr.version = CheckpointVersion;
+    hdr.headerSize = sizeof(CheckpointHeader);
+    hdr.payloadSize = payload;
+    hdr.checksum = sum;
+
+    std::fseek(file, 0, SEEK_SET);
+    std::fwrite(&hdr, sizeof(hdr), 1, file);
+
+    bool failed = std::ferror(file) != 0;
+    failed = (std::fclose(file) != 0) || failed;
+    file = nullptr;
+    if(failed)
+    {
+        std::remove(path.c_str());
+        throw SchedulerException("Error writing '" + path + "'");
+    }
+}
+
+//////////////////////////////////////////////
+
+CheckpointReader::CheckpointReader(const std::string& path)
+    : file(path)
+    , pos(sizeof(CheckpointHeader))
+{
+    if(file.size() < sizeof(CheckpointHeader))
+        throw SchedulerException("'" + path + "' is not a scheduler checkpoint");
+
+    std::memcpy(&hdr, file.data(), sizeof(hdr));
+    checkHeader(hdr, file.size(), path);
+    if(checkpointChecksum(file.data() + sizeof(hdr), hdr.payloadSize) != hdr.checksum)
+        throw SchedulerException("'" + path + "' is corrupt (checksum mismatch)");
+}
+
+const void* CheckpointReader::take(std::uint64_t count, std::size_t size)
+{
+    std::uint64_t left = file.size() - pos;
+    if(count > left / size)
+        throw SchedulerException("Checkpoint is truncated");
+
+    const char* p = file.data() + pos;
+    std::uint64_t len = (count * size + 7) & ~std::uint64_t(7);
+    pos += static_cast<std::size_t>(len < left ? len : left);
+    return p;
+}
@@ -0,0 +1,138 @@
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "mappedfile.h"
+
+//  Scheduler checkpoints (BasicScheduler::saveCheckpoint / loadCheckpoint).
+//
+//  A CheckpointHeader, then these sections, each padded with zeros to a multiple of 8 bytes:
+//      policy state        'policyWords' 64-bit words (see policy.h)
+//      strings             'numStrings' CheckpointStrings, one for every string ID in order
+//      unused string IDs   'numUnusedStrings' 32-bit IDs, in the order they'll be reused
+//      string text         'textBytes' bytes:  every string, back to back, in ID order
+//      waiting jobs        'numWaiting' CheckpointJobs, in queue order
+//      active jobs         'numActive' CheckpointJobs, in the order they started
+//      processors          32-bit processor IDs:  each active job's, in the same order
+//
+//  All values are stored in the host's byte order.  Each job's metrics (see metrics.h) come along,
+//  but the scheduler's totals and quantile sketches don't:  they start over after a restore.
+//  The checksum covers everything after the header.  The waiting jobs are already in queue order,
+//  so restoring them is one pass to build the jobs and one to link them into a balanced queue --
+//  there is no sorting or searching.
+
+struct CheckpointHeader
+{
+    char            magic[8];           // CheckpointMagic
+    std::uint32_t   version;            // CheckpointVersion
+    std::uint32_t   headerSize;         // sizeof(CheckpointHeader)
+    std::uint64_t   payloadSize;        // bytes after the header
+    std::uint64_t   checksum;           // checkpointChecksum of those bytes
+    char            policy[16];         // the policy's name(), zero padded
+
+    std::uint32_t   numProcs;
+    std::uint32_t   groupSize;
+    std::uint64_t   clock;
+    std::uint64_t   lastJobId;
+    std::uint32_t   needProcAssign;     // 1 if jobs were added since processors were last assigned
+    std::uint32_t   policyWords;
+
+    std::uint32_t   numStrings;
+    std::uint32_t   numUnusedStrings;
+    std::uint64_t   textBytes;
+    std::uint64_t   numWaiting;
+    std::uint64_t   numActive;
+    std::uint64_t   numProcIds;
+};
+
+struct CheckpointString
+{
+    std::uint32_t   refs;               // 0 if the ID isn't in use
+    std::uint32_t   length;
+};
+
+struct CheckpointJob
+{
+    std::uint64_t   id;
+    std::uint64_t   tick;               // waiting:  its rank in the queue.  active:  the tick it ends on
+    std::uint32_t   description;        // string ID
+    std::uint32_t   numProcs;
+    std::uint32_t   numTicks;
+    std::uint32_t   ticksRemaining;     // waiting jobs only
+    std::uint64_t   submitTick;
+    std::uint64_t   startTick;          // NoTick if it hasn't started yet
+    std::uint32_t   bumps;
+    std::uint32_t   reserved;
+};
+
+static_assert(sizeof(CheckpointHeader) == 120,      "CheckpointHeader must not have padding");
+static_assert(sizeof(CheckpointString) == 8,        "CheckpointString must not have padding");
+static_assert(sizeof(CheckpointJob) == 56,          "CheckpointJob must not have padding");
+
+// A 64-bit hash of 'len' bytes, taken a 64-bit word at a time, so it runs close to memory speed.
+//   'len' must be a multiple of 8.  Feed a long run through in pieces by passing each result
+//   back in as 'h'.
+std::uint64_t       checkpointChecksum(const void* data, std::size_t len, std::uint64_t h = 0);
+
+// Reads and checks just the header of a checkpoint (so the caller can build a scheduler to match
+//   it).  Throws SchedulerException if the file isn't a checkpoint this version can read.
+CheckpointHeader    readCheckpointHeader(const std::string& path);
+
+//  Writes a checkpoint front to back through a large buffer, checksumming as it goes.  The header
+//  is written last (over the placeholder at the start), once the checksum is known.
+class CheckpointWriter
+{
+public:
+    explicit        CheckpointWriter(const std::string& path);      // throws SchedulerException on failure
+                    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator = (const CheckpointWriter&) = delete;
+
+    void            write(const void* data, std::size_t len);
+    void            endSection();           // pads to a multiple of 8 bytes
+
+    // Fills in the magic, version, sizes and checksum of 'hdr', writes it and closes the file.
+    //   Throws SchedulerException if anything failed to write.
+    void            finish(CheckpointHeader& hdr);
+
+private:
+    static const std::size_t    BufferSize = 1 << 20;       // a multiple of 8
+
+    std::string                 path;
+    std::FILE*                  file;
+    std::vector<char>           buffer;
+    std::size_t                 used = 0;
+    std::uint64_t               payload = 0;
+    std::uint64_t               sum = 0;
+
+    void            flush();
+};
+
+//  Reads a checkpoint out of a memory mapped file.  The constructor checks the header and the
+//  checksum; after that, each section is handed out in place.
+class CheckpointReader
+{
+public:
+    explicit        CheckpointReader(const std::string& path);      // throws SchedulerException on failure
+
+    const CheckpointHeader&     header() const          { return hdr;   }
+
+    // The next section:  'count' items of T.  Throws SchedulerException if the file is too short.
+    template <typename T>
+    const T*        section(std::uint64_t count)        { return static_cast<const T*>(take(count, sizeof(T)));  }
+
+private:
+    MappedFile          file;
+    CheckpointHeader    hdr;
+    std::size_t         pos;
+
+    const void*     take(std::uint64_t count, std::size_t size);
+};
+
+#endif
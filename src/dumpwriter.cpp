@@ -0,0 +1,155 @@
+
+#include <cerrno>
+#include <ostream>
+#include "dumpwriter.h"
+#include "types.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#define write_fd    _write
+#else
+#include <unistd.h>
+#define write_fd    ::write
+#endif
+
+DumpWriter::DumpWriter(char* buf, std::size_t size)
+    : buffer(buf), cap(size), sink(Sink::None)
+{}
+
+DumpWriter::DumpWriter(char* buf, std::size_t size, int f)
+    : buffer(buf), cap(size), sink(Sink::Fd), fd(f)
+{}
+
+DumpWriter::DumpWriter(char* buf, std::size_t size, std::ostream& s)
+    : buffer(buf), cap(size), sink(Sink::Stream), stream(&s)
+{}
+
+DumpWriter::~DumpWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch(...)
+    {
+    }
+}
+
+void DumpWriter::flush()
+{
+    if(sink == Sink::None || !pos)
+        return;
+
+    if(sink == Sink::Stream)
+        stream->write(buffer, pos);
+    else
+    {
+        const char* p = buffer;
+        std::size_t left = pos;
+        while(left)
+        {
+            auto n = write_fd(fd, p, static_cast<unsigned>(left));
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                throw SchedulerException("DumpWriter:  error writing to file descriptor");
+            p += n;
+            left -= static_cast<std::size_t>(n);
+        }
+    }
+    pos = 0;
+}
+
+bool DumpWriter::makeRoom()
+{
+    if(sink != Sink::None)
+        flush();
+    if(pos < cap)
+        return true;
+
+    dropped = true;
+    return false;
+}
+
+void DumpWriter::write(const char* s, std::size_t n)
+{
+    while(n)
+    {
+        if(pos == cap && !makeRoom())
+            return;
+
+        std::size_t chunk = cap - pos;
+        if(chunk > n)       chunk = n;
+        std::memcpy(buffer + pos, s, chunk);
+        pos += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+std::size_t DumpWriter::writeUInt(std::uint64_t v)
+{
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    do
+    {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    }while(v);
+
+    std::size_t n = digits + sizeof(digits) - p;
+    write(p, n);
+    return n;
+}
+
+void DumpWriter::pad(std::size_t width, std::size_t written)
+{
+    for(; written < width; ++written)
+        put(' ');
+}
+
+void DumpWriter::writeJsonString(const char* s, std::size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put('"');
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if(c == '"' || c == '\\')
+        {
+            put('\\');
+            put(static_cast<char>(c));
+        }
+        else if(c < 0x20)
+        {
+            write("\\u00", 4);
+            put(hex[c >> 4]);
+            put(hex[c & 0x0F]);
+        }
+        else
+            put(static_cast<char>(c));
+    }
+    put('"');
+}
+
+void DumpWriter::writeCsvField(const char* s, std::size_t n)
+{
+    bool quote = false;
+    for(std::size_t i = 0; i < n && !quote; ++i)
+        quote = (s[i] == ',' || s[i] == '"' || s[i] == '\n' || s[i] == '\r');
+
+    if(!quote)
+    {
+        write(s, n);
+        return;
+    }
+
+    put('"');
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        if(s[i] == '"')     put('"');       // quotes are escaped by doubling them
+        put(s[i]);
+    }
+    put('"');
+}
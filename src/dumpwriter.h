@@ -0,0 +1,74 @@
+
+#ifndef DUMPWRITER_H_INCLUDED
+#define DUMPWRITER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <limits>
+
+enum class DumpFormat
+{
+    Table,          // human readable, fixed width columns
+    Csv,
+    JsonLines       // one JSON object per line
+};
+
+static const std::size_t DumpAll = std::numeric_limits<std::size_t>::max();     // no limit on the number of rows
+
+//  Formatted output into a caller supplied buffer.
+//
+//  Nothing is ever allocated:  text is formatted directly into the buffer, and when the buffer
+//  fills up it is either flushed to the sink (a file descriptor or an ostream), or, if there is
+//  no sink, further output is dropped and truncated() becomes true.
+class DumpWriter
+{
+public:
+    DumpWriter(char* buf, std::size_t size);                    // no sink:  output stops when the buffer is full
+    DumpWriter(char* buf, std::size_t size, int fd);            // flushes to a file descriptor
+    DumpWriter(char* buf, std::size_t size, std::ostream& s);   // flushes to a stream
+    ~DumpWriter();                                              // flushes, ignoring errors
+
+    DumpWriter(const DumpWriter&) = delete;
+    DumpWriter& operator = (const DumpWriter&) = delete;
+
+    void            put(char c)
+    {
+        if(pos == cap && !makeRoom())   return;
+        buffer[pos++] = c;
+    }
+    void            write(const char* s, std::size_t n);
+    void            write(const char* s)        { write(s, std::strlen(s));    }
+
+    // These all return the number of characters written (for padding)
+    std::size_t     writeUInt(std::uint64_t v);
+    std::size_t     writeText(const char* s, std::size_t n)    { write(s, n);  return n;   }
+    void            pad(std::size_t width, std::size_t written);    // spaces, up to 'width' total
+
+    // Quoted/escaped strings
+    void            writeJsonString(const char* s, std::size_t n);
+    void            writeCsvField(const char* s, std::size_t n);
+
+    void            flush();        // throws SchedulerException if the file descriptor can't be written
+
+    // Without a sink, these give what has been written so far
+    const char*     data() const        { return buffer;        }
+    std::size_t     length() const      { return pos;           }
+    bool            truncated() const   { return dropped;       }
+
+private:
+    enum class Sink { None, Fd, Stream };
+
+    char*           buffer;
+    std::size_t     cap;
+    std::size_t     pos = 0;
+    Sink            sink;
+    int             fd = -1;
+    std::ostream*   stream = nullptr;
+    bool            dropped = false;
+
+    bool            makeRoom();     // flushes if there's a sink, returns false if there's still no room
+};
+
+#endif
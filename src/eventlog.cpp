@@ -0,0 +1,302 @@
+
+#include <chrono>
+#include <cstring>
+#include "eventlog.h"
+
+namespace
+{
+    const char          EventLogMagic[8] = { 'D','S','E','V','L','O','G','\0' };
+    const std::uint32_t EventLogVersion = 1;
+
+    // How long the writer thread sleeps when the ring is empty.  This is also the most a lost
+    //   wakeup can cost, since the scheduler thread never takes the lock to wake it.
+    const std::chrono::milliseconds     WriterInterval(2);
+
+    const std::size_t   MaxBatch = 1 << 20;         // so a block's size always fits in 32 bits
+
+    inline std::uint64_t zigzag(std::uint64_t v)        { return (v << 1) ^ (0 - (v >> 63));    }
+    inline std::uint64_t unzigzag(std::uint64_t v)      { return (v >> 1) ^ (0 - (v & 1));      }
+
+    void putVarint(std::vector<char>& out, std::uint64_t v)
+    {
+        while(v >= 0x80)
+        {
+            out.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    bool getVarint(const char*& p, const char* end, std::uint64_t& v)
+    {
+        v = 0;
+        for(unsigned shift = 0; p < end && shift < 64; shift += 7)
+        {
+            auto byte = static_cast<unsigned char>(*p++);
+            v |= std::uint64_t(byte & 0x7F) << shift;
+            if(!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+const char* eventKindName(EventKind kind)
+{
+    switch(kind)
+    {
+    case EventKind::Submit:     return "submit";
+    case EventKind::Reject:     return "reject";
+    case EventKind::Admit:      return "admit";
+    case EventKind::Bump:       return "bump";
+    case EventKind::Complete:   return "complete";
+    case EventKind::Withdraw:   return "withdraw";
+    case EventKind::Cancel:     return "cancel";
+    case EventKind::Update:     return "update";
+    }
+    return "unknown";
+}
+
+//////////////////////////////////////////////
+
+EventLog::EventLog(const std::string& path_, const EventLogOptions& opts_)
+    : path(path_)
+    , opts(opts_)
+    , ring(opts_.capacity)
+    , written(0)
+    , bytes(0)
+    , failed(false)
+    , kick(false)
+{
+    if(opts.batch == 0 || opts.batch > MaxBatch)
+        throw SchedulerException("Event log batches must be 1 to " + std::to_string(MaxBatch) + " events");
+
+    file = std::fopen(path.c_str(), "wb");
+    if(!file)
+        throw SchedulerException("Unable to open '" + path + "' for writing");
+
+    EventLogHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, EventLogMagic, sizeof(hdr.magic));
+    hdr.version = EventLogVersion;
+    hdr.recordSize = sizeof(EventRecord);
+    hdr.compression = static_cast<std::uint32_t>(opts.compression);
+    if(std::fwrite(&hdr, sizeof(hdr), 1, file) != 1)
+    {
+        std::fclose(file);
+        throw SchedulerException("Error writing '" + path + "'");
+    }
+    bytes = sizeof(hdr);
+
+    pending.reserve(opts.batch);
+    writer = std::thread(&EventLog::writerLoop, this);
+}
+
+EventLog::~EventLog()
+{
+    try
+    {
+        close();
+    }
+    catch(...)
+    {
+    }
+}
+
+void EventLog::close()
+{
+    if(!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> g(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    bool bad = failed || std::fclose(file) != 0;
+    file = nullptr;
+    if(bad)
+        throw SchedulerException("Error writing '" + path + "'");
+}
+
+EventLogStats EventLog::stats() const
+{
+    EventLogStats s;
+    s.recorded = recorded;
+    s.dropped = dropped;
+    s.stalls = stalls;
+    s.written = written;
+    s.bytes = bytes;
+    return s;
+}
+
+// The ring is full.  Either way the writer is woken right away rather than at its next interval.
+void EventLog::overflow(const EventRecord& e)
+{
+    kick = true;
+    wake.notify_one();
+
+    if(opts.overflow == EventOverflow::Drop)
+    {
+        ++dropped;
+        return;
+    }
+
+    ++stalls;
+    EventRecord copy = e;
+    while(!ring.tryPush( std::move(copy) ))     // (tryPush leaves 'copy' alone when it fails)
+        std::this_thread::yield();
+    ++recorded;
+}
+
+// Drains the ring into blocks of up to 'batch' events.  'stopping' is checked before the ring
+//   is drained, so everything recorded before close() makes it into the file.
+void EventLog::writerLoop()
+{
+    EventRecord e;
+    while(true)
+    {
+        bool closing;
+        {
+            std::lock_guard<std::mutex> g(lock);
+            closing = stopping;
+        }
+        kick = false;
+
+        bool wrote = false;
+        while(ring.tryPop(e))
+        {
+            pending.push_back(e);
+            if(pending.size() == opts.batch)
+            {
+                writeBlock();
+                wrote = true;
+            }
+        }
+        if(!pending.empty())
+        {
+            writeBlock();
+            wrote = true;
+        }
+        if(wrote && std::fflush(file) != 0)
+            failed = true;
+
+        if(closing)
+            return;
+
+        std::unique_lock<std::mutex> g(lock);
+        wake.wait_for(g, WriterInterval, [this]() { return stopping || kick; });
+    }
+}
+
+void EventLog::writeBlock()
+{
+    EventBlockHeader blk;
+    blk.count = static_cast<std::uint32_t>(pending.size());
+
+    encoded.resize(sizeof(blk));
+    if(opts.compression == EventCompression::Delta)
+    {
+        EventRecord prev;
+        std::memset(&prev, 0, sizeof(prev));
+        for(auto& e : pending)
+        {
+            putVarint(encoded, e.kind);
+            putVarint(encoded, zigzag(e.tick - prev.tick));
+            putVarint(encoded, zigzag(e.job - prev.job));
+            putVarint(encoded, e.numProcs);
+            putVarint(encoded, e.ticks);
+            putVarint(encoded, std::uint32_t(e.firstProc + 1));      // NoEventProc is the common case:  make it 0
+            prev = e;
+        }
+    }
+    else
+    {
+        auto n = pending.size() * sizeof(EventRecord);
+        encoded.resize(sizeof(blk) + n);
+        std::memcpy(encoded.data() + sizeof(blk), pending.data(), n);
+    }
+
+    blk.bytes = static_cast<std::uint32_t>(encoded.size() - sizeof(blk));
+    std::memcpy(encoded.data(), &blk, sizeof(blk));
+
+    // after a failure, keep draining the ring (so Block mode can't hang) but stop writing
+    if(!failed && std::fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size())
+        failed = true;
+
+    written += pending.size();
+    bytes += encoded.size();
+    pending.clear();
+}
+
+//////////////////////////////////////////////
+
+EventLogReader::EventLogReader(const std::string& path)
+    : file(path)
+{
+    pos = file.data();
+    end = pos + file.size();
+
+    if(file.size() < sizeof(hdr) || std::memcmp(pos, EventLogMagic, sizeof(EventLogMagic)))
+        throw SchedulerException("'" + path + "' is not an event log");
+
+    std::memcpy(&hdr, pos, sizeof(hdr));
+    if(hdr.version != EventLogVersion)
+        throw SchedulerException("'" + path + "' has unsupported event log version " + std::to_string(hdr.version));
+    if(hdr.recordSize != sizeof(EventRecord))
+        throw SchedulerException("'" + path + "' has an unexpected record size");
+    if(hdr.compression > static_cast<std::uint32_t>(EventCompression::Delta))
+        throw SchedulerException("'" + path + "' uses an unknown compression");
+
+    pos += sizeof(hdr);
+    std::memset(&prev, 0, sizeof(prev));
+}
+
+bool EventLogReader::next(EventRecord& e)
+{
+    while(left == 0)
+    {
+        EventBlockHeader blk;
+        if(static_cast<std::size_t>(end - pos) < sizeof(blk))
+            return false;
+        std::memcpy(&blk, pos, sizeof(blk));
+        if(blk.bytes > static_cast<std::size_t>(end - pos) - sizeof(blk))
+            return false;           // the writer was cut off partway through this block
+        if(compression() == EventCompression::None && blk.bytes != std::uint64_t(blk.count) * sizeof(EventRecord))
+            throw SchedulerException("Event log block has the wrong size");
+
+        pos += sizeof(blk);
+        blockEnd = pos + blk.bytes;
+        left = blk.count;
+        std::memset(&prev, 0, sizeof(prev));
+        if(!left && pos != blockEnd)
+            throw SchedulerException("Event log block has the wrong size");
+    }
+
+    if(compression() == EventCompression::None)
+    {
+        std::memcpy(&e, pos, sizeof(e));        // memcpy, since the mapping is only guaranteed to be byte aligned
+        pos += sizeof(e);
+    }
+    else
+    {
+        std::uint64_t kind, tick, job, procs, ticks, first;
+        if(!getVarint(pos, blockEnd, kind) || !getVarint(pos, blockEnd, tick) || !getVarint(pos, blockEnd, job)
+           || !getVarint(pos, blockEnd, procs) || !getVarint(pos, blockEnd, ticks) || !getVarint(pos, blockEnd, first))
+            throw SchedulerException("Event log block is malformed");
+
+        e.kind = static_cast<std::uint32_t>(kind);
+        e.tick = prev.tick + unzigzag(tick);
+        e.job = prev.job + unzigzag(job);
+        e.numProcs = static_cast<std::uint32_t>(procs);
+        e.ticks = static_cast<std::uint32_t>(ticks);
+        e.firstProc = static_cast<std::uint32_t>(first) - 1;
+        prev = e;
+    }
+
+    if(--left == 0 && pos != blockEnd)
+        throw SchedulerException("Event log block has the wrong size");
+    return true;
+}
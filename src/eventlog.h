@@ -0,0 +1,181 @@
+
+#ifndef EVENTLOG_H_INCLUDED
+#define EVENTLOG_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "types.h"
+#include "mappedfile.h"
+#include "mpscring.h"
+
+//  Event logs:  an append-only record of every scheduling decision.
+//
+//  The scheduler thread only copies a fixed size EventRecord into a ring buffer.  A background
+//  thread drains the ring in batches and writes them to the file, so the scheduler never waits on
+//  the disk.  If the ring fills up anyway, the EventLog either drops events or makes the
+//  scheduler wait for room (EventOverflow), and counts how often it did.
+//
+//  File format:  an EventLogHeader, then blocks.  Each block is an EventBlockHeader followed by
+//  'bytes' bytes holding 'count' events:  raw EventRecords, or with EventCompression::Delta,
+//  each event as varints of its differences from the one before.  Every block starts from
+//  scratch, so a log cut short (the process died) still decodes up to its last whole block.  All
+//  values are stored in the host's byte order.
+
+enum class EventKind : std::uint32_t
+{
+    Submit = 1,     // a job was accepted into the wait queue (addJob, addJobs, submitJob, adoptJob)
+    Reject,         // a job was turned down by addJob, addJobs or adoptJob (its ID is NoJob unless it had one)
+    Admit,          // a job started running
+    Bump,           // a running job was put back in the wait queue to make room
+    Complete,       // a job finished
+    Withdraw,       // a waiting job was taken away (takeWaitingJob)
+    Cancel,         // a waiting or running job was cancelled (cancelJob)
+    Update          // a job's ticks or processors were changed (updateJob)
+};
+
+const char* eventKindName(EventKind kind);
+
+struct EventRecord
+{
+    std::uint64_t   tick;
+    std::uint64_t   job;
+    std::uint32_t   kind;           // EventKind
+    std::uint32_t   numProcs;
+    std::uint32_t   ticks;          // Submit/Reject/Complete:  as submitted.  Otherwise:  ticks remaining
+    std::uint32_t   firstProc;      // Admit:  the job's first processor.  Otherwise NoEventProc
+};
+
+static const std::uint32_t  NoEventProc = ~0u;
+
+struct EventLogHeader
+{
+    char            magic[8];       // EventLogMagic
+    std::uint32_t   version;        // EventLogVersion
+    std::uint32_t   recordSize;     // sizeof(EventRecord)
+    std::uint32_t   compression;    // EventCompression
+    std::uint32_t   reserved;
+};
+
+struct EventBlockHeader
+{
+    std::uint32_t   count;
+    std::uint32_t   bytes;
+};
+
+static_assert(sizeof(EventRecord) == 32,        "EventRecord must not have padding");
+static_assert(sizeof(EventLogHeader) == 24,     "EventLogHeader must not have padding");
+static_assert(sizeof(EventBlockHeader) == 8,    "EventBlockHeader must not have padding");
+
+enum class EventCompression : std::uint32_t
+{
+    None,           // 32 bytes per event
+    Delta           // varint deltas:  usually 6 to 10 bytes per event
+};
+
+// What record does when the ring is full
+enum class EventOverflow
+{
+    Drop,           // throw the event away (the scheduler never waits)
+    Block           // wait for the writer thread to make room (nothing is lost)
+};
+
+struct EventLogOptions
+{
+    std::size_t         capacity = 1 << 16;     // events the ring holds (rounded up to a power of 2)
+    std::size_t         batch = 4096;           // events per block
+    EventOverflow       overflow = EventOverflow::Drop;
+    EventCompression    compression = EventCompression::None;
+};
+
+struct EventLogStats
+{
+    std::uint64_t       recorded = 0;       // events that made it into the ring
+    std::uint64_t       dropped = 0;        // events lost to a full ring (EventOverflow::Drop)
+    std::uint64_t       stalls = 0;         // times record found the ring full and waited (EventOverflow::Block)
+    std::uint64_t       written = 0;        // events written to the file so far
+    std::uint64_t       bytes = 0;          // bytes written to the file so far
+};
+
+//  Writes events to a file from a background thread.  record may only be called by one thread
+//  at a time (the scheduler thread); stats and close too.
+class EventLog
+{
+public:
+    // Creates the file and starts the writer thread.  Throws SchedulerException on failure.
+                    EventLog(const std::string& path, const EventLogOptions& opts = EventLogOptions());
+                    ~EventLog();        // closes, ignoring errors
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator = (const EventLog&) = delete;
+
+    void            record(const EventRecord& e)
+    {
+        EventRecord copy = e;
+        if(ring.tryPush( std::move(copy) ))
+            ++recorded;
+        else
+            overflow(e);
+    }
+
+    // Writes everything still in the ring, stops the writer thread and closes the file.  Throws
+    //   SchedulerException if anything failed to write.  Does nothing the second time.
+    void            close();
+
+    EventLogStats   stats() const;
+
+private:
+    std::string                 path;
+    EventLogOptions             opts;
+    MpscRing<EventRecord>       ring;
+    std::FILE*                  file;
+
+    std::uint64_t               recorded = 0;       // the scheduler thread's counters
+    std::uint64_t               dropped = 0;
+    std::uint64_t               stalls = 0;
+    std::atomic<std::uint64_t>  written;            // the writer thread's
+    std::atomic<std::uint64_t>  bytes;
+    std::atomic<bool>           failed;
+    std::atomic<bool>           kick;               // the ring filled up:  the writer shouldn't wait
+
+    std::thread                 writer;
+    std::mutex                  lock;
+    std::condition_variable     wake;               // 'kick' was set, or we're closing
+    bool                        stopping = false;   // guarded by 'lock'
+
+    std::vector<EventRecord>    pending;            // writer thread only:  the block being built
+    std::vector<char>           encoded;
+
+    void            overflow(const EventRecord& e);
+    void            writerLoop();
+    void            writeBlock();
+};
+
+//  Reads an event log back, one event at a time.
+class EventLogReader
+{
+public:
+    explicit        EventLogReader(const std::string& path);      // throws SchedulerException on failure
+
+    EventCompression    compression() const     { return static_cast<EventCompression>(hdr.compression);    }
+
+    // Returns false at the end of the log.  Throws SchedulerException if the log is malformed.
+    //   A last block that was cut short counts as the end.
+    bool            next(EventRecord& e);
+
+private:
+    MappedFile          file;
+    EventLogHeader      hdr;
+    const char*         pos;
+    const char*         end;
+    const char*         blockEnd = nullptr;
+    std::uint32_t       left = 0;           // events left in the current block
+    EventRecord         prev;               // Delta:  the event before
+};
+
+#endif
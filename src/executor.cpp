@@ -0,0 +1,405 @@
+
+#include "executor.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open  434
+#endif
+
+extern char** environ;
+#endif
+
+#if defined(__linux__)
+
+namespace
+{
+    const int           MaxEvents = 256;        // exits handled per epoll_wait
+
+    int pidfdOpen(int pid)      { return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));    }
+
+    std::string errorText()     { return std::strerror(errno);      }
+
+    // Sets the CPUs of every thread of process 'pid', and adds the processes its threads started
+    //   to 'pending'
+    void pinProcess(int pid, const cpu_set_t& set, std::vector<int>& pending)
+    {
+        std::string path = "/proc/" + std::to_string(pid) + "/task/";
+        DIR* dir = opendir(path.c_str());
+        if(!dir)
+            return;
+        while(dirent* entry = readdir(dir))
+        {
+            if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+                continue;
+            sched_setaffinity(std::atoi(entry->d_name), sizeof(set), &set);
+
+            std::string children = path + entry->d_name + "/children";
+            int fd = open(children.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+                continue;
+            std::string list;
+            char buf[256];
+            ssize_t len;
+            while((len = read(fd, buf, sizeof(buf))) > 0)
+                list.append(buf, static_cast<std::size_t>(len));
+            close(fd);
+
+            const char* p = list.c_str();
+            char* end;
+            for(long child = std::strtol(p, &end, 10); end != p; child = std::strtol(p, &end, 10))
+            {
+                pending.push_back(static_cast<int>(child));
+                p = end;
+            }
+        }
+        closedir(dir);
+    }
+
+    void jobCpus(const ScheduledJob& job, const std::vector<unsigned>& cpus, std::vector<procid_t>& scratch, cpu_set_t& set)
+    {
+        CPU_ZERO(&set);
+        job.procsUsed.copyTo(scratch.data());
+        for(unsigned k = 0; k < job.numProcs; ++k)
+            CPU_SET(cpus[scratch[k]], &set);
+    }
+}
+
+LocalExecutor::LocalExecutor(AnyScheduler& sch_, std::chrono::microseconds tickLength_, std::vector<unsigned> cpus_)
+    : sch( sch_ )
+    , tickLength( tickLength_ )
+    , cpus( std::move(cpus_) )
+    , epfd( -1 )
+{
+    if(tickLength.count() <= 0)
+        throw SchedulerException("The tick length has to be positive");
+
+    cpu_set_t own;
+    CPU_ZERO(&own);
+    if(sched_getaffinity(0, sizeof(own), &own) != 0)
+        throw SchedulerException("Unable to get this thread's CPUs:  " + errorText());
+    ownMask.assign(reinterpret_cast<const unsigned char*>(&own), reinterpret_cast<const unsigned char*>(&own) + sizeof(own));
+    if(cpus.empty())
+    {
+        for(unsigned c = 0; c < CPU_SETSIZE; ++c)
+        {
+            if(CPU_ISSET(c, &own))
+                cpus.push_back(c);
+        }
+    }
+    if(cpus.size() < sch.numProcs())
+        throw SchedulerException("The scheduler has " + std::to_string(sch.numProcs()) + " processors, but there are only "
+                                 + std::to_string(cpus.size()) + " CPUs to run them on");
+    for(auto c : cpus)
+    {
+        if(c >= CPU_SETSIZE)
+            throw SchedulerException("CPU " + std::to_string(c) + " is out of range");
+    }
+
+    int probe = pidfdOpen(getpid());
+    if(probe < 0)
+        throw SchedulerException("This system doesn't support pidfds:  " + errorText());
+    close(probe);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(epfd < 0)
+        throw SchedulerException("Unable to create an epoll instance:  " + errorText());
+
+    procScratch.resize(sch.numProcs());
+    start = std::chrono::steady_clock::now();
+    startTick = sch.now();
+    sch.setJobHandler([this](EventKind kind, const ScheduledJob& job) { jobEvent(kind, job); });
+}
+
+LocalExecutor::~LocalExecutor()
+{
+    sch.setJobHandler(nullptr);
+    for(auto& c : children)
+    {
+        kill(-c.second.pid, SIGKILL);
+        int status;
+        waitpid(c.second.pid, &status, 0);
+        close(c.second.pidfd);
+    }
+    close(epfd);
+}
+
+//////////////////////////////////////////////
+
+void LocalExecutor::run(std::chrono::microseconds timeout)
+{
+    step(std::chrono::steady_clock::now() + timeout, [] { return false; });
+}
+
+void LocalExecutor::runUntil(tick_t tick)
+{
+    if(tick <= sch.now())
+        return;
+    step(timeOf(tick), [this, tick] { return sch.now() >= tick; });
+}
+
+void LocalExecutor::runUntilIdle()
+{
+    step(std::chrono::steady_clock::time_point::max(), [this] { return sch.idle() && children.empty(); });
+}
+
+// Each time around:  bring the scheduler's clock up to the wall clock (which kills whatever ran
+//   out of ticks, and starts whatever fits in their place), start whatever fits now, then sleep
+//   until a process exits, the next job's ticks run out or the deadline.  Nothing else can
+//   change what runs, so there's no reason to wake up for every tick.
+bool LocalExecutor::step(std::chrono::steady_clock::time_point deadline, const std::function<bool()>& done)
+{
+    epoll_event events[MaxEvents];
+    for(;;)
+    {
+        catchUp();
+        settle();
+        if(done())
+            return true;
+
+        auto now = std::chrono::steady_clock::now();
+        if(now >= deadline)
+            return false;
+
+        auto wake = deadline;
+        tick_t next = sch.nextCompletion();
+        if(next != NoTick)
+            wake = std::min(wake, timeOf(next));
+
+        int timeout = 0;
+        if(wake > now)
+        {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now);
+            if(ms < wake - now)
+                ++ms;       // round up, or we'd wake just before the tick and spin until it comes
+            timeout = static_cast<int>(std::min<std::chrono::milliseconds::rep>(ms.count(), 1 << 30));
+        }
+
+        int n = epoll_wait(epfd, events, MaxEvents, timeout);
+        if(n < 0 && errno != EINTR)
+            throw SchedulerException("epoll_wait failed:  " + errorText());
+        for(int i = 0; i < n; ++i)
+            reap(events[i].data.u64);
+    }
+}
+
+std::chrono::steady_clock::time_point LocalExecutor::timeOf(tick_t tick) const
+{
+    return start + tickLength * static_cast<std::chrono::microseconds::rep>(tick - startTick);
+}
+
+// Runs the scheduler up to the tick the wall clock is on
+void LocalExecutor::catchUp()
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    tick_t due = startTick + static_cast<tick_t>(elapsed / tickLength);
+    if(due > sch.now())
+        sch.advance(due - sch.now());
+}
+
+// Starts whatever fits.  A job whose process couldn't start completes at once, which may let
+//   something else start in turn.
+void LocalExecutor::settle()
+{
+    sch.schedule();
+    while(!failures.empty() || !finishing.empty())
+    {
+        std::vector<jobid_t> failed, finished;
+        failed.swap(failures);
+        finished.swap(finishing);
+        for(auto id : failed)
+        {
+            sch.finishJob(id);
+            ++counts.failed;
+            if(onExit)
+                onExit(JobExit{ id, -1, false });
+        }
+        for(auto id : finished)
+            sch.finishJob(id);
+        sch.schedule();
+    }
+}
+
+// The process for 'id' has exited.  If its job was still running, it's done now.
+void LocalExecutor::reap(jobid_t id)
+{
+    auto i = children.find(id);
+    if(i == children.end())
+        return;
+    Child child = i->second;
+    children.erase(i);      // before finishJob, so the completion doesn't try to kill it
+
+    int status = 0;
+    while(waitpid(child.pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    close(child.pidfd);
+
+    if(!child.killed)
+    {
+        ++counts.exited;
+        if(!sch.finishJob(id))
+            done.insert(id);        // it exited just as it was bumped:  it's done as soon as it starts again
+    }
+    if(onExit)
+        onExit(JobExit{ id, status, child.killed });
+}
+
+//////////////////////////////////////////////
+
+// Called by the scheduler, in the middle of its own work:  this only starts and signals processes.
+//   Anything that needs the scheduler again waits for settle.
+void LocalExecutor::jobEvent(EventKind kind, const ScheduledJob& job)
+{
+    auto i = children.find(job.id);
+    switch(kind)
+    {
+    case EventKind::Admit:
+        if(i != children.end() && i->second.stopped)
+        {
+            pin(i->second.pid, job);
+            kill(-i->second.pid, SIGCONT);
+            i->second.stopped = false;
+            ++counts.resumed;
+        }
+        else if(done.erase(job.id))
+            finishing.push_back(job.id);
+        else if(i == children.end() && !launch(job))
+            failures.push_back(job.id);
+        break;
+
+    case EventKind::Bump:
+        if(i != children.end())
+        {
+            kill(-i->second.pid, SIGSTOP);
+            i->second.stopped = true;
+            ++counts.stopped;
+        }
+        break;
+
+    case EventKind::Complete:       // its ticks ran out
+        if(i != children.end() && !i->second.killed)
+        {
+            kill(-i->second.pid, SIGKILL);
+            i->second.killed = true;
+            ++counts.killed;
+        }
+        break;
+
+    case EventKind::Cancel:
+    case EventKind::Withdraw:
+        done.erase(job.id);
+        if(i != children.end() && !i->second.killed)
+        {
+            kill(-i->second.pid, SIGKILL);      // SIGKILL works on a stopped group too
+            i->second.killed = true;
+            ++counts.cancelled;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// The child inherits the CPUs of the thread that starts it, so this thread moves to the job's
+//   CPUs just for the posix_spawn.  That pins the process before it runs a single instruction,
+//   without the cost of a fork.
+bool LocalExecutor::launch(const ScheduledJob& job)
+{
+    cpu_set_t set;
+    jobCpus(job, cpus, procScratch, set);
+    if(sched_setaffinity(0, sizeof(set), &set) != 0)
+        return false;
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, 0);        // a group of its own, so signals reach everything it starts
+    sigset_t none, all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &all);
+
+    const std::string& command = sch.getDescription(job);
+    char* argv[] = { const_cast<char*>("sh"), const_cast<char*>("-c"), const_cast<char*>(command.c_str()), nullptr };
+    pid_t pid;
+    int rc = posix_spawn(&pid, "/bin/sh", nullptr, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+
+    cpu_set_t own;
+    std::memcpy(&own, ownMask.data(), sizeof(own));
+    sched_setaffinity(0, sizeof(own), &own);
+    if(rc != 0)
+        return false;
+
+    // the process can't be reaped before this (only we wait for it), so this can't miss its exit
+    int fd = pidfdOpen(pid);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = job.id;
+    if(fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        kill(-pid, SIGKILL);
+        int status;
+        waitpid(pid, &status, 0);
+        if(fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    Child child;
+    child.pid = pid;
+    child.pidfd = fd;
+    children.emplace(job.id, child);
+    ++counts.launched;
+    return true;
+}
+
+// Moves every thread of a bumped job's processes -- the shell and everything below it -- to the
+//   job's new CPUs.  Each thread's /proc children list leads to the processes it started, so this
+//   only looks at the job's own process tree.  The group is stopped, so nothing in it can start a
+//   new process while this walks it.  (A process that has left the tree by being orphaned is no
+//   longer found, and keeps its old CPUs.)
+void LocalExecutor::pin(int pid, const ScheduledJob& job)
+{
+    cpu_set_t set;
+    jobCpus(job, cpus, procScratch, set);
+
+    std::vector<int> pending(1, pid);
+    while(!pending.empty())
+    {
+        int next = pending.back();
+        pending.pop_back();
+        pinProcess(next, set, pending);
+    }
+}
+
+#else
+
+LocalExecutor::LocalExecutor(AnyScheduler& sch_, std::chrono::microseconds, std::vector<unsigned>)
+    : sch( sch_ )
+    , epfd( -1 )
+{
+    throw SchedulerException("Running jobs as processes is only supported on Linux");
+}
+
+LocalExecutor::~LocalExecutor()                             {}
+void LocalExecutor::run(std::chrono::microseconds)          {}
+void LocalExecutor::runUntil(tick_t)                        {}
+void LocalExecutor::runUntilIdle()                          {}
+
+#endif
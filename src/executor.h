@@ -0,0 +1,114 @@
+
+#ifndef EXECUTOR_H_INCLUDED
+#define EXECUTOR_H_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "anyscheduler.h"
+
+//  LocalExecutor runs a scheduler's jobs for real, as processes on this machine (Linux only).
+//
+//  A job's description is its command, run with /bin/sh -c in a process group of its own.  When
+//  the scheduler admits a job, its process starts pinned (sched_setaffinity) to the CPUs of the
+//  processors the job was given.  A bump stops the whole group (SIGSTOP), and the next admission
+//  re-pins the job's process to its new CPUs and continues it (SIGCONT).
+//
+//  The scheduler's clock follows the wall clock, one tick every 'tickLength'.  A job's ticks are
+//  its time limit:  if its process exits first, the job completes then (BasicScheduler::finishJob)
+//  and whatever fits in its processors starts right away, without waiting for the next tick.  If
+//  its ticks run out first, the scheduler completes it as usual and its process group is killed.
+//  Cancelling a job (BasicScheduler::cancelJob) kills its process group too, running or stopped.
+//
+//  Exits are noticed through a pidfd for each process, all waited on with one epoll, so an exit
+//  wakes the executor at once however many processes are running.  Each running process holds one
+//  file descriptor, so RLIMIT_NOFILE bounds how many can run at once.
+//
+//  Everything happens on the thread that calls run/runUntil/runUntilIdle, which must be the one
+//  that adds the scheduler's jobs.  The scheduler can't be used with anything else that sets its
+//  job handler (setJobHandler) while the executor is alive.
+
+struct ExecutorStats
+{
+    std::uint64_t   launched = 0;       // processes started
+    std::uint64_t   failed = 0;         // jobs whose process couldn't be started (they complete at once)
+    std::uint64_t   exited = 0;         // processes that exited before their job's ticks ran out
+    std::uint64_t   killed = 0;         // processes killed because their job's ticks ran out
+    std::uint64_t   cancelled = 0;      // processes killed because their job was cancelled (or withdrawn)
+    std::uint64_t   stopped = 0;        // bumps
+    std::uint64_t   resumed = 0;        // admissions of a bumped job
+};
+
+struct JobExit
+{
+    jobid_t         id;
+    int             status;             // as from waitpid, or -1 if the process couldn't be started
+    bool            killed;             // its ticks ran out, or its job was cancelled
+};
+
+class LocalExecutor
+{
+public:
+    // Processor i of 'sch' is CPU cpus[i].  With no 'cpus', it's the i-th CPU this process may run
+    //   on.  Throws SchedulerException if there are fewer CPUs than processors, or if the system
+    //   doesn't support pidfds (Linux 5.3 and up), or isn't Linux.
+                    LocalExecutor(AnyScheduler& sch, std::chrono::microseconds tickLength,
+                                  std::vector<unsigned> cpus = std::vector<unsigned>());
+                    ~LocalExecutor();       // kills every process that's still around
+
+    LocalExecutor(const LocalExecutor&) = delete;
+    LocalExecutor& operator = (const LocalExecutor&) = delete;
+
+    // Handles exits and ticks until 'timeout' has passed.  runUntil stops once the scheduler's
+    //   clock reaches 'tick' instead, and runUntilIdle once every job has completed and every
+    //   process is gone.
+    void            run(std::chrono::microseconds timeout);
+    void            runUntil(tick_t tick);
+    void            runUntilIdle();
+
+    // Called with every process as it's reaped (and every job that couldn't start)
+    void            setExitHandler(std::function<void(const JobExit&)> fn)      { onExit = std::move(fn);   }
+
+    ExecutorStats   stats() const           { return counts;                }
+    std::size_t     numProcesses() const    { return children.size();       }      // running, stopped or not yet reaped
+
+private:
+    struct Child
+    {
+        int             pid;
+        int             pidfd;
+        bool            stopped = false;
+        bool            killed = false;
+    };
+
+    AnyScheduler&                   sch;
+    std::chrono::microseconds       tickLength;
+    std::vector<unsigned>           cpus;
+    std::vector<unsigned char>      ownMask;            // this thread's CPUs (a cpu_set_t)
+    std::chrono::steady_clock::time_point   start;      // when the scheduler's clock was at 'startTick'
+    tick_t                          startTick;
+    int                             epfd;
+    std::unordered_map<jobid_t, Child>  children;
+    std::vector<jobid_t>            failures;           // jobs admitted this step whose process didn't start
+    std::vector<jobid_t>            finishing;          // jobs admitted this step that are in 'done'
+    std::unordered_set<jobid_t>     done;               // waiting jobs whose process has already exited
+    std::vector<procid_t>           procScratch;
+    ExecutorStats                   counts;
+    std::function<void(const JobExit&)> onExit;
+
+    // returns false if it stopped at 'deadline', true if 'done' said to stop
+    bool            step(std::chrono::steady_clock::time_point deadline, const std::function<bool()>& done);
+    std::chrono::steady_clock::time_point   timeOf(tick_t tick) const;     // when the scheduler's clock reaches 'tick'
+    void            catchUp();
+    void            settle();
+    void            reap(jobid_t id);
+    void            jobEvent(EventKind kind, const ScheduledJob& job);
+    bool            launch(const ScheduledJob& job);
+    void            pin(int pid, const ScheduledJob& job);
+};
+
+#endif
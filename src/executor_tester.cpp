@@ -0,0 +1,232 @@
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <sched.h>
+#include <sys/wait.h>
+#include "executor.h"
+
+using namespace std;
+
+//  Tests for LocalExecutor.  These start real processes, so they take a second or two.
+
+static const std::chrono::microseconds tickLength(10000);      // 10 ms
+static const char* cpuFile = "exectester.cpus";
+
+struct Run
+{
+    std::unique_ptr<AnyScheduler>   sch;
+    std::unique_ptr<LocalExecutor>  exec;
+    std::vector<JobExit>            exits;
+
+    Run(const char* policy, unsigned procs = 1, std::vector<unsigned> cpus = {})
+        : sch( makeScheduler(policy, procs) )
+        , exec( new LocalExecutor(*sch, tickLength, std::move(cpus)) )
+    {
+        exec->setExitHandler([this](const JobExit& e) { exits.push_back(e); });
+    }
+};
+
+// Jobs that exit before their ticks run out complete right then, with their exit status
+void testExits()
+{
+    Run r("fcfs");
+    r.sch->addJob(JobInfo{"exit 3", 1, 100});
+    r.sch->addJob(JobInfo{"true", 1, 100});
+    r.exec->runUntilIdle();
+
+    if(r.exits.size() != 2 || r.exits[0].id != 1 || r.exits[1].id != 2)
+        throw std::runtime_error("wrong exits");
+    if(!WIFEXITED(r.exits[0].status) || WEXITSTATUS(r.exits[0].status) != 3 || r.exits[0].killed
+       || !WIFEXITED(r.exits[1].status) || WEXITSTATUS(r.exits[1].status) != 0 || r.exits[1].killed)
+        throw std::runtime_error("wrong exit status");
+    if(r.sch->now() >= 100)
+        throw std::runtime_error("the jobs didn't complete until their ticks ran out");
+
+    ExecutorStats s = r.exec->stats();
+    if(s.launched != 2 || s.exited != 2 || s.killed || s.failed || r.exec->numProcesses())
+        throw std::runtime_error("wrong counts");
+}
+
+// A process still running when its job's ticks run out is killed
+void testTimeLimit()
+{
+    Run r("fcfs");
+    r.sch->addJob(JobInfo{"sleep 10", 1, 5});
+    auto start = std::chrono::steady_clock::now();
+    r.exec->runUntilIdle();
+
+    if(std::chrono::steady_clock::now() - start > std::chrono::seconds(2))
+        throw std::runtime_error("the job wasn't killed when its ticks ran out");
+    if(r.exits.size() != 1 || !r.exits[0].killed || !WIFSIGNALED(r.exits[0].status) || WTERMSIG(r.exits[0].status) != SIGKILL)
+        throw std::runtime_error("wrong exit");
+    if(r.exec->stats().killed != 1 || r.sch->now() != 5)
+        throw std::runtime_error("wrong counts");
+}
+
+// The process runs on the CPU of the processor it was given
+void testPinning()
+{
+    cpu_set_t own;
+    sched_getaffinity(0, sizeof(own), &own);
+    unsigned first = 0;
+    while(!CPU_ISSET(first, &own))
+        ++first;
+
+    Run r("fcfs");
+    r.sch->addJob(JobInfo{string("grep Cpus_allowed_list /proc/self/status > ") + cpuFile, 1, 100});
+    r.exec->runUntilIdle();
+
+    ifstream in(cpuFile);
+    string line;
+    getline(in, line);
+    in.close();
+    std::remove(cpuFile);
+    if(line != "Cpus_allowed_list:\t" + to_string(first))
+        throw std::runtime_error("the process ran on '" + line + "', not CPU " + to_string(first));
+}
+
+static string readLine(const char* path)
+{
+    ifstream in(path);
+    string line;
+    getline(in, line);
+    return line;
+}
+
+// A job that comes back on other CPUs after a bump takes the processes its shell started with it.
+//   Needs two CPUs to show anything.
+void testRepin()
+{
+    cpu_set_t own;
+    sched_getaffinity(0, sizeof(own), &own);
+    std::vector<unsigned> cpus;
+    for(unsigned c = 0; c < CPU_SETSIZE && cpus.size() < 2; ++c)
+    {
+        if(CPU_ISSET(c, &own))
+            cpus.push_back(c);
+    }
+    if(cpus.size() < 2)
+        return;
+
+    static const char* before = "exectester.before";
+    static const char* after = "exectester.after";
+    std::remove(before);
+    std::remove(after);
+
+    // the job starts on the first processor and gets bumped by a shorter job, which takes that
+    //   processor back.  It comes back on the other one when the job there is cancelled.  The
+    //   background child checks its CPUs after that.
+    Run r("sjf", 2, cpus);
+    r.sch->addJob(JobInfo{string("grep Cpus_allowed_list /proc/self/status > ") + before
+                          + "; (sleep 0.3; grep Cpus_allowed_list /proc/self/status > " + after + ") & wait", 1, 1000});
+    r.exec->runUntil(1);
+    r.sch->addJob(JobInfo{"sleep 10", 1, 800});
+    r.exec->runUntil(2);
+    r.sch->addJob(JobInfo{"sleep 10", 1, 100});      // bumps the first job
+    r.exec->runUntil(3);
+    r.sch->cancelJob(2);
+    r.exec->runUntil(5);
+
+    string moved;
+    for(int i = 0; i < 200 && moved.empty(); ++i)
+    {
+        r.exec->run(std::chrono::milliseconds(10));
+        moved = readLine(after);
+    }
+    string started = readLine(before);
+    r.sch->cancelJob(1);
+    r.sch->cancelJob(3);
+    r.exec->runUntilIdle();
+    std::remove(before);
+    std::remove(after);
+
+    if(!r.exec->stats().stopped || r.exec->stats().resumed != r.exec->stats().stopped)
+        throw std::runtime_error("the job wasn't bumped and resumed");
+    if(started.empty() || moved.empty() || started == moved)
+        throw std::runtime_error("the job's child stayed on '" + started + "' after the job moved (now '" + moved + "')");
+}
+
+// A bump stops the running process, and it carries on when it's admitted again
+void testBump()
+{
+    Run r("sjf");
+    r.sch->addJob(JobInfo{"sleep 0.2", 1, 100});
+    r.exec->runUntil(2);
+    r.sch->addJob(JobInfo{"true", 1, 5});
+    r.exec->runUntilIdle();
+
+    ExecutorStats s = r.exec->stats();
+    if(s.stopped != 1 || s.resumed != 1 || s.launched != 2 || s.exited != 2)
+        throw std::runtime_error("the long job wasn't stopped and resumed");
+    if(r.exits.size() != 2 || r.exits[0].id != 2 || r.exits[1].id != 1 || r.exits[1].killed || WEXITSTATUS(r.exits[1].status) != 0)
+        throw std::runtime_error("wrong exits");
+    if(r.sch->getMetrics().bumps != 1)
+        throw std::runtime_error("the scheduler didn't count the bump");
+}
+
+// Cancelling a job kills its process, whether it's running or stopped by a bump
+void testCancel()
+{
+    Run r("sjf");
+    r.sch->addJob(JobInfo{"sleep 10", 1, 1000});
+    r.exec->runUntil(2);
+    r.sch->addJob(JobInfo{"sleep 10", 1, 500});       // bumps the first one
+    r.exec->runUntil(4);
+    auto start = std::chrono::steady_clock::now();
+    if(!r.sch->cancelJob(1) || !r.sch->cancelJob(2))
+        throw std::runtime_error("the jobs weren't there to cancel");
+    r.exec->runUntilIdle();
+
+    if(std::chrono::steady_clock::now() - start > std::chrono::seconds(2))
+        throw std::runtime_error("the cancelled jobs' processes weren't killed");
+    ExecutorStats s = r.exec->stats();
+    if(s.stopped != 1 || s.cancelled != 2 || s.killed || s.exited || r.exits.size() != 2 || !r.exits[0].killed || !r.exits[1].killed)
+        throw std::runtime_error("wrong counts");
+    if(r.sch->getMetrics().jobsCompleted != 0)
+        throw std::runtime_error("cancelled jobs counted as completed");
+}
+
+// Many short jobs back to back:  each one starts as soon as the one before exits, not on the
+//   next tick.  With 10 ms ticks, waiting for ticks would take 5 seconds.
+void testBackToBack()
+{
+    const int count = 500;
+    Run r("fcfs");
+    for(int i = 0; i < count; ++i)
+        r.sch->addJob(JobInfo{"true", 1, 1000});
+    auto start = std::chrono::steady_clock::now();
+    r.exec->runUntilIdle();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if(r.exec->stats().exited != count || r.exits.size() != count)
+        throw std::runtime_error("not every job ran");
+    if(elapsed.count() > count * 0.005)
+        throw std::runtime_error("jobs waited for ticks to start (" + to_string(elapsed.count()) + " sec)");
+}
+
+int main()
+{
+    cout << "Beginning executor test:  ";
+    try
+    {
+        testExits();
+        testTimeLimit();
+        testPinning();
+        testBump();
+        testRepin();
+        testCancel();
+        testBackToBack();
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include "scheduler.h"
+
+using namespace std;
+
+//  Stress test for Scheduler::submitJob.  Build with 'make TSAN=1' to run it under
+//  ThreadSanitizer.
+
+static const int iterations = 20;       // number of tests to perform
+static const int numproducers = 4;      // submitting threads
+static const int perproducer = 5000;    // jobs submitted by each thread
+static const unsigned numprocs = 64;
+
+// Several threads submit jobs while the main thread keeps ticking the scheduler.  Every job
+//   has to come back with its own ID and end up in the scheduler exactly once.
+void testIngress(unsigned seed)
+{
+    Scheduler sch(numprocs);
+
+    std::atomic<int> running(numproducers);
+    std::atomic<bool> invalidAccepted(false);
+    std::vector<std::vector<jobid_t>> ids(numproducers);
+    std::vector<std::thread> producers;
+
+    for(int p = 0; p < numproducers; ++p)
+    {
+        producers.emplace_back([&, p]()
+        {
+            std::minstd_rand rng(seed + p);
+            for(int i = 0; i < perproducer; ++i)
+            {
+                JobInfo info;
+                info.description = "p" + to_string(p) + "_" + to_string(i);
+                info.numProcs = rng() % numprocs + 1;
+                info.numTicks = 1000000000 + rng() % 1000;      // long enough that nothing completes during the test
+                ids[p].push_back( sch.submitJob(info) );
+
+                // an invalid job has to be turned away without using up an ID
+                if(i % 1000 == 0)
+                {
+                    info.numProcs = numprocs + 1;
+                    if(sch.submitJob(info) != NoJob)
+                        invalidAccepted = true;         // can't throw from here -- checked below
+                }
+            }
+            --running;
+        });
+    }
+
+    while(running > 0)
+        sch.tick();
+    for(auto& t : producers)
+        t.join();
+    sch.advance(0);         // pick up whatever was submitted after the last tick
+
+    if(invalidAccepted)
+        throw std::runtime_error("invalid job was accepted");
+
+    std::vector<jobid_t> all;
+    for(auto& v : ids)
+        all.insert(all.end(), v.begin(), v.end());
+
+    std::sort(all.begin(), all.end());
+    if(std::find(all.begin(), all.end(), NoJob) != all.end())
+        throw std::runtime_error("submitJob returned NoJob for a valid job");
+    if(std::adjacent_find(all.begin(), all.end()) != all.end())
+        throw std::runtime_error("duplicate job ID handed out");
+
+    for(auto id : all)
+    {
+        if(sch.getJobState(id) == JobState::Unknown)
+            throw std::runtime_error("submitted job " + to_string(id) + " never reached the scheduler");
+    }
+
+    // and the scheduler thread can still add jobs of its own alongside them
+    JobInfo info;
+    info.description = "local";
+    info.numProcs = 1;
+    info.numTicks = 1;
+    if(!sch.addJob(info))
+        throw std::runtime_error("addJob failed");
+}
+
+int main()
+{
+    srand((unsigned)time(nullptr));
+
+    std::vector<unsigned> seeds;
+    seeds.reserve(iterations);
+    for(int i = 0; i < iterations; ++i)
+        seeds.push_back( rand() );
+
+    for(auto& seed : seeds)
+    {
+        cout << "Beginning ingress test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+        try
+        {
+            testIngress(seed);
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
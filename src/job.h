@@ -3,8 +3,15 @@
 #define JOB_H_INCLUDED
 
 #include <string>
-#include <memory>
 #include "types.h"
+#include "procset.h"
+
+enum class JobState
+{
+    Unknown,        // no such job (never existed, or has completed)
+    Waiting,        // in the wait queue
+    Active          // currently running
+};
 
 struct JobInfo
 {
@@ -13,26 +20,74 @@ struct JobInfo
     unsigned        numTicks;
 };
 
-struct ScheduledJob
+// A waiting job on its way from one scheduler to another (see BasicScheduler::takeWaitingJob).
+//   It keeps its ID and its history:  when it was submitted, and if it has been bumped, when it
+//   first started, how many times, and its remaining ticks.
+struct PortableJob
 {
-    JobInfo                     info;           // supplied info about the job
-    jobid_t                     id;             // unique ID assigned to this job
-    unsigned                    ticksRemaining; // number of ticks remaining until the job is complete
-    std::unique_ptr<procid_t[]> procsUsed;      // list of processors currently occupied by the job.
+    jobid_t         id;
+    JobInfo         info;
+    unsigned        ticksRemaining;
+    unsigned        bumps;
+    tick_t          submitTick;
+    tick_t          startTick;      // NoTick if it hasn't started
+};
+
+// The fields of a job that decide its place in the wait queue.  Small enough that a queue can
+//   keep them apart from the rest of the job (see BlockList).
+struct JobKey
+{
+    std::uint64_t               rank;           // from the scheduling policy (see policy.h)
+    jobid_t                     id;
+    unsigned                    numProcs;
+    unsigned                    ticksRemaining; // not part of the order (it fills what would be padding)
 
-    bool operator < (const ScheduledJob& rhs) const
+    bool operator < (const JobKey& rhs) const
     {
-        // sort by ticksRemaining first (ascending)
-        if(ticksRemaining < rhs.ticksRemaining)     return true;
-        if(ticksRemaining > rhs.ticksRemaining)     return false;
+        // sort by rank first (ascending)
+        if(rank < rhs.rank)                         return true;
+        if(rank > rhs.rank)                         return false;
 
         // sort by numProcs next (descending)
-        if(info.numProcs > rhs.info.numProcs)       return true;
-        if(info.numProcs < rhs.info.numProcs)       return false;
+        if(numProcs > rhs.numProcs)                 return true;
+        if(numProcs < rhs.numProcs)                 return false;
 
         // and by job id last because whynot (ascending)
         return id < rhs.id;
     }
 };
 
+// A job as the scheduler keeps it.  There can be millions of these waiting, so they're kept
+//   small:  the description is an ID in the scheduler's string table, and processors are only
+//   stored while the job is running.
+struct ScheduledJob
+{
+    jobid_t                     id;             // unique ID assigned to this job
+    union
+    {
+        tick_t                  endTick;        // while the job is active:  absolute tick at which the job completes
+        std::uint64_t           rank;           // while it waits:  its place in the queue (see JobKey)
+    };
+    ProcSet                     procsUsed;      // processors currently occupied by the job (empty while it waits)
+    strid_t                     description;    // see Scheduler::getDescription
+    unsigned                    numProcs;
+    unsigned                    numTicks;       // as submitted
+    unsigned                    ticksRemaining; // number of ticks remaining until the job is complete (only kept up to date while waiting)
+    unsigned                    bumps;          // times it has been put back in the wait queue
+    tick_t                      submitTick;
+    tick_t                      startTick;      // the first time it started (NoTick until then)
+
+    JobKey key() const
+    {
+        JobKey k;
+        k.rank = rank;
+        k.numProcs = numProcs;
+        k.ticksRemaining = ticksRemaining;
+        k.id = id;
+        return k;
+    }
+
+    bool operator < (const ScheduledJob& rhs) const     { return key() < rhs.key();     }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+
+#ifndef JOBIDMAP_H_INCLUDED
+#define JOBIDMAP_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include "types.h"
+
+//  JobIdMap is a flat hash table keyed by job ID.
+//
+//  All entries live in one array (open addressing with linear probing), so there is no
+//  per-entry allocation, and insert/find/erase are all O(1) expected.
+//
+//  Job IDs are handed out sequentially, so live IDs are mostly a dense range.  Using their low
+//  bits as the hash would place them without collisions, but as one long run of full slots --
+//  and erasing has to scan to the end of the run, so a scheduler that finishes jobs in ID order
+//  (FirstComeFirstServed) would pay for every live job on every erase.  Fibonacci hashing
+//  (multiply, keep the top bits) spreads consecutive IDs evenly over the table instead.
+//
+//  'NoJob' is used to mark empty slots, so it can't be used as a key.
+template <typename V>
+class JobIdMap
+{
+public:
+    JobIdMap()                              { slots.resize(MinSlots);   }
+
+    std::size_t     size() const            { return count;             }
+    bool            empty() const           { return !count;            }
+    bool            contains(jobid_t id) const      { return find(id) != nullptr;   }
+
+    // Returns null if 'id' isn't in the map
+    V* find(jobid_t id)
+    {
+        return const_cast<V*>( static_cast<const JobIdMap*>(this)->find(id) );
+    }
+
+    const V* find(jobid_t id) const
+    {
+        for(std::size_t i = home(id); ; i = (i + 1) & mask())
+        {
+            if(slots[i].key == id)          return &slots[i].value;
+            if(slots[i].key == NoJob)       return nullptr;
+        }
+    }
+
+    // Adds 'id' to the map (or replaces its value if it's already there)
+    V& insert(jobid_t id, const V& v)
+    {
+        if((count + 1) * 2 > slots.size())      // keep the load factor at or below 1/2
+            grow();
+
+        std::size_t i = home(id);
+        while(slots[i].key != NoJob && slots[i].key != id)
+            i = (i + 1) & mask();
+
+        if(slots[i].key == NoJob)
+            ++count;
+        slots[i].key = id;
+        slots[i].value = v;
+        return slots[i].value;
+    }
+
+    // Removes 'id' from the map.  Returns false if it wasn't there.
+    bool erase(jobid_t id)
+    {
+        std::size_t i = home(id);
+        while(slots[i].key != id)
+        {
+            if(slots[i].key == NoJob)       return false;
+            i = (i + 1) & mask();
+        }
+
+        // Backward shift deletion:  pull later entries of the probe sequence into the hole so
+        //   lookups never need tombstones.
+        std::size_t j = i;
+        while(true)
+        {
+            j = (j + 1) & mask();
+            if(slots[j].key == NoJob)
+                break;
+
+            // can the entry at 'j' legally move to 'i'?  Only if its home isn't cyclically in (i, j]
+            std::size_t k = home(slots[j].key);
+            bool stay = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+            if(!stay)
+            {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i].key = NoJob;
+        slots[i].value = V();
+        --count;
+        return true;
+    }
+
+    // Makes room for 'n' entries, so that many inserts won't have to grow the table
+    void reserve(std::size_t n)
+    {
+        while(n * 2 > slots.size())
+            grow();
+    }
+
+    void clear()
+    {
+        slots.assign(MinSlots, Slot());
+        shift = MinShift;
+        count = 0;
+    }
+
+    // Calls fn(id, value) for every entry, in no particular order
+    template <typename Fn>
+    void forEach(Fn fn) const
+    {
+        for(auto& i : slots)
+        {
+            if(i.key != NoJob)
+                fn(i.key, i.value);
+        }
+    }
+
+private:
+    static const std::size_t MinSlots = 64;     // must be a power of 2
+    static const unsigned    MinShift = 64 - 6;
+
+    struct Slot
+    {
+        jobid_t     key = NoJob;
+        V           value = V();
+    };
+
+    std::vector<Slot>   slots;
+    std::size_t         count = 0;
+    unsigned            shift = MinShift;       // 64 - log2(slots.size())
+
+    std::size_t     mask() const                { return slots.size() - 1;          }
+    std::size_t     home(jobid_t id) const
+    {
+        return static_cast<std::size_t>( (static_cast<std::uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> shift );
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        --shift;
+        for(auto& i : old)
+        {
+            if(i.key == NoJob)      continue;
+            std::size_t j = home(i.key);
+            while(slots[j].key != NoJob)
+                j = (j + 1) & mask();
+            slots[j] = i;
+        }
+    }
+};
+
+#endif
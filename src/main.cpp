@@ -5,20 +5,25 @@
 
 void doTicks(Scheduler& sch, int ticks)
 {
-    for(int i = 0; i < ticks; ++i)
-        sch.tick();
+    sch.advance(ticks);
 
-    std::cout << "\n";
-    sch.printActiveJobs(std::cout);
-    std::cout << "\n\n";
-    sch.printWaitQueue(std::cout);
-    std::cout << std::endl;
+    // write the tables straight to stdout, rather than formatting them through iostreams
+    std::cout.flush();
+
+    static char buf[64 * 1024];
+    DumpWriter out(buf, sizeof(buf), 1);
+    out.put('\n');
+    sch.dumpActiveJobs(out);
+    out.write("\n\n");
+    sch.dumpWaitQueue(out);
+    out.put('\n');
+    out.flush();
 }
 
-void runprogram(unsigned procs)
+void runprogram(unsigned procs, unsigned groupsize)
 {
     bool run = true;
-    Scheduler sch{procs};
+    Scheduler sch{procs, groupsize};
     
     JobInfo info;
     int i;
@@ -66,6 +71,7 @@ int main(int argc, char* argv[])
     static const unsigned defNumProcs = 5;       // default to 5 procs
 
     unsigned numprocs = defNumProcs;
+    unsigned groupsize = 0;
 
     // get the number of procs from argv
     if(argc >= 2) {
@@ -77,9 +83,13 @@ int main(int argc, char* argv[])
         }
     }
 
+    // optional processor grouping (processors per socket/node)
+    if(argc >= 3)
+        groupsize = std::stoul(argv[2]);
+
     std::cout << "Scheduler started with " << numprocs << " processors.\n";
     std::cout << "To add a job, type <jobname> <num processors> <num ticks>.\n";
     std::cout << "To run for any number of ticks, input the number of ticks (0 is valid).\n";
     std::cout << "To exit, type \"exit\".\n";
-    runprogram(numprocs);
+    runprogram(numprocs, groupsize);
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+
+#include "mappedfile.h"
+#include "types.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        throw SchedulerException("Unable to open file '" + path + "'");
+    fileHandle = file;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw SchedulerException("Unable to get size of file '" + path + "'");
+    }
+    len = static_cast<std::size_t>(size.QuadPart);
+    if(!len)
+        return;         // can't map an empty file, but there's nothing to read anyway
+
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!map)
+    {
+        CloseHandle(file);
+        throw SchedulerException("Unable to map file '" + path + "'");
+    }
+    mapHandle = map;
+
+    ptr = static_cast<const char*>( MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) );
+    if(!ptr)
+    {
+        CloseHandle(map);
+        CloseHandle(file);
+        throw SchedulerException("Unable to map file '" + path + "'");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if(ptr)             UnmapViewOfFile(ptr);
+    if(mapHandle)       CloseHandle(mapHandle);
+    if(fileHandle)      CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw SchedulerException("Unable to open file '" + path + "'");
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw SchedulerException("Unable to get size of file '" + path + "'");
+    }
+    len = static_cast<std::size_t>(st.st_size);
+    if(len)         // can't map an empty file, but there's nothing to read anyway
+    {
+        void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            close(fd);
+            throw SchedulerException("Unable to map file '" + path + "'");
+        }
+        madvise(p, len, MADV_SEQUENTIAL);
+        ptr = static_cast<const char*>(p);
+    }
+    close(fd);      // the mapping stays valid after the descriptor is closed
+}
+
+MappedFile::~MappedFile()
+{
+    if(ptr)
+        munmap(const_cast<char*>(ptr), len);
+}
+
+#endif
@@ -0,0 +1,30 @@
+
+#ifndef MAPPEDFILE_H_INCLUDED
+#define MAPPEDFILE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+//  Read-only memory mapping of an entire file.
+class MappedFile
+{
+public:
+    explicit        MappedFile(const std::string& path);        // throws SchedulerException on failure
+                    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    const char*     data() const    { return ptr;       }
+    std::size_t     size() const    { return len;       }
+
+private:
+    const char*     ptr = nullptr;
+    std::size_t     len = 0;
+#if defined(_WIN32)
+    void*           fileHandle = nullptr;
+    void*           mapHandle = nullptr;
+#endif
+};
+
+#endif
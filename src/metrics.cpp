@@ -0,0 +1,207 @@
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "metrics.h"
+
+constexpr double QuantileSketch::MinValue;
+constexpr double QuantileSketch::MaxValue;
+
+QuantileSketch::QuantileSketch(double accuracy_)
+    : accuracy(accuracy_)
+{
+    if(!(accuracy > 0 && accuracy < 1))
+        throw SchedulerException("A quantile sketch's accuracy has to be between 0 and 1");
+
+    gamma = (1 + accuracy) / (1 - accuracy);
+    logGamma = std::log(gamma);
+}
+
+int QuantileSketch::indexOf(double v) const
+{
+    if(v > MaxValue)
+        v = MaxValue;
+    return static_cast<int>(std::ceil(std::log(v) / logGamma));
+}
+
+void QuantileSketch::add(double v, std::uint64_t weight)
+{
+    if(!weight || std::isnan(v))
+        return;
+
+    if(!total || v < lo)    lo = v;
+    if(!total || v > hi)    hi = v;
+    total += weight;
+    sum += v * weight;
+
+    if(v <= MinValue)
+    {
+        zeros += weight;
+        return;
+    }
+
+    bucket(indexOf(v)) += weight;
+}
+
+// Bucket 'i', widening the range of buckets kept to include it
+std::uint64_t& QuantileSketch::bucket(int i)
+{
+    if(buckets.empty())
+    {
+        buckets.assign(1, 0);
+        firstIndex = i;
+    }
+    else if(i < firstIndex)
+    {
+        buckets.insert(buckets.begin(), firstIndex - i, 0);
+        firstIndex = i;
+    }
+    else if(i - firstIndex >= static_cast<int>(buckets.size()))
+        buckets.resize(i - firstIndex + 1, 0);
+
+    return buckets[i - firstIndex];
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    if(other.accuracy != accuracy)
+        throw SchedulerException("Only quantile sketches with the same accuracy can be merged");
+    if(!other.total)
+        return;
+
+    if(!total || other.lo < lo)     lo = other.lo;
+    if(!total || other.hi > hi)     hi = other.hi;
+    total += other.total;
+    sum += other.sum;
+    zeros += other.zeros;
+
+    for(std::size_t k = 0; k < other.buckets.size(); ++k)
+    {
+        if(other.buckets[k])
+            bucket(other.firstIndex + static_cast<int>(k)) += other.buckets[k];
+    }
+}
+
+void QuantileSketch::reset()
+{
+    buckets.clear();
+    firstIndex = 0;
+    zeros = total = 0;
+    sum = lo = hi = 0;
+}
+
+// Each bucket reports the middle of its range (relative to its bounds), which is within
+//   'accuracy' of anything in it.  Clamped to what was actually seen, so the extremes are exact.
+double QuantileSketch::quantile(double q) const
+{
+    if(!total)
+        return 0;
+    if(q <= 0)      return lo;
+    if(q >= 1)      return hi;
+
+    double rank = q * (total - 1);
+    double seen = static_cast<double>(zeros);
+    if(seen > rank)
+        return lo;
+
+    for(std::size_t k = 0; k < buckets.size(); ++k)
+    {
+        seen += buckets[k];
+        if(seen > rank)
+        {
+            double v = 2 * std::pow(gamma, firstIndex + static_cast<int>(k)) / (gamma + 1);
+            return v < lo ? lo : (v > hi ? hi : v);
+        }
+    }
+    return hi;
+}
+
+//////////////////////////////////////////////
+
+MetricSummary MetricSummary::of(const QuantileSketch& s)
+{
+    MetricSummary m;
+    m.count = s.count();
+    m.mean = s.mean();
+    m.p50 = s.quantile(0.50);
+    m.p95 = s.quantile(0.95);
+    m.p99 = s.quantile(0.99);
+    m.max = s.max();
+    return m;
+}
+
+void SchedMetrics::completed(const JobMetrics& job)
+{
+    tick_t response = job.endTick - job.submitTick;
+    tick_t waited = response > job.ticksRun ? response - job.ticksRun : 0;
+    unsigned bound = job.ticksRun > SlowdownBound ? job.ticksRun : SlowdownBound;
+    double bsld = static_cast<double>(response) / bound;
+
+    wait.add(static_cast<double>(waited));
+    slowdown.add(bsld < 1 ? 1 : bsld);
+    ++jobs;
+    bumps += job.bumps;
+}
+
+SchedulerMetrics SchedMetrics::get() const
+{
+    SchedulerMetrics m;
+    m.jobsCompleted = jobs;
+    m.bumps = bumps;
+    m.wait = MetricSummary::of(wait);
+    m.slowdown = MetricSummary::of(slowdown);
+    m.utilization = MetricSummary::of(util);
+    return m;
+}
+
+void SchedMetrics::merge(const SchedMetrics& other)
+{
+    wait.merge(other.wait);
+    slowdown.merge(other.slowdown);
+    util.merge(other.util);
+    jobs += other.jobs;
+    bumps += other.bumps;
+}
+
+void SchedMetrics::reset()
+{
+    wait.reset();
+    slowdown.reset();
+    util.reset();
+    jobs = bumps = 0;
+}
+
+//////////////////////////////////////////////
+
+namespace
+{
+    std::size_t writeDouble(DumpWriter& out, double v, int decimals)
+    {
+        char buf[64];
+        int n = std::snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        return out.writeText(buf, n > 0 ? static_cast<std::size_t>(n) : 0);
+    }
+
+    void writeSummary(DumpWriter& out, const char* name, const MetricSummary& m, int decimals)
+    {
+        out.pad(13, out.writeText(name, std::strlen(name)));    out.write("| ");
+        out.pad(11, writeDouble(out, m.mean, decimals));        out.write("| ");
+        out.pad(11, writeDouble(out, m.p50, decimals));         out.write("| ");
+        out.pad(11, writeDouble(out, m.p95, decimals));         out.write("| ");
+        out.pad(11, writeDouble(out, m.p99, decimals));         out.write("| ");
+        writeDouble(out, m.max, decimals);
+        out.put('\n');
+    }
+}
+
+void SchedulerMetrics::dump(DumpWriter& out) const
+{
+    out.write("Jobs completed:       ");    out.writeUInt(jobsCompleted);       out.put('\n');
+    out.write("Bumps:                ");    out.writeUInt(bumps);               out.put('\n');
+
+    out.write("\nMetric       | Mean       | p50        | p95        | p99        | Max\n");
+    out.write("--------------------------------------------------------------------------\n");
+    writeSummary(out, "wait (ticks)", wait, 1);
+    writeSummary(out, "slowdown", slowdown, 2);
+    writeSummary(out, "utilization", utilization, 3);
+}
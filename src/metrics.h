@@ -0,0 +1,125 @@
+
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "types.h"
+#include "dumpwriter.h"
+
+//  Scheduling metrics:  how long jobs waited, how much waiting slowed them down, and how busy the
+//  processors were.  Unlike SchedStats these are always on.  They only cost a few arithmetic
+//  operations per completion and per clock jump, and they take the same memory however many
+//  jobs go by.
+
+//  QuantileSketch estimates quantiles of a stream of values in constant memory.
+//
+//  Values go into logarithmic buckets:  bucket i counts the values in (g^(i-1), g^i], where
+//  g = (1 + accuracy) / (1 - accuracy).  Any quantile it reports is within 'accuracy' (relative)
+//  of a value that really is at that rank.  Values at or below MinValue count as 0, and values
+//  over MaxValue as MaxValue, so there are never more than about 3100 buckets (at 1%), and
+//  usually a few hundred.  Values can carry a weight, and two sketches with the same accuracy
+//  can be merged.
+class QuantileSketch
+{
+public:
+    static constexpr double     MinValue = 1e-9;
+    static constexpr double     MaxValue = 1e18;
+
+    explicit        QuantileSketch(double accuracy = 0.01);
+
+    void            add(double v, std::uint64_t weight = 1);
+    void            merge(const QuantileSketch& other);     // throws SchedulerException if the accuracies differ
+    void            reset();
+
+    double          quantile(double q) const;       // q from 0 to 1.  0 if the sketch is empty
+    std::uint64_t   count() const       { return total;                             }   // total weight
+    double          mean() const        { return total ? sum / total : 0;           }
+    double          min() const         { return total ? lo : 0;                    }
+    double          max() const         { return total ? hi : 0;                    }
+
+private:
+    double                      accuracy;
+    double                      gamma;
+    double                      logGamma;
+    std::vector<std::uint64_t>  buckets;
+    int                         firstIndex = 0;     // bucket index of buckets[0]
+    std::uint64_t               zeros = 0;
+    std::uint64_t               total = 0;
+    double                      sum = 0;
+    double                      lo = 0;
+    double                      hi = 0;
+
+    int             indexOf(double v) const;
+    std::uint64_t&  bucket(int i);
+};
+
+struct MetricSummary
+{
+    std::uint64_t   count = 0;
+    double          mean = 0;
+    double          p50 = 0;
+    double          p95 = 0;
+    double          p99 = 0;
+    double          max = 0;
+
+    static MetricSummary    of(const QuantileSketch& s);
+};
+
+struct SchedulerMetrics
+{
+    std::uint64_t   jobsCompleted = 0;
+    std::uint64_t   bumps = 0;              // how many times completed jobs were bumped, in all
+    MetricSummary   wait;                   // ticks each completed job spent waiting, before it started and after bumps
+    MetricSummary   slowdown;               // each completed job's bounded slowdown (see SchedMetrics)
+    MetricSummary   utilization;            // fraction of processors busy, weighted by processor-ticks
+
+    void            dump(DumpWriter& out) const;
+};
+
+// One job's progress
+struct JobMetrics
+{
+    jobid_t         id;
+    tick_t          submitTick;
+    tick_t          startTick;          // the first time it started (NoTick if it hasn't)
+    tick_t          endTick;            // NoTick until it completes
+    unsigned        bumps;
+    unsigned        numProcs;
+    unsigned        numTicks;
+    unsigned        ticksRun;           // so far.  All of numTicks once it completes, unless it finished early
+};
+
+//  The scheduler's collector.  Bounded slowdown is (end - submit) / max(ticksRun, SlowdownBound):
+//  how many times longer than its own length a job took, where jobs shorter than SlowdownBound
+//  count as that long, so a 1 tick job that waits 5 ticks isn't a slowdown of 6.
+class SchedMetrics
+{
+public:
+    static const unsigned   SlowdownBound = 10;
+
+    // 'busy' of 'procs' processors were in use for the last 'ticks' ticks
+    void            passTime(unsigned busy, unsigned procs, tick_t ticks)
+    {
+        if(ticks)
+            util.add(static_cast<double>(busy) / procs, ticks * procs);
+    }
+    void            completed(const JobMetrics& job);
+
+    SchedulerMetrics    get() const;
+    void            merge(const SchedMetrics& other);
+    void            reset();
+
+    const QuantileSketch&   waitTicks() const       { return wait;      }
+    const QuantileSketch&   slowdowns() const       { return slowdown;  }
+    const QuantileSketch&   utilization() const     { return util;      }
+
+private:
+    QuantileSketch  wait;
+    QuantileSketch  slowdown;
+    QuantileSketch  util;
+    std::uint64_t   jobs = 0;
+    std::uint64_t   bumps = 0;
+};
+
+#endif
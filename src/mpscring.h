@@ -0,0 +1,102 @@
+
+#ifndef MPSCRING_H_INCLUDED
+#define MPSCRING_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+//  MpscRing is a bounded, lock-free queue for any number of producer threads and exactly one
+//  consumer thread.
+//
+//  Every slot carries a sequence number that says whose turn it is:  a producer claims a slot by
+//  advancing 'tail' with a CAS, fills it, then publishes it by bumping the slot's sequence.  The
+//  consumer only reads slots that have been published, and hands each one back to the producers
+//  by bumping its sequence again.  Producers only ever retry a CAS, never wait on one another; a
+//  producer that stalls between claiming and publishing its slot just makes the consumer see the
+//  ring as empty at that slot until it finishes.
+//
+//  Capacity is rounded up to a power of 2.
+template <typename T>
+class MpscRing
+{
+public:
+    explicit MpscRing(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while(size < capacity)
+            size *= 2;
+
+        slots.reset(new Slot[size]);
+        slotMask = size - 1;
+        for(std::size_t i = 0; i < size; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+
+        head = 0;
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator = (const MpscRing&) = delete;
+
+    std::size_t     capacity() const        { return slotMask + 1;      }
+
+    // Any thread.  Returns false (and leaves 'v' alone) if the ring is full.
+    bool tryPush(T&& v)
+    {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        while(true)
+        {
+            Slot& s = slots[pos & slotMask];
+            std::size_t seq = s.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if(diff == 0)           // slot is free for this lap -- try to claim it
+            {
+                if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    s.value = std::move(v);
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+                // CAS failure reloaded 'pos'; go again
+            }
+            else if(diff < 0)       // consumer hasn't emptied this slot from the last lap:  full
+                return false;
+            else                    // another producer got here first
+                pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Consumer thread only.  Returns false if nothing has been published yet.
+    bool tryPop(T& out)
+    {
+        Slot& s = slots[head & slotMask];
+        if(s.seq.load(std::memory_order_acquire) != head + 1)
+            return false;
+
+        out = std::move(s.value);
+        s.seq.store(head + slotMask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t>    seq;
+        T                           value;
+    };
+
+    std::unique_ptr<Slot[]>     slots;
+    std::size_t                 slotMask;
+
+    // The consumer's and producers' cursors are padded onto separate cache lines so that pushing
+    //   doesn't keep stealing the line the consumer is polling.
+    char                        pad0[64];
+    std::size_t                 head;       // consumer only
+    char                        pad1[64];
+    std::atomic<std::size_t>    tail;
+};
+
+#endif
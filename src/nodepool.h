@@ -0,0 +1,151 @@
+
+#ifndef NODEPOOL_H_INCLUDED
+#define NODEPOOL_H_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+//  NodeArena is a slab allocator for small, fixed size objects (container nodes).
+//
+//  Storage is carved out of large slabs, and freed blocks go onto a free list for their size
+//  class, so once the arena has warmed up, allocating and freeing nodes never touches the heap.
+//  Memory is only given back when the arena itself is destroyed.
+//
+//  Requests larger than 'MaxBlock' (or for more than one object at a time) fall through to
+//  the normal heap.
+//
+//  This is not thread safe -- an arena should only be used by one thread at a time.
+class NodeArena
+{
+public:
+    static constexpr std::size_t    Granularity = alignof(std::max_align_t);
+    static constexpr std::size_t    MaxBlock = 512;
+
+    NodeArena() : freeLists(MaxBlock / Granularity + 1, nullptr) {}
+    ~NodeArena()
+    {
+        for(auto& i : slabs)
+            ::operator delete(i);
+    }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator = (const NodeArena&) = delete;
+
+    void* allocate(std::size_t bytes)
+    {
+        if(bytes > MaxBlock)            return ::operator new(bytes);
+
+        auto cls = sizeClass(bytes);
+        FreeBlock* blk = freeLists[cls];
+        if(blk)
+        {
+            freeLists[cls] = blk->next;
+            return blk;
+        }
+        return carve(cls * Granularity);
+    }
+
+    void deallocate(void* p, std::size_t bytes)
+    {
+        if(bytes > MaxBlock)
+        {
+            ::operator delete(p);
+            return;
+        }
+
+        auto cls = sizeClass(bytes);
+        FreeBlock* blk = static_cast<FreeBlock*>(p);
+        blk->next = freeLists[cls];
+        freeLists[cls] = blk;
+    }
+
+    // total bytes of slab storage reserved from the heap
+    std::size_t reservedBytes() const   { return reserved;      }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock*  next;
+    };
+
+    static constexpr std::size_t    MinSlab = 16 * 1024;
+    static constexpr std::size_t    MaxSlab = 1024 * 1024;
+
+    std::vector<FreeBlock*>     freeLists;      // one free list per size class
+    std::vector<void*>          slabs;
+    char*                       cur = nullptr;  // unused space in the newest slab
+    std::size_t                 curLeft = 0;
+    std::size_t                 reserved = 0;
+
+    static std::size_t sizeClass(std::size_t bytes)
+    {
+        if(bytes < sizeof(FreeBlock))   bytes = sizeof(FreeBlock);
+        return (bytes + Granularity - 1) / Granularity;
+    }
+
+    void* carve(std::size_t bytes)
+    {
+        if(curLeft < bytes)
+        {
+            // Whatever is left of the old slab is too small for this class, but might suit a smaller one.
+            if(curLeft >= Granularity)
+                deallocate(cur, curLeft - (curLeft % Granularity));
+
+            // grow slabs geometrically so small arenas stay small
+            std::size_t size = reserved < MinSlab ? MinSlab : reserved;
+            if(size > MaxSlab)      size = MaxSlab;
+
+            cur = static_cast<char*>(::operator new(size));
+            slabs.push_back(cur);
+            curLeft = size;
+            reserved += size;
+        }
+
+        void* out = cur;
+        cur += bytes;
+        curLeft -= bytes;
+        return out;
+    }
+};
+
+//  Standard allocator interface on top of a NodeArena.
+//
+//  Copies (including rebound copies) share the same arena, so several containers can draw
+//  their nodes from one pool.  A default constructed allocator creates its own arena.
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T       value_type;
+
+    PoolAllocator() : arena(std::make_shared<NodeArena>()) {}
+    explicit PoolAllocator(const std::shared_ptr<NodeArena>& a) : arena(a) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& rhs) : arena(rhs.arena) {}
+
+    T* allocate(std::size_t n)
+    {
+        if(n == 1)      return static_cast<T*>(arena->allocate(sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        if(n == 1)      arena->deallocate(p, sizeof(T));
+        else            ::operator delete(p);
+    }
+
+    const std::shared_ptr<NodeArena>&   getArena() const    { return arena;     }
+
+    template <typename U>   bool operator == (const PoolAllocator<U>& rhs) const    { return arena == rhs.arena;    }
+    template <typename U>   bool operator != (const PoolAllocator<U>& rhs) const    { return arena != rhs.arena;    }
+
+private:
+    template <typename U> friend class PoolAllocator;
+    std::shared_ptr<NodeArena>      arena;
+};
+
+#endif
@@ -0,0 +1,152 @@
+
+#ifndef POLICY_H_INCLUDED
+#define POLICY_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "types.h"
+#include "job.h"
+
+//  Scheduling policies for BasicScheduler.
+//
+//  A policy decides the order of the wait queue and how assignProcs works through it.  The
+//  scheduler takes the policy as a template parameter, so the rules below are compile-time
+//  constants and the per-job calls are inlined -- nothing in the inner loops is virtual.
+//
+//  A policy provides:
+//      static const BumpRule   bump;
+//      static const FillRule   fill;
+//      static const char*      name();
+//
+//      // The job's place in the wait queue:  lower ranks run first.  Ties go to the job needing
+//      //   more processors, then to the lower job ID.  Called every time a job enters the queue.
+//      std::uint64_t   rank(const ScheduledJob& job);
+//
+//      // Called when a job starts running, and when the last job with a given description
+//      //   leaves the scheduler (so its ID can be reused for a different description).
+//      void            started(const ScheduledJob& job);
+//      void            forget(strid_t description);
+//
+//      // For checkpoints:  the policy's state as 64-bit words, and back again.  load is given
+//      //   exactly what save wrote, or throws SchedulerException if it can't use it.
+//      void            save(std::vector<std::uint64_t>& out) const;
+//      void            load(const std::uint64_t* words, std::size_t count);
+
+// What assignProcs may do to running jobs before it starts any
+enum class BumpRule
+{
+    None,           // nothing:  running jobs always run to completion
+    Longer          // if the head of the queue doesn't fit, put back every running job that would
+                    //   finish after it, as long as that makes enough room for it
+};
+
+// How assignProcs starts jobs from the queue
+enum class FillRule
+{
+    InOrder,        // strictly in queue order:  stop at the first job that doesn't fit
+    FirstFit,       // in queue order, skipping any job that doesn't fit
+    Backfill        // in queue order until a job doesn't fit.  That job gets a reservation:  the
+                    //   tick running jobs will have freed enough for it.  Later jobs may still
+                    //   start, but only if they finish by then or use processors it won't need.
+};
+
+// Policies without any state can't load any
+inline void expectNoState(std::size_t count)
+{
+    if(count)
+        throw SchedulerException("Checkpoint has state for a policy that doesn't keep any");
+}
+
+// Shortest job first (the default):  the fewest ticks remaining runs first, long running jobs get
+//   bumped for shorter ones, and small jobs fill in around big ones.
+struct ShortestJobFirst
+{
+    static const BumpRule   bump = BumpRule::Longer;
+    static const FillRule   fill = FillRule::FirstFit;
+    static const char*      name()                                  { return "sjf";                 }
+
+    std::uint64_t           rank(const ScheduledJob& job)           { return job.ticksRemaining;    }
+    void                    started(const ScheduledJob&)            {}
+    void                    forget(strid_t)                         {}
+
+    void                    save(std::vector<std::uint64_t>&) const             {}
+    void                    load(const std::uint64_t*, std::size_t count)       { expectNoState(count);     }
+};
+
+// First come, first served:  jobs run strictly in the order they were submitted.  Nothing ever
+//   jumps the queue, so a big job at the head leaves processors idle until it fits.
+struct FirstComeFirstServed
+{
+    static const BumpRule   bump = BumpRule::None;
+    static const FillRule   fill = FillRule::InOrder;
+    static const char*      name()                                  { return "fcfs";                }
+
+    std::uint64_t           rank(const ScheduledJob& job)           { return job.id;                }
+    void                    started(const ScheduledJob&)            {}
+    void                    forget(strid_t)                         {}
+
+    void                    save(std::vector<std::uint64_t>&) const             {}
+    void                    load(const std::uint64_t*, std::size_t count)       { expectNoState(count);     }
+};
+
+// EASY backfilling:  first come, first served, except that when the head of the queue doesn't fit,
+//   later jobs fill in around it as long as they can't delay it.  A big job waits no longer than
+//   it would under plain FCFS, and the holes in front of it get used.
+struct EasyBackfill
+{
+    static const BumpRule   bump = BumpRule::None;
+    static const FillRule   fill = FillRule::Backfill;
+    static const char*      name()                                  { return "easy";                }
+
+    std::uint64_t           rank(const ScheduledJob& job)           { return job.id;                }
+    void                    started(const ScheduledJob&)            {}
+    void                    forget(strid_t)                         {}
+
+    void                    save(std::vector<std::uint64_t>&) const             {}
+    void                    load(const std::uint64_t*, std::size_t count)       { expectNoState(count);     }
+};
+
+// Fair share:  jobs are charged to an account -- every job with the same description shares one
+//   -- and a job is ranked by how many processor-ticks its account had been given when it was
+//   queued.  Accounts that have used the machine least go first.  An account's usage is
+//   forgotten once it has no jobs left in the scheduler.
+class FairShare
+{
+public:
+    static const BumpRule   bump = BumpRule::None;
+    static const FillRule   fill = FillRule::FirstFit;
+    static const char*      name()                                  { return "fairshare";           }
+
+    std::uint64_t rank(const ScheduledJob& job)
+    {
+        return job.description < usage.size() ? usage[job.description] : 0;
+    }
+
+    void started(const ScheduledJob& job)
+    {
+        if(job.description >= usage.size())
+            usage.resize(job.description + 1, 0);
+        usage[job.description] += std::uint64_t(job.numProcs) * job.ticksRemaining;
+    }
+
+    void forget(strid_t description)
+    {
+        if(description < usage.size())
+            usage[description] = 0;
+    }
+
+    void save(std::vector<std::uint64_t>& out) const
+    {
+        out.insert(out.end(), usage.begin(), usage.end());
+    }
+
+    void load(const std::uint64_t* words, std::size_t count)
+    {
+        usage.assign(words, words + count);
+    }
+
+private:
+    std::vector<std::uint64_t>  usage;      // processor-ticks, indexed by description ID
+};
+
+#endif
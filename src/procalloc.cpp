@@ -0,0 +1,316 @@
+
+#include "procalloc.h"
+#include "bitops.h"
+
+// The wide scan is compiled for AVX2 on its own and only used if the CPU running us has it,
+//   so one binary still runs everywhere.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROCALLOC_AVX2_SCAN 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr std::uint64_t AllBits = ~std::uint64_t(0);
+
+    inline std::size_t skipWordsScalar(const std::uint64_t* words, std::size_t w, std::size_t count, std::uint64_t skip)
+    {
+        while(w < count && words[w] == skip)
+            ++w;
+        return w;
+    }
+
+#if defined(PROCALLOC_AVX2_SCAN)
+    __attribute__((target("avx2")))
+    std::size_t skipWordsAvx2(const std::uint64_t* words, std::size_t w, std::size_t count, std::uint64_t skip)
+    {
+        const __m256i pattern = _mm256_set1_epi64x(static_cast<long long>(skip));
+        while(w + 4 <= count)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + w));
+            __m256i eq = _mm256_cmpeq_epi64(v, pattern);
+            if(_mm256_movemask_epi8(eq) != -1)
+                break;
+            w += 4;
+        }
+        return skipWordsScalar(words, w, count, skip);
+    }
+
+    bool detectAvx2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+
+    // Allocators built during static initialization, before this is set, just scan a word at a time.
+    const bool HaveAvx2 = detectAvx2();
+#endif
+
+    // Index of the first word at or after 'w' that isn't equal to 'skip' (which is all 0s or all 1s).
+    //   This is where the bulk of the scanning time goes in a large, mostly full (or mostly
+    //   empty) machine, so use wide compares where we can.
+    inline std::size_t skipWords(const std::uint64_t* words, std::size_t w, std::size_t count, std::uint64_t skip)
+    {
+#if defined(PROCALLOC_AVX2_SCAN)
+        if(HaveAvx2)
+            return skipWordsAvx2(words, w, count, skip);
+#endif
+        return skipWordsScalar(words, w, count, skip);
+    }
+}
+
+ProcAllocator::ProcAllocator(unsigned numprocs, unsigned groupsize)
+    : numProcs(numprocs)
+    , groupSize(groupsize)
+    , freeCount(numprocs)
+{
+    if(groupSize >= numProcs)
+        groupSize = 0;                          // one big group is the same as no grouping
+
+    words.resize((numProcs + 63) / 64, AllBits);
+    if(numProcs % 64)                           // bits past the end are permanently "used"
+        words.back() = (std::uint64_t(1) << (numProcs % 64)) - 1;
+
+    if(groupSize)
+    {
+        groupFree.resize((numProcs + groupSize - 1) / groupSize, groupSize);
+        if(numProcs % groupSize)
+            groupFree.back() = numProcs % groupSize;
+    }
+}
+
+unsigned ProcAllocator::nextFree(unsigned pos) const
+{
+    if(pos >= numProcs)         return numProcs;
+
+    std::size_t w = pos / 64;
+    std::uint64_t bits = words[w] & (AllBits << (pos % 64));
+    if(!bits)
+    {
+        w = skipWords(words.data(), w + 1, words.size(), 0);
+        if(w == words.size())   return numProcs;
+        bits = words[w];
+    }
+    return static_cast<unsigned>(w * 64 + ctz64(bits));
+}
+
+unsigned ProcAllocator::nextUsed(unsigned pos) const
+{
+    if(pos >= numProcs)         return numProcs;
+
+    std::size_t w = pos / 64;
+    std::uint64_t bits = ~words[w] & (AllBits << (pos % 64));
+    if(!bits)
+    {
+        w = skipWords(words.data(), w + 1, words.size(), AllBits);
+        if(w == words.size())   return numProcs;
+        bits = ~words[w];
+    }
+    unsigned out = static_cast<unsigned>(w * 64 + ctz64(bits));
+    return out < numProcs ? out : numProcs;
+}
+
+// Finds the smallest free run that can hold 'count' processors (lowest address on ties).
+//   If 'ingroup' is set, runs are split at group boundaries, so the result never straddles two groups.
+bool ProcAllocator::findRun(unsigned count, bool ingroup, unsigned& start) const
+{
+    unsigned best = 0;
+    unsigned bestlen = 0;
+
+    unsigned pos = nextFree(0);
+    while(pos < numProcs)
+    {
+        unsigned end = nextUsed(pos);
+
+        unsigned a = pos;
+        while(a < end)
+        {
+            unsigned b = end;
+            if(ingroup)
+            {
+                unsigned groupend = (a / groupSize + 1) * groupSize;
+                if(groupend < b)    b = groupend;
+            }
+
+            unsigned len = b - a;
+            if(len >= count && (!bestlen || len < bestlen))
+            {
+                best = a;
+                bestlen = len;
+                if(len == count)
+                {
+                    start = best;
+                    return true;        // can't do better than an exact fit
+                }
+            }
+            a = b;
+        }
+
+        pos = nextFree(end);
+    }
+
+    start = best;
+    return bestlen != 0;
+}
+
+// Group with the fewest free processors that can still hold 'count' of them.  Returns
+//   groupFree.size() if there is none.
+unsigned ProcAllocator::bestGroup(unsigned count) const
+{
+    unsigned best = static_cast<unsigned>(groupFree.size());
+    for(unsigned g = 0; g < groupFree.size(); ++g)
+    {
+        if(groupFree[g] >= count && (best == groupFree.size() || groupFree[g] < groupFree[best]))
+            best = g;
+    }
+    return best;
+}
+
+void ProcAllocator::take(unsigned start, unsigned count, procid_t* out)
+{
+    for(unsigned i = 0; i < count; ++i)
+    {
+        unsigned id = start + i;
+        words[id / 64] &= ~(std::uint64_t(1) << (id % 64));
+        if(groupSize)
+            --groupFree[id / groupSize];
+        out[i] = id;
+    }
+    freeCount -= count;
+}
+
+// Takes up to 'count' free processors in [lo, hi), lowest first, a word at a time.
+//   Returns the number taken.
+unsigned ProcAllocator::takeScattered(unsigned lo, unsigned hi, unsigned count, procid_t* out)
+{
+    unsigned taken = 0;
+    for(std::size_t w = lo / 64; taken < count && w * 64 < hi; ++w)
+    {
+        std::uint64_t bits = words[w];
+        if(w == lo / 64)                    bits &= AllBits << (lo % 64);
+        if((w + 1) * 64 > hi && hi % 64)    bits &= (std::uint64_t(1) << (hi % 64)) - 1;
+
+        std::uint64_t picked = 0;
+        if(popcount64(bits) <= count - taken)
+            picked = bits;                  // we need every free processor in this word
+        else
+        {
+            for(unsigned n = count - taken; n > 0; --n)
+            {
+                picked |= bits & (~bits + 1);       // lowest set bit
+                bits &= bits - 1;
+            }
+        }
+
+        words[w] &= ~picked;
+        while(picked)
+        {
+            unsigned id = static_cast<unsigned>(w * 64 + ctz64(picked));
+            picked &= picked - 1;
+            if(groupSize)
+                --groupFree[id / groupSize];
+            out[taken++] = id;
+        }
+    }
+    freeCount -= taken;
+    return taken;
+}
+
+bool ProcAllocator::allocate(unsigned count, procid_t* out)
+{
+    if(count > freeCount)       return false;
+    if(!count)                  return true;
+
+    unsigned start;
+    if(groupSize && count <= groupSize)
+    {
+        if(findRun(count, true, start))
+        {
+            take(start, count, out);
+            return true;
+        }
+
+        unsigned g = bestGroup(count);
+        if(g < groupFree.size())
+        {
+            unsigned lo = g * groupSize;
+            takeScattered(lo, lo + groupSize < numProcs ? lo + groupSize : numProcs, count, out);
+            return true;
+        }
+    }
+
+    if(findRun(count, false, start))
+    {
+        take(start, count, out);
+        return true;
+    }
+
+    // fragmentation has forced our hand
+    takeScattered(0, numProcs, count, out);
+    return true;
+}
+
+// release and claim flip each processor's bit as they check it, which also catches an ID listed
+//   twice.  If one is bad, the bits already flipped are put back before throwing, and the
+//   counts are only changed once every ID has passed, so the allocator is left as it was.
+void ProcAllocator::release(const procid_t* ids, unsigned count)
+{
+    for(unsigned i = 0; i < count; ++i)
+    {
+        auto id = ids[i];
+        if(id >= numProcs || isFree(id))
+        {
+            flip(ids, i);
+            throw SchedulerException("Internal Error:  releasing a processor that isn't allocated");
+        }
+        words[id / 64] |= std::uint64_t(1) << (id % 64);
+    }
+
+    for(unsigned i = 0; groupSize && i < count; ++i)
+        ++groupFree[ids[i] / groupSize];
+    freeCount += count;
+}
+
+void ProcAllocator::claim(const procid_t* ids, unsigned count)
+{
+    for(unsigned i = 0; i < count; ++i)
+    {
+        auto id = ids[i];
+        if(id >= numProcs || !isFree(id))
+        {
+            flip(ids, i);
+            throw SchedulerException("Processor " + std::to_string(id) + " can't be claimed:  it doesn't exist or is already in use");
+        }
+        words[id / 64] &= ~(std::uint64_t(1) << (id % 64));
+    }
+
+    for(unsigned i = 0; groupSize && i < count; ++i)
+        --groupFree[ids[i] / groupSize];
+    freeCount -= count;
+}
+
+void ProcAllocator::flip(const procid_t* ids, unsigned count)
+{
+    for(unsigned i = 0; i < count; ++i)
+        words[ids[i] / 64] ^= std::uint64_t(1) << (ids[i] % 64);
+}
+
+unsigned ProcAllocator::largestFreeRun() const
+{
+    unsigned best = 0;
+    unsigned pos = nextFree(0);
+    while(pos < numProcs)
+    {
+        unsigned end = nextUsed(pos);
+        if(end - pos > best)
+            best = end - pos;
+        pos = nextFree(end);
+    }
+    return best;
+}
+
+double ProcAllocator::fragmentation() const
+{
+    if(!freeCount)              return 0.0;
+    return 1.0 - static_cast<double>(largestFreeRun()) / freeCount;
+}
@@ -0,0 +1,69 @@
+
+#ifndef PROCALLOC_H_INCLUDED
+#define PROCALLOC_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "types.h"
+
+//  Tracks which processors are free, and picks processors for jobs.
+//
+//  Free processors are kept in a bitset (1 = free), so finding free runs is a matter of
+//  scanning words with ctz rather than walking individual processors.
+//
+//  Placement preference, from best to worst:
+//   1)  a contiguous run of processors inside a single group
+//   2)  any free processors inside a single group
+//   3)  a contiguous run anywhere
+//   4)  whatever is free, lowest IDs first
+//  A "group" is a topology unit (socket, node, etc) of 'groupSize' processors.  If groupSize is
+//  0, there is no grouping and only 3) and 4) apply.  Among contiguous runs, the smallest one that
+//  fits is used, so large holes are kept for large jobs.
+class ProcAllocator
+{
+public:
+                ProcAllocator(unsigned numprocs, unsigned groupsize = 0);
+
+    unsigned    size() const        { return numProcs;      }
+    unsigned    perGroup() const    { return groupSize;     }   // processors per group (0 for no grouping)
+    unsigned    numFree() const     { return freeCount;     }
+    bool        empty() const       { return !freeCount;    }
+
+    // Picks 'count' free processors and writes their IDs to 'out'.  Returns false (and does
+    //   nothing) if there aren't enough free processors.
+    bool        allocate(unsigned count, procid_t* out);
+    void        release(const procid_t* ids, unsigned count);
+
+    // Allocates exactly these processors (restoring a checkpoint).  Throws SchedulerException if
+    //   any of them isn't free, and then changes nothing.  So does release, for processors that
+    //   aren't allocated.
+    void        claim(const procid_t* ids, unsigned count);
+
+    bool        isFree(procid_t id) const   { return (words[id / 64] >> (id % 64)) & 1;    }
+
+    // Length of the longest run of contiguous free processors
+    unsigned    largestFreeRun() const;
+
+    // How scattered the free processors are:  0 means all free processors form one contiguous
+    //   run (or none are free), approaching 1 means every free processor is isolated.
+    double      fragmentation() const;
+
+private:
+    std::vector<std::uint64_t>  words;          // bit set = processor is free
+    std::vector<unsigned>       groupFree;      // number of free processors in each group
+    unsigned                    numProcs;
+    unsigned                    groupSize;
+    unsigned                    freeCount;
+
+    unsigned    nextFree(unsigned pos) const;   // first free processor at or after 'pos' (or numProcs)
+    unsigned    nextUsed(unsigned pos) const;   // first used processor at or after 'pos' (or numProcs)
+
+    bool        findRun(unsigned count, bool ingroup, unsigned& start) const;
+    unsigned    bestGroup(unsigned count) const;
+
+    void        take(unsigned start, unsigned count, procid_t* out);
+    void        flip(const procid_t* ids, unsigned count);      // toggles these processors' bits
+    unsigned    takeScattered(unsigned lo, unsigned hi, unsigned count, procid_t* out);
+};
+
+#endif
@@ -0,0 +1,290 @@
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include "procalloc.h"
+
+using namespace std;
+
+static const int iterations = 20;       // number of random tests to perform
+static const int numsteps = 2000;       // allocations/releases in each random test
+
+static string listIds(const vector<procid_t>& ids)
+{
+    string out;
+    for(auto id : ids)
+        out += (out.empty() ? "" : ",") + to_string(id);
+    return out;
+}
+
+// Builds an allocator where exactly the processors in 'freeIds' are free
+static void fragment(ProcAllocator& pa, const vector<procid_t>& freeIds)
+{
+    vector<procid_t> used;
+    for(procid_t id = 0; id < pa.size(); ++id)
+    {
+        if(find(freeIds.begin(), freeIds.end(), id) == freeIds.end())
+            used.push_back(id);
+    }
+    pa.claim(used.data(), static_cast<unsigned>(used.size()));
+}
+
+static void expectAlloc(ProcAllocator& pa, unsigned count, const vector<procid_t>& expected, const char* what)
+{
+    vector<procid_t> out(count);
+    if(!pa.allocate(count, out.data()))
+        throw std::runtime_error(string(what) + ":  allocation of " + to_string(count) + " failed");
+    if(out != expected)
+        throw std::runtime_error(string(what) + ":  got " + listIds(out) + ", expected " + listIds(expected));
+}
+
+static void expectFragmentation(const ProcAllocator& pa, double expected)
+{
+    if(fabs(pa.fragmentation() - expected) > 1e-9)
+        throw std::runtime_error("fragmentation() is " + to_string(pa.fragmentation()) + ", expected " + to_string(expected));
+}
+
+// Without grouping:  the smallest run that fits wins (lowest on ties), and processors are only
+//   scattered when no run is long enough.
+void testRuns()
+{
+    ProcAllocator pa(96);
+    expectFragmentation(pa, 0.0);
+
+    //  holes:  2-3 (2),  10-14 (5),  20-22 (3),  30-31 (2),  and 70-73 (4) in another word
+    fragment(pa, {2, 3, 10, 11, 12, 13, 14, 20, 21, 22, 30, 31, 70, 71, 72, 73});
+    if(pa.numFree() != 16 || pa.largestFreeRun() != 5)
+        throw std::runtime_error("wrong free count or largest run after fragmenting");
+    expectFragmentation(pa, 1.0 - 5.0 / 16);
+
+    expectAlloc(pa, 3, {20, 21, 22}, "smallest fitting run");
+    expectAlloc(pa, 2, {2, 3}, "lowest run on a tie");
+    expectAlloc(pa, 4, {70, 71, 72, 73}, "exact fit over a longer run");
+    expectAlloc(pa, 4, {10, 11, 12, 13}, "only run that fits");
+    expectFragmentation(pa, 1.0 - 2.0 / 3);
+
+    // 14, 30 and 31 are left:  no run of 3, so take them scattered
+    vector<procid_t> out(4);
+    if(pa.allocate(4, out.data()) || pa.numFree() != 3)
+        throw std::runtime_error("allocated more processors than are free");
+    expectAlloc(pa, 3, {14, 30, 31}, "scattered fallback");
+    if(!pa.empty())
+        throw std::runtime_error("allocator isn't empty after taking every processor");
+    expectFragmentation(pa, 0.0);
+}
+
+// With grouping:  a run inside a group beats free processors inside a group, which beat a run
+//   across groups, which beats whatever is left.
+void testGroups()
+{
+    ProcAllocator pa(32, 8);
+
+    //  group 0:  0-2 (a run of 3)             group 1:  9, 11, 13, 15 (4 isolated)
+    //  group 2:  22-23                        group 3:  24-25, 28
+    fragment(pa, {0, 1, 2, 9, 11, 13, 15, 22, 23, 24, 25, 28});
+    expectFragmentation(pa, 1.0 - 4.0 / 12);       // 22-25 is one run, even though it crosses groups
+
+    expectAlloc(pa, 2, {22, 23}, "smallest run inside a group");
+    expectAlloc(pa, 3, {0, 1, 2}, "run inside a group");
+
+    // group 1 has 4 free, not contiguous, and that still beats the run at 24-25 plus 28
+    pa.release(vector<procid_t>{22, 23}.data(), 2);
+    expectAlloc(pa, 4, {9, 11, 13, 15}, "single group over a run across groups");
+
+    // no group has 4 free any more, so the run across groups 2 and 3 comes next
+    expectAlloc(pa, 4, {22, 23, 24, 25}, "run across groups");
+    expectFragmentation(pa, 0.0);
+
+    // bigger than a group:  a run of 10 across groups 0 and 1 if there is one, scattered if not
+    pa.release(vector<procid_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11}.data(), 11);
+    expectAlloc(pa, 10, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, "run larger than a group");
+    expectAlloc(pa, 2, {11, 28}, "scattered across groups");
+}
+
+// A partial last word and a partial last group must never hand out processors that don't exist
+void testEdges()
+{
+    ProcAllocator pa(70, 16);
+    vector<procid_t> out(70);
+    if(!pa.allocate(70, out.data()) || !pa.empty())
+        throw std::runtime_error("couldn't allocate a whole 70 processor machine");
+    for(procid_t i = 0; i < 70; ++i)
+    {
+        if(find(out.begin(), out.end(), i) == out.end())
+            throw std::runtime_error("processor " + to_string(i) + " wasn't handed out");
+    }
+
+    bool threw = false;
+    try                                     { pa.release(vector<procid_t>{70}.data(), 1);  }
+    catch(SchedulerException&)              { threw = true;                                 }
+    if(!threw)
+        throw std::runtime_error("releasing a processor past the end didn't throw");
+
+    pa.release(out.data(), 70);
+    threw = false;
+    try                                     { pa.release(vector<procid_t>{5}.data(), 1);   }
+    catch(SchedulerException&)              { threw = true;                                 }
+    if(!threw)
+        throw std::runtime_error("releasing a free processor didn't throw");
+
+    pa.claim(vector<procid_t>{5}.data(), 1);
+    threw = false;
+    try                                     { pa.claim(vector<procid_t>{5}.data(), 1);     }
+    catch(SchedulerException&)              { threw = true;                                 }
+    if(!threw)
+        throw std::runtime_error("claiming a processor twice didn't throw");
+}
+
+// A claim or release that throws part way through a list (a bad ID, or one listed twice) must
+//   leave the allocator exactly as it was
+void testFailedUpdates()
+{
+    ProcAllocator pa(128, 16);
+    fragment(pa, {0, 2, 4, 6, 16, 18, 20, 22, 24, 40, 41, 42, 100});
+
+    auto snapshot = [&pa]()
+    {
+        string bits;
+        for(procid_t id = 0; id < pa.size(); ++id)
+            bits += pa.isFree(id) ? '1' : '0';
+        return bits + "/" + to_string(pa.numFree()) + "/" + to_string(pa.largestFreeRun());
+    };
+    string before = snapshot();
+
+    vector<vector<procid_t>> badClaims = { {0, 2, 50}, {40, 41, 40}, {4, 6, 128}, {100, 0, 0} };
+    for(auto& ids : badClaims)
+    {
+        bool threw = false;
+        try                                 { pa.claim(ids.data(), static_cast<unsigned>(ids.size()));     }
+        catch(SchedulerException&)          { threw = true;                                                 }
+        if(!threw || snapshot() != before)
+            throw std::runtime_error("claim of " + listIds(ids) + " didn't throw, or changed the allocator");
+    }
+
+    vector<vector<procid_t>> badReleases = { {5, 7, 0}, {60, 61, 60}, {9, 200} };
+    for(auto& ids : badReleases)
+    {
+        bool threw = false;
+        try                                 { pa.release(ids.data(), static_cast<unsigned>(ids.size()));   }
+        catch(SchedulerException&)          { threw = true;                                                 }
+        if(!threw || snapshot() != before)
+            throw std::runtime_error("release of " + listIds(ids) + " didn't throw, or changed the allocator");
+    }
+
+    // and the group counts are untouched too:  group 0 still has the fewest free that can hold 4
+    //   (group 1 has 5), so that's where a job of 4 goes
+    expectAlloc(pa, 4, {0, 2, 4, 6}, "placement after failed updates");
+}
+
+// Random allocations and releases on a large machine, checked against a plain vector<bool>.
+//   Long all-free and all-used stretches make the word skipping do real work.
+void testRandom(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    unsigned numprocs = 1000 + rng() % 4000;
+    unsigned groupsize = (rng() % 2) ? 32u << (rng() % 4) : 0;
+    ProcAllocator pa(numprocs, groupsize);
+
+    vector<bool> used(numprocs, false);
+    vector<vector<procid_t>> jobs;
+
+    for(int step = 0; step < numsteps; ++step)
+    {
+        if(jobs.empty() || rng() % 3)
+        {
+            unsigned count = 1 + ((rng() % 4) ? rng() % 16 : rng() % 600);
+            vector<procid_t> ids(count);
+            if(!pa.allocate(count, ids.data()))
+            {
+                if(count <= pa.numFree())
+                    throw std::runtime_error("allocation failed with enough processors free");
+                continue;
+            }
+            for(auto id : ids)
+            {
+                if(id >= numprocs || used[id])
+                    throw std::runtime_error("processor " + to_string(id) + " handed out twice (or doesn't exist)");
+                used[id] = true;
+            }
+            jobs.push_back(std::move(ids));
+        }
+        else
+        {
+            std::size_t j = rng() % jobs.size();
+            pa.release(jobs[j].data(), static_cast<unsigned>(jobs[j].size()));
+            for(auto id : jobs[j])
+                used[id] = false;
+            jobs[j].swap(jobs.back());
+            jobs.pop_back();
+        }
+
+        unsigned free = 0, run = 0, longest = 0;
+        for(procid_t id = 0; id < numprocs; ++id)
+        {
+            if(pa.isFree(id) == used[id])
+                throw std::runtime_error("processor " + to_string(id) + " has the wrong state");
+            run = used[id] ? 0 : run + 1;
+            free += !used[id];
+            longest = max(longest, run);
+        }
+        if(pa.numFree() != free)
+            throw std::runtime_error("numFree() is " + to_string(pa.numFree()) + ", expected " + to_string(free));
+        if(pa.largestFreeRun() != longest)
+            throw std::runtime_error("largestFreeRun() is " + to_string(pa.largestFreeRun()) + ", expected " + to_string(longest));
+    }
+}
+
+int main()
+{
+    struct { const char* name; void (*test)(); } fixed[] = {
+        {"runs",        testRuns            },
+        {"groups",      testGroups          },
+        {"edges",       testEdges           },
+        {"failures",    testFailedUpdates   },
+    };
+
+    for(auto& f : fixed)
+    {
+        cout << "Beginning allocator test (" << setw(10) << setfill(' ') << f.name << "):  ";
+        try
+        {
+            f.test();
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    srand((unsigned)time(nullptr));
+
+    std::vector<unsigned> seeds;
+    seeds.reserve(iterations);
+    for(int i = 0; i < iterations; ++i)
+        seeds.push_back( rand() );
+
+    for(auto& seed : seeds)
+    {
+        cout << "Beginning allocator test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+        try
+        {
+            testRandom(seed);
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+
+#include "procset.h"
+
+ProcSet::ProcSet(ProcSet&& rhs)
+    : count( rhs.count )
+    , form( rhs.form )
+    , data( rhs.data )
+{
+    rhs.count = 0;
+    rhs.form = Form::Run;
+}
+
+ProcSet& ProcSet::operator = (ProcSet&& rhs)
+{
+    if(this != &rhs)
+    {
+        clear();
+        count = rhs.count;
+        form = rhs.form;
+        data = rhs.data;
+
+        rhs.count = 0;
+        rhs.form = Form::Run;
+    }
+    return *this;
+}
+
+void ProcSet::assign(const procid_t* ids, unsigned n)
+{
+    if(form == Form::Heap && data.list[0] >= n)
+    {
+        // keep the list we have, whatever shape the new set is
+        for(unsigned i = 0; i < n; ++i)
+            data.list[i + 1] = static_cast<std::uint32_t>(ids[i]);
+        count = n;
+        return;
+    }
+
+    clear();
+    if(!n)
+        return;
+
+    bool run = true;
+    for(unsigned i = 1; run && i < n; ++i)
+        run = (ids[i] == ids[0] + i);
+
+    if(run)
+    {
+        form = Form::Run;
+        data.ids[0] = static_cast<std::uint32_t>(ids[0]);
+    }
+    else if(n <= InlineCount)
+    {
+        form = Form::Inline;
+        for(unsigned i = 0; i < n; ++i)
+            data.ids[i] = static_cast<std::uint32_t>(ids[i]);
+    }
+    else
+    {
+        form = Form::Heap;
+        data.list = new std::uint32_t[n + 1];
+        data.list[0] = n;
+        for(unsigned i = 0; i < n; ++i)
+            data.list[i + 1] = static_cast<std::uint32_t>(ids[i]);
+    }
+    count = n;
+}
+
+void ProcSet::clear()
+{
+    if(form == Form::Heap)
+        delete[] data.list;
+    form = Form::Run;
+    count = 0;
+}
+
+void ProcSet::copyTo(procid_t* out) const
+{
+    for(unsigned i = 0; i < count; ++i)
+        out[i] = (*this)[i];
+}
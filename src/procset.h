@@ -0,0 +1,67 @@
+
+#ifndef PROCSET_H_INCLUDED
+#define PROCSET_H_INCLUDED
+
+#include <cstdint>
+#include "types.h"
+
+//  ProcSet is the set of processors a job holds, in 16 bytes.
+//
+//  ProcAllocator hands out a contiguous run whenever it can, so a run is stored as just its
+//  first ID.  A scattered set of up to InlineCount IDs is stored in place, and only bigger
+//  scattered sets go to the heap.  Once a set has a heap list it keeps using it for anything
+//  that fits, and 'vacate' keeps it too, so a bumped job is readmitted without allocating.
+class ProcSet
+{
+public:
+    static const unsigned   InlineCount = 2;
+
+    ProcSet() = default;
+    ~ProcSet()                      { clear();      }
+
+    // no copying
+    ProcSet(const ProcSet&) = delete;
+    ProcSet& operator = (const ProcSet&) = delete;
+
+    // but moving is OK
+    ProcSet(ProcSet&& rhs);
+    ProcSet& operator = (ProcSet&& rhs);
+
+    // Replaces the contents with 'count' processor IDs (in the order given)
+    void        assign(const procid_t* ids, unsigned count);
+    void        clear();
+    void        vacate()            { count = 0;        }   // like clear, but a heap list is kept for the next assign
+
+    unsigned    size() const        { return count;     }
+    bool        empty() const       { return !count;    }
+
+    procid_t    operator [] (unsigned i) const
+    {
+        switch(form)
+        {
+        case Form::Run:     return data.ids[0] + i;
+        case Form::Inline:  return data.ids[i];
+        default:            return data.list[i + 1];
+        }
+    }
+
+    void        copyTo(procid_t* out) const;
+
+private:
+    enum class Form : std::uint8_t
+    {
+        Run,            // data.ids[0] is the first of 'count' consecutive IDs
+        Inline,         // data.ids holds the IDs
+        Heap            // data.list[0] is how many IDs the list can hold, and the IDs follow it
+    };
+
+    std::uint32_t   count = 0;
+    Form            form = Form::Run;
+    union
+    {
+        std::uint32_t   ids[InlineCount];
+        std::uint32_t*  list;
+    }               data;
+};
+
+#endif
@@ -0,0 +1,410 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "anyscheduler.h"
+#include "eventlog.h"
+#include "executor.h"
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    struct ReplayResult
+    {
+        std::uint64_t   submitted = 0;
+        std::uint64_t   rejected = 0;
+        tick_t          makespan = 0;
+    };
+
+    // Walks a LoadedTrace the way TraceReader walks a file.  Any number of these can walk the same
+    //   trace at once.
+    class TraceCursor
+    {
+    public:
+        explicit    TraceCursor(const LoadedTrace& trace) : pos(trace.begin()), end(trace.end())  {}
+
+        bool        next(TraceRecord& rec)
+        {
+            if(pos == end)
+                return false;
+            rec = *pos++;
+            return true;
+        }
+
+    private:
+        const TraceRecord*  pos;
+        const TraceRecord*  end;
+    };
+
+    // Feeds every job in the trace (a TraceReader or a TraceCursor) to the scheduler at its
+    //   arrival tick, then runs until everything has completed.  Jobs arriving on the same tick
+    //   are added as one batch.
+    template <typename Trace>
+    ReplayResult replay(AnyScheduler& sch, Trace& trace)
+    {
+        ReplayResult out;
+        TraceRecord rec;
+
+        std::vector<JobInfo> batch;     // entries are reused, so their descriptions keep their storage
+        std::size_t batchSize = 0;
+        auto flush = [&]()
+        {
+            auto added = sch.addJobs(batch.data(), batchSize);
+            out.submitted += added;
+            out.rejected += batchSize - added;
+            batchSize = 0;
+        };
+
+        while(trace.next(rec))
+        {
+            if(rec.arrival < sch.now())
+                throw SchedulerException("Trace is not in order of arrival tick (job " + std::to_string(out.submitted + out.rejected + batchSize + 1) + ")");
+            if(rec.arrival > sch.now())
+            {
+                flush();
+                sch.advance(rec.arrival - sch.now());
+            }
+
+            if(batchSize == batch.size())
+                batch.emplace_back();
+            JobInfo& info = batch[batchSize++];
+            info.description.assign(rec.description, rec.descLength);
+            info.numProcs = rec.numProcs;
+            info.numTicks = rec.numTicks;
+        }
+        flush();
+
+        sch.drain();
+        out.makespan = sch.now();
+        return out;
+    }
+
+    // Prints every event in the log, as a table or as CSV, then how many of each kind there were
+    void decodeEvents(const std::string& path, bool csv)
+    {
+        EventLogReader log(path);
+        std::uint64_t counts[static_cast<std::uint32_t>(EventKind::Update) + 1] = {};
+
+        char buf[4096];
+        DumpWriter out(buf, sizeof(buf), std::cout);
+        if(csv)
+            out.write("tick,job,event,num_procs,ticks,first_proc\n");
+        else
+            out.write("Tick         | Job Id     | Event    | Procs | Ticks      | First Proc\n");
+
+        EventRecord e;
+        while(log.next(e))
+        {
+            const char* kind = eventKindName(static_cast<EventKind>(e.kind));
+            ++counts[e.kind <= static_cast<std::uint32_t>(EventKind::Update) ? e.kind : 0];
+            if(csv)
+            {
+                out.writeUInt(e.tick);                  out.put(',');
+                if(e.job != NoJob)  out.writeUInt(e.job);
+                out.put(',');
+                out.write(kind);                        out.put(',');
+                out.writeUInt(e.numProcs);              out.put(',');
+                out.writeUInt(e.ticks);                 out.put(',');
+                if(e.firstProc != NoEventProc)  out.writeUInt(e.firstProc);
+                out.put('\n');
+            }
+            else
+            {
+                out.pad(13, out.writeUInt(e.tick));                             out.write("| ");
+                out.pad(11, e.job != NoJob ? out.writeUInt(e.job) : 0);         out.write("| ");
+                out.pad(9, out.writeText(kind, std::strlen(kind)));             out.write("| ");
+                out.pad(6, out.writeUInt(e.numProcs));                          out.write("| ");
+                out.pad(11, out.writeUInt(e.ticks));                            out.write("| ");
+                if(e.firstProc != NoEventProc)  out.writeUInt(e.firstProc);
+                out.put('\n');
+            }
+        }
+        out.flush();
+
+        if(!csv)
+        {
+            std::cout << "\nEvents:";
+            for(std::uint32_t k = 1; k <= static_cast<std::uint32_t>(EventKind::Update); ++k)
+                std::cout << "  " << eventKindName(static_cast<EventKind>(k)) << " " << counts[k];
+            if(counts[0])
+                std::cout << "  unknown " << counts[0];
+            std::cout << "\n";
+        }
+    }
+
+    // Splits "a,b,c" into its parts, skipping empty ones
+    std::vector<std::string> splitList(const std::string& list)
+    {
+        std::vector<std::string> out;
+        std::size_t start = 0;
+        while(start <= list.size())
+        {
+            std::size_t comma = std::min(list.find(',', start), list.size());
+            if(comma > start)
+                out.push_back(list.substr(start, comma - start));
+            start = comma + 1;
+        }
+        return out;
+    }
+
+    struct SweepRun
+    {
+        unsigned            numProcs;
+        std::string         policy;
+        ReplayResult        result;
+        SchedulerMetrics    metrics;
+    };
+
+    // Replays one trace against every combination of processor count and policy, each on its own
+    //   scheduler, as many at once as there are threads.  The trace is loaded once and only read
+    //   after that, so the runs share nothing else and don't wait on each other.
+    void sweep(const std::string& path, const std::string& procList, const std::string& policyList,
+               unsigned groupsize, unsigned threads)
+    {
+        std::vector<std::string> policies = (policyList == "all") ? schedulerPolicies() : splitList(policyList);
+        std::vector<SweepRun> runs;
+        for(auto& procs : splitList(procList))
+        {
+            unsigned numprocs = std::stoul(procs);
+            if(numprocs < 1)
+                throw SchedulerException("Invalid number of processors specified.");
+            for(auto& policy : policies)
+            {
+                makeScheduler(policy, 1);       // throws for an unknown policy, before anything runs
+                SweepRun run;
+                run.numProcs = numprocs;
+                run.policy = policy;
+                runs.push_back(run);
+            }
+        }
+        if(runs.empty())
+            throw SchedulerException("Nothing to sweep.");
+
+        auto loadStart = std::chrono::steady_clock::now();
+        LoadedTrace trace(path);
+        std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+
+        if(threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        WorkStealingPool pool( static_cast<unsigned>(std::min<std::size_t>(threads, runs.size())) );
+
+        auto start = std::chrono::steady_clock::now();
+        pool.run(runs.size(), [&](std::size_t i)
+        {
+            SweepRun& run = runs[i];
+            auto sch = makeScheduler(run.policy, run.numProcs, groupsize);
+            TraceCursor cursor(trace);
+            run.result = replay(*sch, cursor);
+            run.metrics = sch->getMetrics();
+        });
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "Trace:            " << path << " (" << trace.size() << " jobs, "
+                  << (trace.format() == TraceFormat::Binary ? "binary" : "text") << ", loaded in " << loadTime.count() << " sec)\n";
+        std::cout << "Configurations:   " << runs.size() << " on " << pool.size() << " threads\n";
+        std::cout << "Wall time (sec):  " << elapsed.count() << "\n";
+        std::cout << "\n";
+
+        std::cout << std::fixed;
+        std::cout << " Procs | Policy    |     Makespan |  Util |  Wait mean |   Wait p50 |   Wait p95 |   Wait p99 |  Slow mean |   Slow p99 |    Bumps | Rejected\n";
+        std::cout << "-------------------------------------------------------------------------------------------------------------------------------------------\n";
+        for(auto& run : runs)
+        {
+            const SchedulerMetrics& m = run.metrics;
+            std::cout << std::setw(6) << run.numProcs << " | " << std::left << std::setw(9) << run.policy << std::right << " | "
+                      << std::setw(12) << run.result.makespan << " | "
+                      << std::setprecision(3) << std::setw(5) << m.utilization.mean << " | "
+                      << std::setprecision(1) << std::setw(10) << m.wait.mean << " | " << std::setw(10) << m.wait.p50 << " | "
+                      << std::setw(10) << m.wait.p95 << " | " << std::setw(10) << m.wait.p99 << " | "
+                      << std::setprecision(2) << std::setw(10) << m.slowdown.mean << " | " << std::setw(10) << m.slowdown.p99 << " | "
+                      << std::setw(8) << m.bumps << " | " << std::setw(8) << run.result.rejected << "\n";
+        }
+    }
+
+    // Runs every job in the trace for real, its description as its command (see executor.h).
+    //   Ticks are 'tickMs' milliseconds of wall time, and jobs are added as their arrival ticks come.
+    void execute(unsigned numprocs, const std::string& path, unsigned tickMs, const std::string& policy)
+    {
+        auto sch = makeScheduler(policy, numprocs);
+        LocalExecutor exec(*sch, std::chrono::milliseconds(tickMs));
+        TraceReader trace(path);
+
+        ReplayResult result;
+        TraceRecord rec;
+        tick_t last = 0;
+        auto start = std::chrono::steady_clock::now();
+        while(trace.next(rec))
+        {
+            if(rec.arrival < last)
+                throw SchedulerException("Trace is not in order of arrival tick (job " + std::to_string(result.submitted + result.rejected + 1) + ")");
+            last = rec.arrival;
+            exec.runUntil(rec.arrival);
+
+            if(sch->addJob(JobInfo{ std::string(rec.description, rec.descLength), rec.numProcs, rec.numTicks }))
+                ++result.submitted;
+            else
+                ++result.rejected;
+        }
+        exec.runUntilIdle();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        ExecutorStats counts = exec.stats();
+        std::cout << "Policy:           " << sch->policyName() << "\n";
+        std::cout << "Jobs submitted:   " << result.submitted << "\n";
+        std::cout << "Jobs rejected:    " << result.rejected << "\n";
+        std::cout << "Processes:        " << counts.launched << " started, " << counts.exited << " exited, "
+                  << counts.killed << " killed at their time limit, " << counts.failed << " failed to start\n";
+        std::cout << "Stops/resumes:    " << counts.stopped << " / " << counts.resumed << "\n";
+        std::cout << "Makespan (ticks): " << sch->now() << "\n";
+        std::cout << "Wall time (sec):  " << elapsed.count() << "\n";
+
+        char buf[4096];
+        DumpWriter out(buf, sizeof(buf), std::cout);
+        out.put('\n');
+        sch->dumpMetrics(out);
+    }
+
+    void printUsage()
+    {
+        std::cout << "Usage:\n";
+        std::cout << "  replay <num_procs> <trace file> [group_size] [policy] [event log]\n";
+        std::cout << "      Runs every job in the trace (text or binary) and reports the results.\n";
+        std::cout << "      If an event log is named, every scheduling decision is written to it.\n";
+        std::cout << "      Policies:";
+        for(auto& name : schedulerPolicies())
+            std::cout << " " << name;
+        std::cout << " (default " << schedulerPolicies().front() << ")\n";
+        std::cout << "  replay sweep <trace file> <num_procs,...> [policy,...|all] [group_size] [threads]\n";
+        std::cout << "      Runs the trace once for every combination of processor count and policy, in\n";
+        std::cout << "      parallel (threads defaults to one per core), and compares the results.\n";
+        std::cout << "  replay exec <num_procs> <trace file> <tick_ms> [policy]\n";
+        std::cout << "      Runs the trace for real (Linux):  each job's description is a shell command, run\n";
+        std::cout << "      pinned to the CPUs of its processors.  Its ticks are its time limit.\n";
+        std::cout << "  replay convert <text trace> <binary trace>\n";
+        std::cout << "      Converts a text trace to the binary format.\n";
+        std::cout << "  replay events <event log> [csv]\n";
+        std::cout << "      Prints the events in an event log.\n";
+        std::cout << "\n";
+        std::cout << "Text traces have one job per line:  <arrival tick> <num procs> <num ticks> <description>\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        printUsage();
+        return 1;
+    }
+
+    try
+    {
+        std::string mode = argv[1];
+        if(mode == "convert")
+        {
+            if(argc < 4)
+            {
+                printUsage();
+                return 1;
+            }
+            auto count = convertTrace(argv[2], argv[3]);
+            std::cout << "Converted " << count << " jobs.\n";
+            return 0;
+        }
+        if(mode == "sweep")
+        {
+            if(argc < 4)
+            {
+                printUsage();
+                return 1;
+            }
+            sweep(argv[2], argv[3], (argc >= 5) ? argv[4] : "all", (argc >= 6) ? std::stoul(argv[5]) : 0,
+                  (argc >= 7) ? std::stoul(argv[6]) : 0);
+            return 0;
+        }
+        if(mode == "exec")
+        {
+            if(argc < 5)
+            {
+                printUsage();
+                return 1;
+            }
+            unsigned numprocs = std::stoul(argv[2]);
+            if(numprocs < 1)
+            {
+                std::cout << "Invalid number of processors specified.\n";
+                return 1;
+            }
+            execute(numprocs, argv[3], std::stoul(argv[4]), (argc >= 6) ? argv[5] : schedulerPolicies().front());
+            return 0;
+        }
+        if(mode == "events")
+        {
+            decodeEvents(argv[2], argc >= 4 && std::string(argv[3]) == "csv");
+            return 0;
+        }
+
+        unsigned numprocs = std::stoul(argv[1]);
+        unsigned groupsize = (argc >= 4) ? std::stoul(argv[3]) : 0;
+        std::string policy = (argc >= 5) ? argv[4] : schedulerPolicies().front();
+        if(numprocs < 1)
+        {
+            std::cout << "Invalid number of processors specified.\n";
+            return 1;
+        }
+
+        auto sch = makeScheduler(policy, numprocs, groupsize);
+        TraceReader trace(argv[2]);
+
+        // a replay isn't in a hurry, so keep every event, and compress them
+        if(argc >= 6)
+        {
+            EventLogOptions opts;
+            opts.overflow = EventOverflow::Block;
+            opts.compression = EventCompression::Delta;
+            sch->openEventLog(argv[5], opts);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto result = replay(*sch, trace);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        EventLogStats events = sch->closeEventLog();
+
+        std::cout << "Policy:           " << sch->policyName() << "\n";
+        std::cout << "Trace format:     " << (trace.format() == TraceFormat::Binary ? "binary" : "text") << "\n";
+        std::cout << "Jobs submitted:   " << result.submitted << "\n";
+        std::cout << "Jobs rejected:    " << result.rejected << "\n";
+        std::cout << "Makespan (ticks): " << result.makespan << "\n";
+        std::cout << "Wall time (sec):  " << elapsed.count() << "\n";
+        if(elapsed.count() > 0)
+            std::cout << "Jobs/sec:         " << static_cast<std::uint64_t>(result.submitted / elapsed.count()) << "\n";
+        if(argc >= 6)
+        {
+            std::cout << "Events logged:    " << events.written << " (" << events.bytes << " bytes, "
+                      << events.dropped << " dropped, " << events.stalls << " stalls)\n";
+        }
+
+        char buf[4096];
+        DumpWriter out(buf, sizeof(buf), std::cout);
+        out.put('\n');
+        sch->dumpMetrics(out);
+        if(Scheduler::statsEnabled)
+        {
+            out.put('\n');
+            sch->dumpStats(out);
+        }
+    }
+    catch(std::exception& e)
+    {
+        std::cout << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
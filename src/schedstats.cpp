@@ -0,0 +1,85 @@
+
+#include "schedstats.h"
+#include "bitops.h"
+
+void LatencyHistogram::reset()
+{
+    for(auto& i : buckets)
+        i = 0;
+    count = total = max = 0;
+}
+
+void LatencyHistogram::record(std::uint64_t v)
+{
+    unsigned b = v ? 63 - clz64(v) : 0;
+    if(b >= NumBuckets)
+        b = NumBuckets - 1;
+
+    ++buckets[b];
+    ++count;
+    total += v;
+    if(v > max)
+        max = v;
+}
+
+std::uint64_t LatencyHistogram::percentile(double pct) const
+{
+    if(!count)
+        return 0;
+
+    std::uint64_t target = static_cast<std::uint64_t>(count * pct / 100.0);
+    if(target >= count)
+        target = count - 1;
+
+    std::uint64_t seen = 0;
+    for(unsigned i = 0; i < NumBuckets; ++i)
+    {
+        seen += buckets[i];
+        if(seen > target)
+        {
+            std::uint64_t upper = (std::uint64_t(2) << i) - 1;
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+void SchedulerStats::reset()
+{
+    jobsSubmitted = jobsRejected = 0;
+    jobsAdmitted = jobsBumped = jobsCompleted = 0;
+    assignCalls = waitNodesVisited = 0;
+    for(auto& i : phases)
+        i.reset();
+}
+
+void SchedulerStats::dump(DumpWriter& out) const
+{
+    static const char* const phaseNames[] = { "bump", "fill", "run" };
+
+    out.write("Jobs submitted:       ");    out.writeUInt(jobsSubmitted);       out.put('\n');
+    out.write("Jobs rejected:        ");    out.writeUInt(jobsRejected);        out.put('\n');
+    out.write("Jobs admitted:        ");    out.writeUInt(jobsAdmitted);        out.put('\n');
+    out.write("Jobs bumped:          ");    out.writeUInt(jobsBumped);          out.put('\n');
+    out.write("Jobs completed:       ");    out.writeUInt(jobsCompleted);       out.put('\n');
+    out.write("assignProcs calls:    ");    out.writeUInt(assignCalls);         out.put('\n');
+    out.write("Wait nodes visited:   ");    out.writeUInt(waitNodesVisited);    out.put('\n');
+
+#if defined(SCHEDULER_STATS_RDTSC)
+    out.write("\nPhase  | Count        | Mean       | p50        | p99        | Max          (cycles)\n");
+#else
+    out.write("\nPhase  | Count        | Mean       | p50        | p99        | Max          (ns)\n");
+#endif
+    out.write("--------------------------------------------------------------------------\n");
+    for(int i = 0; i < static_cast<int>(SchedPhase::Count); ++i)
+    {
+        auto& h = phases[i];
+        out.pad(7, out.writeText(phaseNames[i], std::strlen(phaseNames[i])));   out.write("| ");
+        out.pad(13, out.writeUInt(h.count));                                     out.write("| ");
+        out.pad(11, out.writeUInt(h.count ? h.total / h.count : 0));             out.write("| ");
+        out.pad(11, out.writeUInt(h.percentile(50)));                            out.write("| ");
+        out.pad(11, out.writeUInt(h.percentile(99)));                            out.write("| ");
+        out.writeUInt(h.max);
+        out.put('\n');
+    }
+}
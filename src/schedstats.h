@@ -0,0 +1,144 @@
+
+#ifndef SCHEDSTATS_H_INCLUDED
+#define SCHEDSTATS_H_INCLUDED
+
+#include <cstdint>
+#include <chrono>
+#include "dumpwriter.h"
+
+//  Scheduler instrumentation.
+//
+//  Build with -DSCHEDULER_STATS=1 (or 'make STATS=1') to turn it on.  When it's off, the
+//  collector is an empty class whose functions do nothing, so the calls compile away entirely.
+//
+//  Latencies are measured with steady_clock in nanoseconds, or with the CPU's timestamp counter
+//  (in cycles) if SCHEDULER_STATS_RDTSC is also defined.
+#ifndef SCHEDULER_STATS
+#define SCHEDULER_STATS 0
+#endif
+
+#if SCHEDULER_STATS && defined(SCHEDULER_STATS_RDTSC)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+// The parts of the scheduler that get timed
+enum class SchedPhase
+{
+    Bump,           // assignProcs phase 1:  looking for jobs to boot
+    Fill,           // assignProcs phase 2:  walking the wait queue
+    Run,            // runActiveJobs:  completing jobs
+    Count
+};
+
+// Histogram with power of 2 buckets:  bucket i holds samples in [2^i, 2^(i+1))  (bucket 0 also holds 0)
+struct LatencyHistogram
+{
+    static const unsigned NumBuckets = 48;
+
+    std::uint64_t   buckets[NumBuckets];
+    std::uint64_t   count;
+    std::uint64_t   total;
+    std::uint64_t   max;
+
+    LatencyHistogram()                  { reset();      }
+
+    void            reset();
+    void            record(std::uint64_t v);
+
+    // Upper bound of the bucket containing the given percentile (0-100)
+    std::uint64_t   percentile(double pct) const;
+};
+
+struct SchedulerStats
+{
+    std::uint64_t       jobsSubmitted;
+    std::uint64_t       jobsRejected;
+    std::uint64_t       jobsAdmitted;       // made active (including re-admissions after a bump)
+    std::uint64_t       jobsBumped;
+    std::uint64_t       jobsCompleted;
+    std::uint64_t       assignCalls;
+    std::uint64_t       waitNodesVisited;   // findNext searches made by assignProcs phase 2
+
+    LatencyHistogram    phases[static_cast<int>(SchedPhase::Count)];
+
+    SchedulerStats()                    { reset();      }
+
+    void            reset();
+    void            dump(DumpWriter& out) const;
+};
+
+template <bool Enabled>
+class SchedStatsCollector;
+
+// Disabled:  everything is a no-op
+template <>
+class SchedStatsCollector<false>
+{
+public:
+    class Timer
+    {
+    public:
+        Timer(SchedStatsCollector&, SchedPhase) {}
+    };
+
+    void        submitted(bool)                 {}
+    void        admitted()                      {}
+    void        bumped()                        {}
+    void        completed()                     {}
+    void        assignCall()                    {}
+    void        visited(std::uint64_t)          {}
+
+    SchedulerStats  get() const                 { return SchedulerStats();      }
+    void            reset()                     {}
+};
+
+template <>
+class SchedStatsCollector<true>
+{
+public:
+    // Records the time from construction to destruction into a phase's histogram
+    class Timer
+    {
+    public:
+        Timer(SchedStatsCollector& c, SchedPhase p) : hist(c.stats.phases[static_cast<int>(p)]), start(now())   {}
+        ~Timer()                                { hist.record(now() - start);   }
+
+        Timer(const Timer&) = delete;
+        Timer& operator = (const Timer&) = delete;
+
+    private:
+        LatencyHistogram&   hist;
+        std::uint64_t       start;
+    };
+
+    void        submitted(bool ok)              { ++(ok ? stats.jobsSubmitted : stats.jobsRejected);    }
+    void        admitted()                      { ++stats.jobsAdmitted;         }
+    void        bumped()                        { ++stats.jobsBumped;           }
+    void        completed()                     { ++stats.jobsCompleted;        }
+    void        assignCall()                    { ++stats.assignCalls;          }
+    void        visited(std::uint64_t n)        { stats.waitNodesVisited += n;  }
+
+    SchedulerStats  get() const                 { return stats;     }
+    void            reset()                     { stats.reset();    }
+
+    static std::uint64_t now()
+    {
+#if defined(SCHEDULER_STATS_RDTSC)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count() );
+#endif
+    }
+
+private:
+    SchedulerStats      stats;
+};
+
+typedef SchedStatsCollector<SCHEDULER_STATS != 0>   SchedStats;
+
+#endif
@@ -1,21 +1,33 @@
 
-#include <iomanip>
 #include "scheduler.h"
+#include "checkpoint.h"
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <iterator>
 
-Scheduler::Scheduler(unsigned numprocs)
+template <typename P>
+BasicScheduler<P>::BasicScheduler(unsigned numprocs, unsigned groupsize)
+    : arena( std::make_shared<NodeArena>() )
+    , waitQueue( jobpool_t(arena) )
+    , activeJobs( jobpool_t(arena) )
+    , availProcs( numprocs, groupsize )
+    , ingress( IngressCapacity )
+    , lastJobId( 0 )
+    , completions( PoolAllocator<Completion>(arena) )
 {
     processors.resize(numprocs, NoProc);
-    availProcs.resize(numprocs);
-    for(unsigned i = 0; i < numprocs; ++i)
-        availProcs[i] = i;
+    procScratch.resize(numprocs);
 
-    lastJobId = 0;
-    usedJobIds.insert(NoJob);       // 'NoJob' is a reserved Job ID, it can never be assigned
     needProcAssign = false;
+
+    clock = 0;
+    activationSeq = 0;
 }
 
 
-bool Scheduler::addJob(const JobInfo& jobinfo)
+template <typename P>
+bool BasicScheduler<P>::isValidJob(const JobInfo& jobinfo) const
 {
     if(jobinfo.numTicks <= 0)       // no ticks in this job -- it's immediately complete
         return false;
@@ -24,103 +36,542 @@ bool Scheduler::addJob(const JobInfo& jobinfo)
     if(jobinfo.numProcs > processors.size())    // requires more processors than we have
         return false;
 
+    return true;
+}
 
-    ScheduledJob job;
-    job.info = jobinfo;
-    job.ticksRemaining = jobinfo.numTicks;
+template <typename P>
+bool BasicScheduler<P>::addJob(const JobInfo& jobinfo)
+{
+    bool valid = isValidJob(jobinfo);
 
-    job.procsUsed.reset(new procid_t[jobinfo.numProcs]);
-    for(unsigned i = 0; i < jobinfo.numProcs; ++i)
-        job.procsUsed[i] = NoProc;
-    
-    job.id = getUniqueJobId();
-    usedJobIds.insert(job.id);
+    stats.submitted(valid);
+    if(!valid)
+    {
+        logRejected(jobinfo);
+        return false;
+    }
 
+    ScheduledJob job = makeJob(getUniqueJobId(), jobinfo);
+    logEvent(EventKind::Submit, job, job.numTicks);
     putJobInWaitQueue( std::move(job) );
+    needProcAssign = true;
+    return true;
+}
+
+template <typename P>
+std::size_t BasicScheduler<P>::addJobs(const JobInfo* jobs, std::size_t count)
+{
+    // the wait queue would insert a small batch one job at a time anyway, so skip staging it
+    if(count < static_cast<std::size_t>(queue_t::BulkMinBatch))
+    {
+        std::size_t added = 0;
+        for(std::size_t i = 0; i < count; ++i)
+            added += addJob(jobs[i]) ? 1 : 0;
+        return added;
+    }
 
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        bool valid = isValidJob(jobs[i]);
+        stats.submitted(valid);
+        if(!valid)
+        {
+            logRejected(jobs[i]);
+            continue;
+        }
+        batch.push_back( makeJob(getUniqueJobId(), jobs[i]) );
+        logEvent(EventKind::Submit, batch.back(), jobs[i].numTicks);
+    }
+
+    auto added = batch.size();
+    putBatchInWaitQueue();
+    return added;
+}
+
+// Only reads things that are fixed at construction (the processor count) and the atomic ID
+//   counter, so this is safe to call from any thread.  Rejected jobs never reach the scheduler
+//   thread, so they don't show up in the stats.
+template <typename P>
+jobid_t BasicScheduler<P>::submitJob(const JobInfo& jobinfo)
+{
+    if(!isValidJob(jobinfo))
+        return NoJob;
+
+    Submission sub;
+    sub.id = ++lastJobId;
+    if(sub.id == NoJob)             // 'NoJob' is reserved
+        sub.id = ++lastJobId;
+    sub.info = jobinfo;
+
+    while(!ingress.tryPush( std::move(sub) ))
+        std::this_thread::yield();
+
+    return sub.id;
+}
+
+// Called by the scheduler thread at the start of every tick/advance/drain.  Takes at most one
+//   ring's worth, so producers that never stop can't hold the scheduler here forever.
+template <typename P>
+void BasicScheduler<P>::acceptSubmissions()
+{
+    Submission sub;
+    for(std::size_t n = ingress.capacity(); n > 0 && ingress.tryPop(sub); --n)
+    {
+        // IDs from submitJob can't check for collisions, which can only happen if the counter
+        //   has wrapped all the way around
+        if(isJobIdInUse(sub.id))
+            throw SchedulerException("Internal Error:  submitted job ID is already in use");
+
+        stats.submitted(true);
+        batch.push_back( makeJob(sub.id, sub.info) );
+        logEvent(EventKind::Submit, batch.back(), sub.info.numTicks);
+    }
+
+    putBatchInWaitQueue();
+}
+
+template <typename P>
+bool BasicScheduler<P>::adoptJob(const PortableJob& job)
+{
+    bool valid = isValidJob(job.info) && job.ticksRemaining > 0 && job.ticksRemaining <= job.info.numTicks
+                 && job.id != NoJob && !isJobIdInUse(job.id);
+
+    stats.submitted(valid);
+    if(!valid)
+    {
+        logRejected(job.info, job.id);
+        return false;
+    }
+
+    ScheduledJob sj = makeJob(job.id, job.info);
+    sj.ticksRemaining = job.ticksRemaining;
+    sj.bumps = job.bumps;
+    sj.submitTick = job.submitTick;
+    sj.startTick = job.startTick;
+    logEvent(EventKind::Submit, sj, job.info.numTicks);
+    putJobInWaitQueue( std::move(sj) );
     needProcAssign = true;
+    return true;
+}
+
+template <typename P>
+bool BasicScheduler<P>::takeWaitingJob(unsigned maxProcs, PortableJob& out)
+{
+    auto i = waitQueue.findNext(waitQueue.begin(), [maxProcs](typename QueueSummary::value_type s) { return QueueSummary::procs(s) <= maxProcs; });
+    if(i == waitQueue.end())
+        return false;
+
+    out.id = i->id;
+    out.info.description = getDescription(*i);
+    out.info.numProcs = i->numProcs;
+    out.info.numTicks = i->numTicks;
+    out.ticksRemaining = i->ticksRemaining;
+    out.bumps = i->bumps;
+    out.submitTick = i->submitTick;
+    out.startTick = i->startTick;
+    logEvent(EventKind::Withdraw, *i, i->ticksRemaining);
 
+    releaseJob(*i);
+    waitQueue.erase(i);
+    needProcAssign = true;      // whatever it was holding up might fit now
     return true;
 }
 
+template <typename P>
+ScheduledJob BasicScheduler<P>::makeJob(jobid_t id, const JobInfo& jobinfo)
+{
+    ScheduledJob job;
+    job.id = id;
+    job.rank = 0;
+    job.description = descriptions.intern(jobinfo.description);
+    job.numProcs = jobinfo.numProcs;
+    job.numTicks = jobinfo.numTicks;
+    job.ticksRemaining = jobinfo.numTicks;
+    job.bumps = 0;
+    job.submitTick = clock;
+    job.startTick = NoTick;
+    return job;
+}
+
 
-jobid_t Scheduler::getUniqueJobId()
+template <typename P>
+jobid_t BasicScheduler<P>::getUniqueJobId()
 {
+    // IDs are handed out in order, so this only loops if the counter wraps around and runs into
+    //   a job that is still around.
+    jobid_t id;
     do 
     {
-        ++lastJobId;
-    }while( isJobIdInUse(lastJobId) );
+        id = ++lastJobId;
+    }while( id == NoJob || isJobIdInUse(id) );      // 'NoJob' is a reserved Job ID, it can never be assigned
+
+    return id;
+}
+
+template <typename P>
+bool BasicScheduler<P>::isJobIdInUse(jobid_t id) const
+{
+    return jobIds.contains(id);
+}
+
+template <typename P>
+JobState BasicScheduler<P>::getJobState(jobid_t id) const
+{
+    auto loc = jobIds.find(id);
+    return loc ? loc->state : JobState::Unknown;
+}
+
+template <typename P>
+const std::string& BasicScheduler<P>::getDescription(const ScheduledJob& job) const
+{
+    return descriptions.get(job.description);
+}
+
+template <typename P>
+const ScheduledJob* BasicScheduler<P>::findJob(jobid_t id) const
+{
+    auto loc = jobIds.find(id);
+    if(!loc)                                return nullptr;
+    if(loc->state == JobState::Waiting)     return &waitQueue.get(loc->waitPos);
+    return &*completions.get(loc->completionPos).job;
+}
+
+template <typename P>
+bool BasicScheduler<P>::queuePosition(jobid_t id, std::size_t& pos) const
+{
+    auto loc = jobIds.find(id);
+    if(!loc || loc->state != JobState::Waiting)
+        return false;
+    pos = waitQueue.rank( waitQueue.locate(loc->waitPos) );
+    return true;
+}
 
-    return lastJobId;
+template <typename P>
+bool BasicScheduler<P>::jobsAhead(jobid_t id, unsigned maxProcs, std::size_t& count) const
+{
+    auto loc = jobIds.find(id);
+    if(!loc || loc->state != JobState::Waiting)
+        return false;
+    count = waitQueue.countIf(waitQueue.begin(), waitQueue.locate(loc->waitPos),
+                              [maxProcs](typename QueueSummary::value_type s) { return QueueSummary::procs(s) <= maxProcs; },
+                              [maxProcs](typename QueueSummary::value_type s) { return QueueSummary::maxProcs(s) <= maxProcs; });
+    return true;
 }
 
-bool Scheduler::isJobIdInUse(jobid_t id) const
+template <typename P>
+const ScheduledJob* BasicScheduler<P>::waitingJobAt(std::size_t k) const
 {
-    return usedJobIds.find(id) != usedJobIds.end();
+    if(k >= numWaiting())
+        return nullptr;
+    return &*waitQueue.nth(k);
 }
 
+template <typename P>
+bool BasicScheduler<P>::getJobMetrics(jobid_t id, JobMetrics& out) const
+{
+    auto job = findJob(id);
+    if(!job)
+        return false;
+    out = jobMetrics(*job, getJobState(id) == JobState::Active, NoTick);
+    return true;
+}
 
-void Scheduler::putJobInWaitQueue( ScheduledJob&& job )
+template <typename P>
+JobMetrics BasicScheduler<P>::jobMetrics(const ScheduledJob& job, bool active, tick_t end) const
 {
-    waitQueue.insert( std::move(job) );
+    JobMetrics m;
+    m.id = job.id;
+    m.submitTick = job.submitTick;
+    m.startTick = job.startTick;
+    m.endTick = end;
+    m.bumps = job.bumps;
+    m.numProcs = job.numProcs;
+    m.numTicks = job.numTicks;
+    m.ticksRun = job.numTicks - (active ? ticksRemaining(job) : job.ticksRemaining);
+    return m;
+}
+
+// The processors in use now stay in use for the next 'ticks' ticks
+template <typename P>
+void BasicScheduler<P>::passTime(tick_t ticks)
+{
+    metrics.passTime(numProcs() - availProcs.numFree(), numProcs(), ticks);
+}
+
+
+template <typename P>
+void BasicScheduler<P>::putJobInWaitQueue( ScheduledJob&& job )
+{
+    job.rank = policy.rank(job);
+
+    JobLocation loc;
+    loc.state = JobState::Waiting;
+    loc.waitPos = waitQueue.handle( waitQueue.insert( std::move(job) ) );
+    jobIds.insert(waitQueue.get(loc.waitPos).id, loc);
+}
+
+// Moves everything in 'batch' into the wait queue
+template <typename P>
+void BasicScheduler<P>::putBatchInWaitQueue()
+{
+    if(batch.empty())
+        return;
+
+    for(auto& job : batch)
+        job.rank = policy.rank(job);
+    waitQueue.insert_bulk( std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()),
+                           std::back_inserter(batchPos) );
+
+    JobLocation loc;
+    loc.state = JobState::Waiting;
+    for(auto& h : batchPos)
+    {
+        loc.waitPos = h;
+        jobIds.insert(waitQueue.get(h).id, loc);
+    }
+
+    batch.clear();
+    batchPos.clear();
+    needProcAssign = true;
+}
+
+template <typename P>
+void BasicScheduler<P>::putJobInActiveList( ScheduledJob&& job )
+{
+    auto pos = activeJobs.insert( activeJobs.end(), std::move(job) );
+
+    Completion c;
+    c.endTick = pos->endTick;
+    c.seq = activationSeq++;
+    c.numProcs = pos->numProcs;
+    c.job = pos;
+
+    JobLocation loc;
+    loc.state = JobState::Active;
+    loc.completionPos = completions.handle( completions.insert(c) );
+    jobIds.insert(pos->id, loc);
 }
 
 //////////////////////////////////////////////
 
-void Scheduler::tick()
+template <typename P>
+void BasicScheduler<P>::tick()
 {
-    if(needProcAssign)
-        assignProcs();
+    advance(1);
+}
+
+// A tick where no job completes doesn't change anything but the clock:  the first call to
+//   assignProcs in a tick only does something if a job was added since the last tick, and the
+//   second only does something if a job completed.  So rather than stepping one tick at a time,
+//   we can jump straight to the tick where the next job completes.
+template <typename P>
+void BasicScheduler<P>::advance(tick_t ticks)
+{
+    acceptSubmissions();
+
+    while(ticks > 0)
+    {
+        if(needProcAssign)
+            assignProcs();
+
+        // number of ticks we can skip without anything completing
+        tick_t skip = ticks;
+        if(!completions.empty() && completions.begin()->endTick - clock - 1 < skip)
+            skip = completions.begin()->endTick - clock - 1;
+
+        passTime(skip);
+        clock += skip;
+        ticks -= skip;
+        if(ticks == 0)
+            break;
 
-    runActiveJobs();
+        runActiveJobs();
+        --ticks;
 
+        if(needProcAssign)
+            assignProcs();
+    }
+}
+
+template <typename P>
+void BasicScheduler<P>::schedule()
+{
+    acceptSubmissions();
     if(needProcAssign)
         assignProcs();
 }
 
-void Scheduler::runActiveJobs()
+template <typename P>
+tick_t BasicScheduler<P>::nextCompletion() const
+{
+    return completions.empty() ? NoTick : completions.begin()->endTick;
+}
+
+template <typename P>
+void BasicScheduler<P>::drain()
 {
-    auto i = activeJobs.begin();
-    while(i != activeJobs.end())
+    acceptSubmissions();
+
+    while(!idle())
     {
-        i->ticksRemaining--;
-        if(i->ticksRemaining == 0)      // this job is complete!
-        {
-            freeProcessors(*i);     // free the processors used by this job
-            usedJobIds.erase(i->id);
-            i = activeJobs.erase(i);
-        }
-        else
-            ++i;
+        if(needProcAssign)
+            assignProcs();
+
+        // Every job fits on the machine, so if anything is waiting, something must be running.
+        if(completions.empty())
+            throw SchedulerException("Internal Error:  jobs are waiting but none are running");
+
+        advance(completions.begin()->endTick - clock);
     }
 }
 
-void Scheduler::allocateProcessors(ScheduledJob& job)
+template <typename P>
+void BasicScheduler<P>::runActiveJobs()
 {
-    for(unsigned i = 0; i < job.info.numProcs; ++i)
-    {
-        auto prid = availProcs.back();
+    SchedStats::Timer timer(stats, SchedPhase::Run);
+
+    passTime(1);
+    ++clock;
+    while(!completions.empty() && completions.begin()->endTick <= clock)     // this job is complete!
+        completeJob(completions.begin());
+}
+
+template <typename P>
+bool BasicScheduler<P>::finishJob(jobid_t id)
+{
+    auto loc = jobIds.find(id);
+    if(!loc || loc->state != JobState::Active)
+        return false;
+
+    completeJob(completions.locate(loc->completionPos));
+    needProcAssign = true;
+    return true;
+}
+
+template <typename P>
+void BasicScheduler<P>::completeJob(typename completion_t::iterator c)
+{
+    auto i = c->job;
+    completions.erase(c);
+
+    freeProcessors(*i);     // free the processors used by this job
+    logEvent(EventKind::Complete, *i, i->numTicks);
+    JobMetrics m = jobMetrics(*i, true, clock);
+    metrics.completed(m);
+    if(onCompletion)
+        onCompletion(m);
+    releaseJob(*i);
+    activeJobs.erase(i);
+    stats.completed();
+}
+
+// Forgets a job that's leaving the scheduler.  The caller erases it from its queue.
+template <typename P>
+void BasicScheduler<P>::releaseJob(const ScheduledJob& job)
+{
+    jobIds.erase(job.id);
+    if(descriptions.release(job.description))
+        policy.forget(job.description);
+}
 
-        job.procsUsed[i] = prid;
-        processors[prid] = job.id;
+template <typename P>
+bool BasicScheduler<P>::cancelJob(jobid_t id)
+{
+    auto loc = jobIds.find(id);
+    if(!loc)
+        return false;
 
-        availProcs.pop_back();
+    if(loc->state == JobState::Waiting)
+    {
+        auto i = waitQueue.locate(loc->waitPos);
+        logEvent(EventKind::Cancel, *i, i->ticksRemaining);
+        releaseJob(*i);
+        waitQueue.erase(i);
+    }
+    else
+    {
+        auto c = completions.locate(loc->completionPos);
+        auto i = c->job;
+        completions.erase(c);
+        freeProcessors(*i);
+        logEvent(EventKind::Cancel, *i, ticksRemaining(*i));
+        releaseJob(*i);
+        activeJobs.erase(i);
     }
+    needProcAssign = true;
+    return true;
 }
 
-void Scheduler::freeProcessors(ScheduledJob& job)
+// A waiting job is taken out of the queue and put back under its new key.  A running job only
+//   moves in the completion index; it keeps its activation order, so it still completes after
+//   any job that started before it and ends on the same tick.
+template <typename P>
+bool BasicScheduler<P>::updateJob(jobid_t id, unsigned numTicks, unsigned numProcs)
 {
-    for(unsigned i = 0; i < job.info.numProcs; ++i)
+    auto loc = jobIds.find(id);
+    if(!loc || !isValidJob(JobInfo{std::string(), numProcs, numTicks}))
+        return false;
+
+    if(loc->state == JobState::Waiting)
     {
-        auto prid = job.procsUsed[i];
-        job.procsUsed[i] = NoProc;
-        if(prid == NoProc)
-            throw SchedulerException("Internal Error:  freeProcessors called on a job with unassigned procs");
+        auto i = waitQueue.locate(loc->waitPos);
+        unsigned ran = i->numTicks - i->ticksRemaining;
+        if(numTicks <= ran)
+            return false;
 
-        availProcs.push_back(prid);
-        processors[prid] = NoJob;
+        ScheduledJob job = std::move(*i);
+        waitQueue.erase(i);
+        job.numProcs = numProcs;
+        job.numTicks = numTicks;
+        job.ticksRemaining = numTicks - ran;
+        logEvent(EventKind::Update, job, job.ticksRemaining);
+        putJobInWaitQueue( std::move(job) );
     }
+    else
+    {
+        auto c = completions.locate(loc->completionPos);
+        auto i = c->job;
+        unsigned ran = i->numTicks - ticksRemaining(*i);
+        if(numProcs != i->numProcs || numTicks <= ran)
+            return false;
+
+        Completion moved = *c;
+        completions.erase(c);
+        i->numTicks = numTicks;
+        i->endTick = clock + (numTicks - ran);
+        moved.endTick = i->endTick;
+        loc->completionPos = completions.handle( completions.insert(moved) );
+        logEvent(EventKind::Update, *i, ticksRemaining(*i));
+    }
+    needProcAssign = true;      // a bigger or smaller job changes what fits, and what could be bumped
+    return true;
+}
+
+//////////////////////////////////////////////
+
+template <typename P>
+void BasicScheduler<P>::allocateProcessors(ScheduledJob& job)
+{
+    if(!availProcs.allocate(job.numProcs, procScratch.data()))
+        throw SchedulerException("Internal Error:  allocateProcessors called without enough free procs");
 
+    for(unsigned i = 0; i < job.numProcs; ++i)
+        processors[procScratch[i]] = job.id;
+    job.procsUsed.assign(procScratch.data(), job.numProcs);
+}
+
+template <typename P>
+void BasicScheduler<P>::freeProcessors(ScheduledJob& job)
+{
+    if(job.procsUsed.size() != job.numProcs)
+        throw SchedulerException("Internal Error:  freeProcessors called on a job with unassigned procs");
+
+    job.procsUsed.copyTo(procScratch.data());
+    for(unsigned i = 0; i < job.numProcs; ++i)
+        processors[procScratch[i]] = NoJob;
+    availProcs.release(procScratch.data(), job.numProcs);
+
+    job.procsUsed.vacate();     // a bumped job will want the same room again
     needProcAssign = true;
 }
 
@@ -142,126 +593,643 @@ void Scheduler::freeProcessors(ScheduledJob& job)
 //    Before running above logic, look at the first entry in the wait queue.
 //  If we can swap out jobs that are currently running (but have a higher tick count) than
 //  that job to make room for that job, do so.
+//
+// That's the ShortestJobFirst policy.  Other policies rank the queue differently, and can turn
+//  off the swapping out (BumpRule::None) or the skipping (FillRule::InOrder), or only allow
+//  skipping that can't delay the first job that didn't fit (FillRule::Backfill).  See policy.h.
 
-void Scheduler::assignProcs()
+template <typename P>
+void BasicScheduler<P>::assignProcs()
 {
     // nothing to do here if the wait queue is empty
     if(waitQueue.empty())       return;     
 
+    stats.assignCall();
+
     // Next job in the wait queue is 'next'.  If there are jobs running that have a higher tick count
     //   than 'next', see if booting them out will create enough room for next.  If yes, do that.
     auto& next = *waitQueue.begin();
 
-    auto avail = availProcs.size();
-    if(avail < next.info.numProcs)     // only do this if we don't have enough to run 'next'
+    auto avail = availProcs.numFree();
+    if(P::bump == BumpRule::Longer && avail < next.numProcs)     // only do this if we don't have enough to run 'next'
     {
-        std::vector<activelst_t::iterator>  bootable;
-        for(auto i = activeJobs.begin(); i != activeJobs.end(); ++i)
-        {
-            if(next.ticksRemaining < i->ticksRemaining)
-            {
-                bootable.push_back(i);
-                avail += i->info.numProcs;
-            }
-        }
+        SchedStats::Timer timer(stats, SchedPhase::Bump);
+
+        // bootable jobs are the ones that finish after 'next' would:  a tail of the completion index
+        Completion last;
+        last.endTick = clock + next.ticksRemaining;
+        last.seq = std::numeric_limits<std::uint64_t>::max();
+        auto first = completions.upper_bound(last);
 
         // if we boot all bootable jobs, would that free up enough procs?  If yes, do it
-        if(avail >= next.info.numProcs)
+        if(first != completions.end() && avail + completions.summarizeFrom(first) >= next.numProcs)
         {
-            for(auto& i : bootable)
+            for(auto c = first; c != completions.end(); )
             {
+                auto i = c->job;
+                c = completions.erase(c);
+
                 freeProcessors(*i);
-                waitQueue.insert( std::move(*i) );
+                i->ticksRemaining = ticksRemaining(*i);
+                ++i->bumps;
+                logEvent(EventKind::Bump, *i, i->ticksRemaining);
+                putJobInWaitQueue( std::move(*i) );
                 activeJobs.erase(i);
+                stats.bumped();
             }
         }
     }
 
-    //  Now run the "main" logic... just walk through the wait queue in order and make
-    //     jobs active.
+    //  Now run the "main" logic... walk through the wait queue in order and make jobs active.
+    //     The free count only goes down as we go, so a job we skip now could never have fit later
+    //     in the walk -- which means findNext can skip whole runs of too-big jobs at once.
+    SchedStats::Timer timer(stats, SchedPhase::Fill);
+    std::uint64_t visited = 0;
     auto i = waitQueue.begin();
 
     //  keep looping as long as we have waiting jobs and available processors
-    while(i != waitQueue.end() && !availProcs.empty())
+    while(!availProcs.empty())
     {
-        // can we service this job?
-        if(availProcs.size() >= i->info.numProcs)
+        ++visited;
+
+        auto free = availProcs.numFree();
+        if(P::fill == FillRule::FirstFit)
+            i = waitQueue.findNext(i, [free](typename QueueSummary::value_type s) { return QueueSummary::procs(s) <= free; });
+        if(i == waitQueue.end())
+            break;
+        if(i->numProcs > free)
         {
-            allocateProcessors(*i);
-            activeJobs.push_back( std::move(*i) );
-            i = waitQueue.erase(i);
+            if(P::fill == FillRule::Backfill)
+                visited += backfill(i);
+            break;
         }
-        else
-            ++i;
+
+        startJob(*i);
+        i = waitQueue.erase(i);
     }
+    stats.visited(visited);
 
     needProcAssign = false;
 }
 
+// 'head' is the first job in the queue that doesn't fit.  Reserve processors for it at the
+//   shadow time -- the tick the running jobs will have freed enough of them -- then start any
+//   later job that can't push that back:  one that finishes by the shadow time, or one that only
+//   uses the processors 'head' won't need then (the extra).  Returns the number of jobs visited.
+//
+// The completion index is ordered by end tick and keeps processor totals, so the shadow time is
+//   one prefix search and the extra is one bound and two sums:  O(log n) however many jobs run.
+template <typename P>
+std::uint64_t BasicScheduler<P>::backfill(typename queue_t::iterator head)
+{
+    unsigned free = availProcs.numFree();
+    unsigned need = head->numProcs - free;
 
-/////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////
+    unsigned freed = 0;
+    auto c = completions.findPrefix([need](unsigned procs) { return procs >= need; }, freed);
+    if(c == completions.end())
+        throw SchedulerException("Internal Error:  running jobs won't free enough processors for the head of the queue");
+    tick_t shadow = c->endTick;
 
-namespace
+    // every job ending on the shadow tick frees its processors then, not just the ones up to 'c'
+    Completion last;
+    last.endTick = shadow;
+    last.seq = std::numeric_limits<std::uint64_t>::max();
+    auto after = completions.upper_bound(last);
+    if(after != completions.end())
+        freed = completions.summarizeFrom(completions.begin()) - completions.summarizeFrom(after);
+    else
+        freed = completions.summarizeFrom(completions.begin());
+    unsigned extra = free + freed - head->numProcs;
+
+    // skip every stretch of the queue with nothing that fits now and either finishes in time or
+    //   fits in the extra
+    tick_t latest = shadow - clock;
+    auto candidate = [&free, &extra, latest](typename QueueSummary::value_type s)
+    {
+        return QueueSummary::procs(s) <= free && (QueueSummary::procs(s) <= extra || QueueSummary::ticks(s) <= latest);
+    };
+
+    std::uint64_t visited = 0;
+    auto i = head;
+    ++i;
+    while(!availProcs.empty())
+    {
+        ++visited;
+
+        free = availProcs.numFree();
+        i = waitQueue.findNext(i, candidate);
+        if(i == waitQueue.end())
+            break;
+
+        // a job that runs past the shadow time was only a candidate because it fits in the extra
+        if(clock + i->ticksRemaining > shadow)
+            extra -= i->numProcs;
+
+        startJob(*i);
+        i = waitQueue.erase(i);
+    }
+    return visited;
+}
+
+// Moves 'job' (in the wait queue) to the active list.  The caller erases it from the queue.
+template <typename P>
+void BasicScheduler<P>::startJob(ScheduledJob& job)
+{
+    allocateProcessors(job);
+    policy.started(job);
+    logEvent(EventKind::Admit, job, job.ticksRemaining);
+    if(job.startTick == NoTick)
+        job.startTick = clock;
+    job.endTick = clock + job.ticksRemaining;
+    putJobInActiveList( std::move(job) );
+    stats.admitted();
+}
+
+//////////////////////////////////////////////
+
+template <typename P>
+void BasicScheduler<P>::openEventLog(const std::string& path, const EventLogOptions& opts)
 {
-    std::string getProcString(unsigned count, const procid_t* ids)
+    closeEventLog();
+    events.reset( new EventLog(path, opts) );
+}
+
+template <typename P>
+EventLogStats BasicScheduler<P>::closeEventLog()
+{
+    if(!events)
+        return EventLogStats();
+
+    std::unique_ptr<EventLog> log( std::move(events) );     // gone either way, even if close throws
+    log->close();
+    return log->stats();
+}
+
+template <typename P>
+void BasicScheduler<P>::logEvent(EventKind kind, const ScheduledJob& job, unsigned ticks)
+{
+    if(onJobEvent)
+        onJobEvent(kind, job);
+    if(!events)
+        return;
+
+    EventRecord e;
+    e.tick = clock;
+    e.job = job.id;
+    e.kind = static_cast<std::uint32_t>(kind);
+    e.numProcs = job.numProcs;
+    e.ticks = ticks;
+    e.firstProc = (kind == EventKind::Admit) ? static_cast<std::uint32_t>(job.procsUsed[0]) : NoEventProc;
+    events->record(e);
+}
+
+template <typename P>
+void BasicScheduler<P>::logRejected(const JobInfo& jobinfo, jobid_t id)
+{
+    if(!events)
+        return;
+
+    EventRecord e;
+    e.tick = clock;
+    e.job = id;
+    e.kind = static_cast<std::uint32_t>(EventKind::Reject);
+    e.numProcs = jobinfo.numProcs;
+    e.ticks = jobinfo.numTicks;
+    e.firstProc = NoEventProc;
+    events->record(e);
+}
+
+
+//////////////////////////////////////////////
+
+// Everything goes out in the order loadCheckpoint wants it back:  the wait queue in queue order
+//   (with each job's rank, so the policy doesn't have to rank it again) and the active jobs in
+//   the order they started (which is how completions on the same tick are ordered).
+template <typename P>
+void BasicScheduler<P>::saveCheckpoint(const std::string& path)
+{
+    acceptSubmissions();
+
+    CheckpointHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::strncpy(hdr.policy, P::name(), sizeof(hdr.policy) - 1);
+    hdr.numProcs = numProcs();
+    hdr.groupSize = availProcs.perGroup();
+    hdr.clock = clock;
+    hdr.lastJobId = lastJobId;
+    hdr.needProcAssign = needProcAssign ? 1 : 0;
+
+    CheckpointWriter out(path);
+
+    std::vector<std::uint64_t> words;
+    policy.save(words);
+    hdr.policyWords = static_cast<std::uint32_t>(words.size());
+    out.write(words.data(), words.size() * sizeof(std::uint64_t));
+    out.endSection();
+
+    hdr.numStrings = descriptions.endId();
+    for(strid_t id = 0; id < descriptions.endId(); ++id)
+    {
+        CheckpointString str;
+        str.refs = descriptions.refCount(id);
+        str.length = str.refs ? static_cast<std::uint32_t>(descriptions.get(id).size()) : 0;
+        hdr.textBytes += str.length;
+        out.write(&str, sizeof(str));
+    }
+    out.endSection();
+
+    auto& unused = descriptions.unusedIds();
+    hdr.numUnusedStrings = static_cast<std::uint32_t>(unused.size());
+    out.write(unused.data(), unused.size() * sizeof(strid_t));
+    out.endSection();
+
+    for(strid_t id = 0; id < descriptions.endId(); ++id)
+    {
+        if(descriptions.refCount(id))
+            out.write(descriptions.get(id).data(), descriptions.get(id).size());
+    }
+    out.endSection();
+
+    CheckpointJob rec;
+    std::memset(&rec, 0, sizeof(rec));
+    for(auto& job : waitQueue)
+    {
+        rec.id = job.id;
+        rec.tick = job.rank;
+        rec.description = job.description;
+        rec.numProcs = job.numProcs;
+        rec.numTicks = job.numTicks;
+        rec.ticksRemaining = job.ticksRemaining;
+        rec.submitTick = job.submitTick;
+        rec.startTick = job.startTick;
+        rec.bumps = job.bumps;
+        out.write(&rec, sizeof(rec));
+    }
+    hdr.numWaiting = waitQueue.size();
+    out.endSection();
+
+    for(auto& job : activeJobs)
+    {
+        rec.id = job.id;
+        rec.tick = job.endTick;
+        rec.description = job.description;
+        rec.numProcs = job.numProcs;
+        rec.numTicks = job.numTicks;
+        rec.ticksRemaining = 0;
+        rec.submitTick = job.submitTick;
+        rec.startTick = job.startTick;
+        rec.bumps = job.bumps;
+        out.write(&rec, sizeof(rec));
+        hdr.numProcIds += job.numProcs;
+    }
+    hdr.numActive = activeJobs.size();
+    out.endSection();
+
+    std::uint32_t ids[256];
+    for(auto& job : activeJobs)
     {
-        std::string out;
-        for(unsigned i = 0; i < count; ++i)
+        job.procsUsed.copyTo(procScratch.data());
+        for(unsigned i = 0; i < job.numProcs; i += 256)
         {
-            if(i)       out += ", ";
-            out += std::to_string(ids[i]);
+            unsigned n = std::min(job.numProcs - i, 256u);
+            for(unsigned k = 0; k < n; ++k)
+                ids[k] = static_cast<std::uint32_t>(procScratch[i + k]);
+            out.write(ids, n * sizeof(std::uint32_t));
         }
-        return out;
     }
+
+    out.finish(hdr);
 }
 
-void Scheduler::printActiveJobs(std::ostream& s) const
+// The checksum has already caught a damaged file, but everything is still checked as it goes in,
+//   so a checkpoint that doesn't make sense can't leave the scheduler in a state that doesn't
+//   either.  The waiting jobs were saved in queue order, so they go back in with one bulk insert
+//   that links them up without sorting.
+template <typename P>
+void BasicScheduler<P>::loadCheckpoint(const std::string& path)
 {
-    using namespace std;
+    acceptSubmissions();
+    if(!idle() || clock != 0 || lastJobId != 0 || !descriptions.empty())
+        throw SchedulerException("A checkpoint can only be loaded into a scheduler that hasn't been used");
 
-    s << "Active Jobs:\n";
-    s << "Job Id  | Job Description         | Ticks Left |  Procs Used\n";
-    s << "----------------------------------------------------------------\n";
+    CheckpointReader in(path);
+    const CheckpointHeader& hdr = in.header();
+    if(std::strncmp(hdr.policy, P::name(), sizeof(hdr.policy)) != 0)
+        throw SchedulerException("'" + path + "' was saved by a '" + hdr.policy + "' scheduler, not '" + P::name() + "'");
+    if(hdr.numProcs != numProcs() || hdr.groupSize != availProcs.perGroup())
+        throw SchedulerException("'" + path + "' was saved by a scheduler with different processors");
 
-    if(activeJobs.empty())
-    {
-        s << "(No Active Jobs)\n";
-    }
-    else
+    const std::uint64_t*    words = in.section<std::uint64_t>(hdr.policyWords);
+    const CheckpointString* strings = in.section<CheckpointString>(hdr.numStrings);
+    const strid_t*          unused = in.section<strid_t>(hdr.numUnusedStrings);
+    const char*             text = in.section<char>(hdr.textBytes);
+    const CheckpointJob*    waiting = in.section<CheckpointJob>(hdr.numWaiting);
+    const CheckpointJob*    active = in.section<CheckpointJob>(hdr.numActive);
+    const std::uint32_t*    procIds = in.section<std::uint32_t>(hdr.numProcIds);
+
+    try
     {
-        for(auto& i : activeJobs)
+        // strings:  count the references the jobs make, and check they match the saved counts
+        std::vector<std::string> texts(hdr.numStrings);
+        std::vector<std::uint32_t> refs(hdr.numStrings, 0);
+        std::uint64_t offset = 0;
+        for(std::uint32_t id = 0; id < hdr.numStrings; ++id)
+        {
+            if(strings[id].length > hdr.textBytes - offset)
+                throw SchedulerException("string text runs past the end of its section");
+            texts[id].assign(text + offset, strings[id].length);
+            offset += strings[id].length;
+        }
+
+        auto checkJob = [&](const CheckpointJob& rec)
+        {
+            JobInfo info;
+            info.numProcs = rec.numProcs;
+            info.numTicks = rec.numTicks;
+            if(!isValidJob(info) || rec.id == NoJob || rec.description >= hdr.numStrings || rec.submitTick > hdr.clock
+               || (rec.startTick != NoTick && (rec.startTick < rec.submitTick || rec.startTick > hdr.clock)))
+                throw SchedulerException("job " + std::to_string(rec.id) + " is invalid");
+            ++refs[rec.description];
+        };
+        for(std::uint64_t i = 0; i < hdr.numWaiting; ++i)
         {
-            s << left << setw(8) << setfill(' ') << i.id << "| ";
-            s << left << setw(24) << setfill(' ') << i.info.description << "| ";
-            s << left << setw(11) << setfill(' ') << i.ticksRemaining << "| ";
-            s << getProcString(i.info.numProcs, i.procsUsed.get()) << '\n';
+            checkJob(waiting[i]);
+            if(waiting[i].ticksRemaining == 0 || waiting[i].ticksRemaining > waiting[i].numTicks)
+                throw SchedulerException("waiting job " + std::to_string(waiting[i].id) + " has a bad tick count");
         }
+        for(std::uint64_t i = 0; i < hdr.numActive; ++i)
+        {
+            checkJob(active[i]);
+            if(active[i].tick <= hdr.clock || active[i].tick - hdr.clock > active[i].numTicks || active[i].startTick == NoTick)
+                throw SchedulerException("active job " + std::to_string(active[i].id) + " has a bad end tick");
+        }
+        for(std::uint32_t id = 0; id < hdr.numStrings; ++id)
+        {
+            if(refs[id] != strings[id].refs)
+                throw SchedulerException("string reference counts don't match the jobs");
+        }
+
+        descriptions.restore(std::move(texts), refs, std::vector<strid_t>(unused, unused + hdr.numUnusedStrings));
+        policy.load(words, hdr.policyWords);
+
+        // the wait queue
+        jobIds.reserve(hdr.numWaiting + hdr.numActive);
+        batch.reserve(hdr.numWaiting);
+        for(std::uint64_t i = 0; i < hdr.numWaiting; ++i)
+        {
+            const CheckpointJob& rec = waiting[i];
+            ScheduledJob job;
+            job.id = rec.id;
+            job.rank = rec.tick;
+            job.description = rec.description;
+            job.numProcs = rec.numProcs;
+            job.numTicks = rec.numTicks;
+            job.ticksRemaining = rec.ticksRemaining;
+            job.bumps = rec.bumps;
+            job.submitTick = rec.submitTick;
+            job.startTick = rec.startTick;
+            batch.push_back( std::move(job) );
+        }
+        waitQueue.insert_bulk( std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()),
+                               std::back_inserter(batchPos) );
+        batch.clear();
+
+        JobLocation loc;
+        loc.state = JobState::Waiting;
+        for(auto& h : batchPos)
+        {
+            loc.waitPos = h;
+            jobid_t id = waitQueue.get(h).id;
+            if(isJobIdInUse(id))
+                throw SchedulerException("job ID " + std::to_string(id) + " is used twice");
+            jobIds.insert(id, loc);
+        }
+        batchPos.clear();
+
+        // the active jobs, on exactly the processors they had
+        clock = hdr.clock;
+        std::uint64_t used = 0;
+        for(std::uint64_t i = 0; i < hdr.numActive; ++i)
+        {
+            const CheckpointJob& rec = active[i];
+            if(isJobIdInUse(rec.id))
+                throw SchedulerException("job ID " + std::to_string(rec.id) + " is used twice");
+            if(rec.numProcs > hdr.numProcIds - used)
+                throw SchedulerException("there are fewer processor IDs than the active jobs use");
+
+            ScheduledJob job;
+            job.id = rec.id;
+            job.endTick = rec.tick;
+            job.description = rec.description;
+            job.numProcs = rec.numProcs;
+            job.numTicks = rec.numTicks;
+            job.ticksRemaining = static_cast<unsigned>(rec.tick - clock);
+            job.bumps = rec.bumps;
+            job.submitTick = rec.submitTick;
+            job.startTick = rec.startTick;
+
+            for(unsigned k = 0; k < rec.numProcs; ++k)
+            {
+                if(procIds[used + k] >= numProcs())
+                    throw SchedulerException("processor ID " + std::to_string(procIds[used + k]) + " is out of range");
+                procScratch[k] = procIds[used + k];
+            }
+            used += rec.numProcs;
+            availProcs.claim(procScratch.data(), job.numProcs);
+            for(unsigned k = 0; k < job.numProcs; ++k)
+                processors[procScratch[k]] = job.id;
+            job.procsUsed.assign(procScratch.data(), job.numProcs);
+
+            putJobInActiveList( std::move(job) );
+        }
+        if(used != hdr.numProcIds)
+            throw SchedulerException("there are more processor IDs than the active jobs use");
+
+        lastJobId = hdr.lastJobId;
+        needProcAssign = hdr.needProcAssign != 0;
     }
+    catch(SchedulerException& e)
+    {
+        reset();
+        throw SchedulerException("'" + path + "' can't be restored:  " + e.what());
+    }
+    catch(...)
+    {
+        reset();
+        throw;
+    }
+}
+
+// Back to the state of a new scheduler (after a failed loadCheckpoint)
+template <typename P>
+void BasicScheduler<P>::reset()
+{
+    batch.clear();
+    batchPos.clear();
+    waitQueue.clear();
+    activeJobs.clear();
+    completions.clear();
+    jobIds.clear();
+
+    std::fill(processors.begin(), processors.end(), NoJob);
+    availProcs = ProcAllocator(numProcs(), availProcs.perGroup());
+    descriptions = StringTable();
+    policy = P();
+    metrics.reset();
+
+    lastJobId = 0;
+    needProcAssign = false;
+    clock = 0;
+    activationSeq = 0;
+}
+
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+template <typename P>
+void BasicScheduler<P>::printActiveJobs(std::ostream& s) const
+{
+    char buf[4096];
+    DumpWriter out(buf, sizeof(buf), s);
+    dumpActiveJobs(out);
+}
+
+template <typename P>
+void BasicScheduler<P>::printWaitQueue(std::ostream& s) const
+{
+    char buf[4096];
+    DumpWriter out(buf, sizeof(buf), s);
+    dumpWaitQueue(out);
 }
 
+template <typename P>
+void BasicScheduler<P>::dumpCsvHeader(DumpWriter& out)
+{
+    out.write("state,id,description,ticks_left,num_procs,procs\n");
+}
 
-void Scheduler::printWaitQueue(std::ostream& s) const
+template <typename P>
+void BasicScheduler<P>::dumpActiveJobs(DumpWriter& out, DumpFormat fmt, std::size_t limit) const
 {
-    using namespace std;
-    
-    s << "Wait Queue (top is next in queue):\n";
-    s << "Job Id  | Job Description         | Ticks Left |  Num Procs Needed\n";
-    s << "----------------------------------------------------------------\n";
-    
-    if(waitQueue.empty())
+    if(fmt == DumpFormat::Table)
     {
-        s << "(Wait Queue is empty)\n";
+        out.write("Active Jobs:\n");
+        out.write("Job Id  | Job Description         | Ticks Left |  Procs Used\n");
+        out.write("----------------------------------------------------------------\n");
+        if(activeJobs.empty())
+            out.write("(No Active Jobs)\n");
     }
-    else
+
+    std::size_t count = 0;
+    for(auto& i : activeJobs)
+    {
+        if(count++ == limit)
+            break;
+        dumpJob(out, fmt, i, true);
+    }
+
+    if(fmt == DumpFormat::Table && limit < activeJobs.size())
+    {
+        out.write("(");
+        out.writeUInt(activeJobs.size() - limit);
+        out.write(" more)\n");
+    }
+}
+
+template <typename P>
+void BasicScheduler<P>::dumpWaitQueue(DumpWriter& out, DumpFormat fmt, std::size_t limit) const
+{
+    if(fmt == DumpFormat::Table)
+    {
+        out.write("Wait Queue (top is next in queue):\n");
+        out.write("Job Id  | Job Description         | Ticks Left |  Num Procs Needed\n");
+        out.write("----------------------------------------------------------------\n");
+        if(waitQueue.empty())
+            out.write("(Wait Queue is empty)\n");
+    }
+
+    std::size_t count = 0;
+    for(auto& i : waitQueue)
+    {
+        if(count++ == limit)
+            break;
+        dumpJob(out, fmt, i, false);
+    }
+
+    if(fmt == DumpFormat::Table && limit < static_cast<std::size_t>(waitQueue.size()))
     {
-        for(auto& i : waitQueue)
+        out.write("(");
+        out.writeUInt(waitQueue.size() - limit);
+        out.write(" more)\n");
+    }
+}
+
+template <typename P>
+void BasicScheduler<P>::dumpJob(DumpWriter& out, DumpFormat fmt, const ScheduledJob& job, bool active) const
+{
+    const auto& desc = descriptions.get(job.description);
+    unsigned ticks = active ? ticksRemaining(job) : job.ticksRemaining;
+
+    switch(fmt)
+    {
+    case DumpFormat::Table:
+        out.pad(8, out.writeUInt(job.id));                              out.write("| ");
+        out.pad(24, out.writeText(desc.data(), desc.size()));          out.write("| ");
+        out.pad(11, out.writeUInt(ticks));                              out.write("| ");
+        if(active)
+        {
+            for(unsigned i = 0; i < job.numProcs; ++i)
+            {
+                if(i)       out.write(", ");
+                out.writeUInt(job.procsUsed[i]);
+            }
+        }
+        else
+            out.writeUInt(job.numProcs);
+        out.put('\n');
+        break;
+
+    case DumpFormat::Csv:
+        out.write(active ? "active," : "waiting,");
+        out.writeUInt(job.id);                          out.put(',');
+        out.writeCsvField(desc.data(), desc.size());    out.put(',');
+        out.writeUInt(ticks);                           out.put(',');
+        out.writeUInt(job.numProcs);               out.put(',');
+        for(unsigned i = 0; active && i < job.numProcs; ++i)
+        {
+            if(i)       out.put(' ');
+            out.writeUInt(job.procsUsed[i]);
+        }
+        out.put('\n');
+        break;
+
+    case DumpFormat::JsonLines:
+        out.write(active ? "{\"state\":\"active\",\"id\":" : "{\"state\":\"waiting\",\"id\":");
+        out.writeUInt(job.id);
+        out.write(",\"description\":");           out.writeJsonString(desc.data(), desc.size());
+        out.write(",\"ticks_left\":");            out.writeUInt(ticks);
+        out.write(",\"num_procs\":");             out.writeUInt(job.numProcs);
+        if(active)
         {
-            s << left << setw(8) << setfill(' ') << i.id << "| ";
-            s << left << setw(24) << setfill(' ') << i.info.description << "| ";
-            s << left << setw(11) << setfill(' ') << i.ticksRemaining << "| ";
-            s << i.info.numProcs << '\n';
+            out.write(",\"procs\":[");
+            for(unsigned i = 0; i < job.numProcs; ++i)
+            {
+                if(i)       out.put(',');
+                out.writeUInt(job.procsUsed[i]);
+            }
+            out.put(']');
         }
+        out.write("}\n");
+        break;
     }
-}
\ No newline at end of file
+}
+
+
+// Every policy the scheduler can be built with.  Add new policies here (and to anyscheduler.cpp).
+template class BasicScheduler<ShortestJobFirst>;
+template class BasicScheduler<FirstComeFirstServed>;
+template class BasicScheduler<FairShare>;
+template class BasicScheduler<EasyBackfill>;
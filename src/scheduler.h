@@ -2,48 +2,343 @@
 #ifndef SCHEDULER_H_INCLUDED
 #define SCHEDULER_H_INCLUDED
 
-#include <set>
+#include "nodepool.h"
 #include "treelist.h"
+#include "blocklist.h"
 #include <vector>
 #include <list>
 #include <iostream>
+#include <atomic>
+#include <type_traits>
+#include <functional>
 #include "types.h"
 #include "job.h"
+#include "policy.h"
+#include "procalloc.h"
+#include "stringtable.h"
+#include "jobidmap.h"
+#include "mpscring.h"
+#include "dumpwriter.h"
+#include "schedstats.h"
+#include "eventlog.h"
+#include "metrics.h"
 
-class Scheduler
+// Build with -DSCHEDULER_BLOCK_QUEUE=1 (or 'make QUEUE=block') to keep the wait queue in a
+//   BlockList instead of a TreeList.
+#ifndef SCHEDULER_BLOCK_QUEUE
+#define SCHEDULER_BLOCK_QUEUE 0
+#endif
+
+//  The scheduler.  'Policy' decides the order jobs run in (see policy.h).  The member functions
+//  are defined in scheduler.cpp, which instantiates the scheduler for every policy there.  Use
+//  makeScheduler (anyscheduler.h) to pick a policy at run time.
+template <typename Policy>
+class BasicScheduler
 {
 public:
-                Scheduler(unsigned numprocs);
+    typedef Policy          policy_type;
+
+                BasicScheduler(unsigned numprocs, unsigned groupsize = 0);  // groupsize:  processors per socket/node (0 for no grouping)
     bool        addJob(const JobInfo& jobinfo);
+
+    // Adds 'count' jobs at once, with IDs handed out in order.  Invalid jobs are skipped.  Big
+    //   batches go into the wait queue with one merge-and-rebuild instead of one insert each.
+    //   Returns the number of jobs that were added.
+    std::size_t addJobs(const JobInfo* jobs, std::size_t count);
+
+    // Thread-safe job submission.  Any number of threads may call this while another thread
+    //   runs the scheduler.  The job is validated and given its ID right away, but only joins the
+    //   wait queue when the scheduler thread next calls tick/advance/drain.  Returns NoJob if the
+    //   job is invalid.  If IngressCapacity submissions are already pending, this yields until
+    //   the scheduler thread catches up -- so the scheduler thread itself should use addJob.
+    jobid_t     submitJob(const JobInfo& jobinfo);
+    static const std::size_t    IngressCapacity = 1024;
+
     void        tick();
+    void        advance(tick_t ticks);      // same as calling tick() 'ticks' times, but only does work at completions
+    void        drain();                    // runs until every job has completed
+
+    tick_t      now() const                 { return clock;                                 }
+    bool        idle() const                { return waitQueue.empty() && activeJobs.empty();   }
+
+    // Starts whatever can start now, without moving the clock.  tick/advance/drain do this anyway;
+    //   it's for a caller that wants to look at the result before time moves on.
+    void        schedule();
+
+    // A running job is done before its ticks ran out (its process exited, say):  it completes
+    //   now, and its processors go to the next schedule/tick.  Returns false if 'id' isn't running.
+    bool        finishJob(jobid_t id);
+
+    // Changing a job after it was accepted.  The job is found through the job ID table, so each
+    //   call is O(1) to find it plus O(log n) to take it out of its queue or put it back, and
+    //   touches no other job.  cancelJob takes a waiting or running job out of the scheduler
+    //   without completing it (it doesn't count in the metrics); a running job's processors go
+    //   to the next schedule/tick.  updateJob changes how many ticks (in all, as submitted) and
+    //   processors a job needs.  A waiting job goes back into the queue wherever the policy
+    //   ranks it now.  A running job keeps its processors, so only its ticks can change, and it
+    //   completes that much sooner or later.  Both return false and change nothing if 'id' isn't
+    //   waiting or running, and updateJob does too if the job couldn't run here with the new
+    //   numbers or has already run for 'numTicks'.
+    bool        cancelJob(jobid_t id);
+    bool        updateJob(jobid_t id, unsigned numTicks, unsigned numProcs);
+
+    // Moving waiting jobs between schedulers (see ShardedScheduler).  takeWaitingJob removes the
+    //   first job in queue order that needs at most 'maxProcs' processors (false if there is
+    //   none).  adoptJob queues a job from another scheduler under its own ID, and counts as a
+    //   submission here.  It returns false if the job can't run here or its ID is in use.
+    bool        takeWaitingJob(unsigned maxProcs, PortableJob& out);
+    bool        adoptJob(const PortableJob& job);
+
+    // Checkpoints (see checkpoint.h).  saveCheckpoint writes the whole state -- both queues, every
+    //   processor assignment, the clock, the job ID counter and the policy's state -- in one
+    //   sequential pass.  loadCheckpoint restores that into a scheduler that hasn't been used yet,
+    //   built with the same policy and processors, after which it schedules exactly as the saved
+    //   one would have.  Both throw SchedulerException on failure; if loading fails, this
+    //   scheduler is left empty.  Call them from the scheduler thread, with no submitJob in flight.
+    void        saveCheckpoint(const std::string& path);
+    void        loadCheckpoint(const std::string& path);
+
+    unsigned    numProcs() const            { return static_cast<unsigned>(processors.size());  }
+    unsigned    numFreeProcs() const        { return availProcs.numFree();                  }
+    std::size_t numWaiting() const          { return waitQueue.size();                      }
+    std::size_t numActive() const           { return activeJobs.size();                     }
+    tick_t      nextCompletion() const;     // the tick the next running job finishes on (NoTick if none are)
+    
+    double      fragmentation() const       { return availProcs.fragmentation();    }
+
+    // O(1) lookup of a job by its ID
+    JobState            getJobState(jobid_t id) const;
+    const ScheduledJob* findJob(jobid_t id) const;        // null if the job doesn't exist (or has completed)
+    const std::string&  getDescription(const ScheduledJob& job) const;
+
+    // Where a waiting job stands.  queuePosition is how many jobs are ahead of it in the wait
+    //   queue (0 if it's next), and jobsAhead is how many of those need at most 'maxProcs'
+    //   processors.  Both return false if 'id' isn't waiting.  waitingJobAt is the job with 'k'
+    //   jobs ahead of it (null if there isn't one).  These go by the queue's subtree sizes, so
+    //   they're O(log n).  jobsAhead counts a subtree where every job is small enough by its
+    //   size and skips one where none is, so it only goes down into subtrees that mix the two.
+    bool                queuePosition(jobid_t id, std::size_t& pos) const;
+    bool                jobsAhead(jobid_t id, unsigned maxProcs, std::size_t& count) const;
+    const ScheduledJob* waitingJobAt(std::size_t k) const;
     
     void        printActiveJobs(std::ostream& s) const;
     void        printWaitQueue(std::ostream& s) const;
 
+    // Writes the active jobs / wait queue (in queue order) to 'out', stopping after 'limit' jobs.
+    void        dumpActiveJobs(DumpWriter& out, DumpFormat fmt = DumpFormat::Table, std::size_t limit = DumpAll) const;
+    void        dumpWaitQueue(DumpWriter& out, DumpFormat fmt = DumpFormat::Table, std::size_t limit = DumpAll) const;
+    static void dumpCsvHeader(DumpWriter& out);
+
+    // Wait time, bounded slowdown and utilization (see metrics.h), kept up to date as jobs
+    //   complete and time passes, so reading them never looks at the queues.  getJobMetrics
+    //   fills in 'out' for a job that's waiting or running (false for any other ID).  The
+    //   completion handler, if set, is called with every job as it completes.
+    SchedulerMetrics        getMetrics() const                  { return metrics.get();     }
+    const SchedMetrics&     metricsCollector() const            { return metrics;           }   // for merging
+    void                    resetMetrics()                      { metrics.reset();          }
+    void                    dumpMetrics(DumpWriter& out) const  { metrics.get().dump(out);  }
+    bool                    getJobMetrics(jobid_t id, JobMetrics& out) const;
+    void                    setCompletionHandler(std::function<void(const JobMetrics&)> fn)     { onCompletion = std::move(fn);     }
+
+    // Called with every event the event log would record (but rejections), as it happens, on the
+    //   scheduler thread:  for an Admit the job already has its processors.  It's how something
+    //   outside the scheduler follows along (see executor.h).  It must not call back into the
+    //   scheduler.
+    void        setJobHandler(std::function<void(EventKind, const ScheduledJob&)> fn)       { onJobEvent = std::move(fn);       }
+
+    // Event log (see eventlog.h).  From openEventLog until closeEventLog, every submission,
+    //   rejection, admission, bump, completion, withdrawal, cancellation and update is recorded,
+    //   and a background thread writes them to 'path'.  Opening a log closes the one before.
+    //   closeEventLog writes whatever is left and returns the final counts.  Rejections by
+    //   submitJob happen on other threads, so they aren't recorded.
+    void            openEventLog(const std::string& path, const EventLogOptions& opts = EventLogOptions());
+    EventLogStats   closeEventLog();
+    EventLogStats   eventLogStats() const       { return events ? events->stats() : EventLogStats();   }
+
+    // Instrumentation counters and latency histograms.  These are all zero unless built
+    //   with SCHEDULER_STATS (see schedstats.h).
+    static const bool   statsEnabled = (SCHEDULER_STATS != 0);
+    SchedulerStats      getStats() const                { return stats.get();       }
+    void                resetStats()                    { stats.reset();            }
+    void                dumpStats(DumpWriter& out) const { stats.get().dump(out);    }
+
 private:
-    typedef TreeList<ScheduledJob>      queue_t;
-    typedef std::list<ScheduledJob>     activelst_t;
+    // Every wait queue subtree (or block) knows the smallest job in it, so assignProcs can jump
+    //   straight to the next job that fits instead of walking past every one that doesn't.  It
+    //   knows the largest too, so jobsAhead can count a subtree where every job is small enough
+    //   by its size.
+    struct ProcRange
+    {
+        struct value_type
+        {
+            unsigned        procs;          // smallest
+            unsigned        maxProcs;       // largest
+
+            bool operator == (const value_type& rhs) const  { return procs == rhs.procs && maxProcs == rhs.maxProcs;   }
+        };
+        static value_type   value(const ScheduledJob& job)      { return value_type{job.numProcs, job.numProcs};        }
+        static value_type   value(const JobKey& key)            { return value_type{key.numProcs, key.numProcs};        }
+        static value_type   combine(value_type a, value_type b)
+        {
+            return value_type{ a.procs < b.procs ? a.procs : b.procs, a.maxProcs > b.maxProcs ? a.maxProcs : b.maxProcs };
+        }
+
+        static unsigned     procs(value_type v)                 { return v.procs;               }
+        static unsigned     maxProcs(value_type v)              { return v.maxProcs;            }
+        static unsigned     ticks(value_type)                   { return 0;                     }   // not kept:  any job might be short
+    };
+    // Backfilling also looks for jobs that are short enough, so those queues keep the shortest
+    //   job too.  (Not necessarily the same job as the smallest.)
+    struct ProcRangeTicks
+    {
+        struct value_type
+        {
+            unsigned        procs;
+            unsigned        maxProcs;
+            unsigned        ticks;
+
+            bool operator == (const value_type& rhs) const  { return procs == rhs.procs && maxProcs == rhs.maxProcs && ticks == rhs.ticks;  }
+        };
+        static value_type   value(const ScheduledJob& job)      { return value_type{job.numProcs, job.numProcs, job.ticksRemaining};    }
+        static value_type   value(const JobKey& key)            { return value_type{key.numProcs, key.numProcs, key.ticksRemaining};    }
+        static value_type   combine(value_type a, value_type b)
+        {
+            return value_type{ a.procs < b.procs ? a.procs : b.procs, a.maxProcs > b.maxProcs ? a.maxProcs : b.maxProcs,
+                               a.ticks < b.ticks ? a.ticks : b.ticks };
+        }
+
+        static unsigned     procs(value_type v)                 { return v.procs;               }
+        static unsigned     maxProcs(value_type v)              { return v.maxProcs;            }
+        static unsigned     ticks(value_type v)                 { return v.ticks;               }
+    };
+    typedef typename std::conditional<Policy::fill == FillRule::Backfill, ProcRangeTicks, ProcRange>::type   QueueSummary;
+
+    struct JobKeyOf
+    {
+        typedef JobKey      key_type;
+        static JobKey       key(const ScheduledJob& job)        { return job.key();             }
+    };
+
+    typedef PoolAllocator<ScheduledJob>                         jobpool_t;
+#if SCHEDULER_BLOCK_QUEUE
+    typedef BlockList<ScheduledJob, JobKeyOf, jobpool_t, BlockListSummary<QueueSummary>>          queue_t;
+#else
+    typedef TreeList<ScheduledJob, TreeListRedBlack, jobpool_t, TreeListAggregate<QueueSummary>>  queue_t;
+#endif
+    typedef std::list<ScheduledJob, jobpool_t>                  activelst_t;
+
+    // The wait queue and active list draw their nodes from the same arena, so moving a job
+    //   between them just recycles node storage instead of going to the heap.
+    std::shared_ptr<NodeArena>  arena;
     queue_t                     waitQueue;
     activelst_t                 activeJobs;
     std::vector<jobid_t>        processors;     // each entry is the job ID the processor is using
-    std::vector<procid_t>       availProcs;
+    std::vector<procid_t>       procScratch;    // one job's processors, on their way to/from availProcs
+    ProcAllocator               availProcs;
+    StringTable                 descriptions;   // every job's description
+    Policy                      policy;
+
+    // Active jobs don't count down every tick.  Instead each one records the absolute tick it
+    //   finishes on, and the completion index -- every active job ordered by completion time --
+    //   tells us when the next one is due.  Ties are broken by activation order, so jobs finishing
+    //   on the same tick are completed in the same order they appear in 'activeJobs'.
+    //
+    //   Since the order is also "least ticks remaining first", the jobs assignProcs could bump are
+    //   always a tail of the index, and every subtree keeps its processor total so the size of
+    //   that tail is known without visiting it.
+    struct Completion
+    {
+        tick_t                  endTick;
+        std::uint64_t           seq;        // activation order
+        unsigned                numProcs;
+        activelst_t::iterator   job;
+
+        bool operator < (const Completion& rhs) const
+        {
+            if(endTick != rhs.endTick)      return endTick < rhs.endTick;
+            return seq < rhs.seq;
+        }
+    };
+    struct SumProcs
+    {
+        typedef unsigned    value_type;
+        static unsigned     value(const Completion& c)          { return c.numProcs;            }
+        static unsigned     combine(unsigned a, unsigned b)     { return a + b;                 }
+    };
+    typedef TreeList<Completion, TreeListRedBlack, PoolAllocator<Completion>, TreeListAggregate<SumProcs>>  completion_t;
+
+    // Where a job currently lives.  Handles stay valid until the job moves.  There's one of these
+    //   for every job, so an active job is found through its completion entry rather than
+    //   keeping its place in 'activeJobs' here too.
+    struct JobLocation
+    {
+        JobState                            state = JobState::Unknown;
+        typename queue_t::handle_type       waitPos;            // while waiting
+        typename completion_t::handle_type  completionPos;      // while active
+    };
+
+    // Jobs from submitJob, waiting for the scheduler thread to pick them up
+    struct Submission
+    {
+        jobid_t                 id;
+        JobInfo                 info;
+    };
+    MpscRing<Submission>        ingress;
 
-    jobid_t                     lastJobId;      // last assigned job ID
-    std::set<jobid_t>           usedJobIds;     // all job IDs that are currently used
+    std::vector<ScheduledJob>                   batch;      // scratch space for addJobs/acceptSubmissions
+    std::vector<typename queue_t::handle_type>  batchPos;
+
+    std::atomic<jobid_t>        lastJobId;      // last assigned job ID
+    JobIdMap<JobLocation>       jobIds;         // every job ID currently in use, and where that job is
     bool                        needProcAssign;
 
+    SchedStats                  stats;
+    std::unique_ptr<EventLog>   events;         // null unless a log is open
+    SchedMetrics                metrics;
+    std::function<void(const JobMetrics&)>  onCompletion;
+    std::function<void(EventKind, const ScheduledJob&)>     onJobEvent;
+
+    tick_t                      clock;          // number of ticks run so far
+    std::uint64_t               activationSeq;  // incremented for every job made active
+    completion_t                completions;
+
+    unsigned    ticksRemaining(const ScheduledJob& activejob) const { return static_cast<unsigned>(activejob.endTick - clock);   }
+
     jobid_t     getUniqueJobId();
     bool        isJobIdInUse(jobid_t id) const;
 
+    bool        isValidJob(const JobInfo& jobinfo) const;
+    ScheduledJob    makeJob(jobid_t id, const JobInfo& jobinfo);
+    void        putBatchInWaitQueue();
+    void        acceptSubmissions();
+
     void        putJobInWaitQueue(ScheduledJob&& job);
+    void        putJobInActiveList(ScheduledJob&& job);
 
     
     void        runActiveJobs();
+    void        completeJob(typename completion_t::iterator c);
+    void        releaseJob(const ScheduledJob& job);
     void        assignProcs();
+    std::uint64_t   backfill(typename queue_t::iterator head);
+    void        startJob(ScheduledJob& job);
+
+    JobMetrics  jobMetrics(const ScheduledJob& job, bool active, tick_t end) const;
+    void        passTime(tick_t ticks);
+
+    void        logEvent(EventKind kind, const ScheduledJob& job, unsigned ticks);
+    void        logRejected(const JobInfo& jobinfo, jobid_t id = NoJob);
+
+    void        dumpJob(DumpWriter& out, DumpFormat fmt, const ScheduledJob& job, bool active) const;
+
+    void        reset();
 
     void        freeProcessors(ScheduledJob& job);
     void        allocateProcessors(ScheduledJob& job);
 };
 
+// The default policy
+typedef BasicScheduler<ShortestJobFirst>        Scheduler;
+
 
 #endif
\ No newline at end of file
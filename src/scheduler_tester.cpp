@@ -0,0 +1,1045 @@
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <list>
+#include "scheduler.h"
+
+using namespace std;
+
+static const int iterations = 100;      // number of tests to perform
+static const int numsteps = 300;        // number of submissions/advances in each test
+static const unsigned numprocs = 16;
+static const char* checkpointFile = "schedtester.ckpt";
+static const char* eventLogFile = "schedtester.events";
+
+template <typename Sched>
+string dumpState(const Sched& s)
+{
+    ostringstream out;
+    s.printActiveJobs(out);
+    s.printWaitQueue(out);
+    return out.str();
+}
+
+// Policy specific checks, run on the state after every step.  'lastId' is the last job ID
+//   handed out (IDs start at 1).  One checker lasts a whole test, so it can remember things.
+template <typename Sched>
+struct PolicyCheck
+{
+    void operator () (const Sched&, jobid_t)
+    {
+    }
+};
+
+// First come, first served never lets a job start ahead of an earlier one, and never puts a
+//   running job back:  every running job was submitted before every waiting one.
+template <>
+struct PolicyCheck<BasicScheduler<FirstComeFirstServed>>
+{
+    void operator () (const BasicScheduler<FirstComeFirstServed>& s, jobid_t lastId)
+    {
+        bool waiting = false;
+        for(jobid_t id = 1; id <= lastId; ++id)
+        {
+            auto state = s.getJobState(id);
+            if(state == JobState::Waiting)
+                waiting = true;
+            else if(state == JobState::Active && waiting)
+                throw std::runtime_error("job " + to_string(id) + " is running ahead of an earlier job");
+        }
+    }
+};
+
+// EASY backfilling never delays the head of the queue.  Run times are exact, so the first tick
+//   the running jobs leave room for it can only get earlier while it waits.
+template <>
+struct PolicyCheck<BasicScheduler<EasyBackfill>>
+{
+    jobid_t     head = NoJob;
+    tick_t      reserved = 0;
+
+    void operator () (const BasicScheduler<EasyBackfill>& s, jobid_t lastId)
+    {
+        vector<pair<tick_t, unsigned>> ends;        // (end tick, procs) of every running job
+        unsigned busy = 0;
+        jobid_t first = NoJob;
+        for(jobid_t id = 1; id <= lastId; ++id)
+        {
+            auto state = s.getJobState(id);
+            if(state == JobState::Active)
+            {
+                auto job = s.findJob(id);
+                ends.emplace_back(job->endTick, job->numProcs);
+                busy += job->numProcs;
+            }
+            else if(state == JobState::Waiting && first == NoJob)
+                first = id;
+        }
+        if(first == NoJob)
+        {
+            head = NoJob;
+            return;
+        }
+
+        unsigned need = s.findJob(first)->numProcs;
+        sort(ends.begin(), ends.end());
+        tick_t fits = s.now();
+        for(auto e = ends.begin(); busy + need > numprocs; ++e)
+        {
+            fits = e->first;
+            busy -= e->second;
+        }
+
+        if(first != head)
+        {
+            head = first;
+            reserved = fits;
+        }
+        else if(fits > reserved)
+            throw std::runtime_error("job " + to_string(first) + " was pushed back from tick " + to_string(reserved) + " to " + to_string(fits));
+    }
+};
+
+// A small case with a known answer:  with job 1 running on 6 of 8 processors until tick 10,
+//   job 2 (all 8) has to wait for it.  Job 3 would hold 2 processors past tick 10 and delay job 2,
+//   so it waits too.  Job 4 is done by tick 10, so it backfills.
+void testBackfill()
+{
+    BasicScheduler<EasyBackfill> s(8);
+    s.addJob(JobInfo{"wide", 6, 10});
+    s.tick();
+    s.addJob(JobInfo{"all", 8, 5});
+    s.addJob(JobInfo{"long", 2, 20});
+    s.addJob(JobInfo{"short", 2, 5});
+    s.tick();
+
+    if(s.getJobState(2) != JobState::Waiting || s.getJobState(3) != JobState::Waiting || s.getJobState(4) != JobState::Active)
+        throw std::runtime_error("wrong jobs backfilled\n" + dumpState(s));
+
+    s.advance(9);
+    if(s.getJobState(2) != JobState::Active)
+        throw std::runtime_error("the reserved job didn't start on time\n" + dumpState(s));
+}
+
+// The sketch's quantiles are within its accuracy of the exact ones, and merging two sketches
+//   gives the same answers as one sketch that saw everything.
+void testQuantileSketch(unsigned seed)
+{
+    srand(seed);
+
+    QuantileSketch all, first, second;
+    std::vector<double> values;
+    for(int i = 0; i < 20000; ++i)
+    {
+        double v = (rand() % 10) ? rand() % 1000 + 1 : (rand() % 1000 + 1) * 1000.0;      // a long tail
+        values.push_back(v);
+        all.add(v);
+        (i % 3 ? first : second).add(v);
+    }
+    first.merge(second);
+    std::sort(values.begin(), values.end());
+
+    for(double q : { 0.01, 0.25, 0.5, 0.9, 0.95, 0.99, 0.999 })
+    {
+        double exact = values[static_cast<std::size_t>(q * (values.size() - 1))];
+        double estimate = all.quantile(q);
+        if(estimate < exact * 0.99 || estimate > exact * 1.01)
+            throw std::runtime_error("p" + to_string(q * 100) + " is " + to_string(estimate) + ", not " + to_string(exact));
+        if(first.quantile(q) != estimate)
+            throw std::runtime_error("a merged sketch disagrees with the whole one at p" + to_string(q * 100));
+    }
+    if(all.count() != values.size() || first.count() != values.size() || all.min() != values.front() || all.max() != values.back())
+        throw std::runtime_error("wrong count, min or max");
+}
+
+// A small case with a known answer:  job 1 (all 4 processors, 20 ticks) starts at tick 0 and is
+//   bumped at tick 1 for job 2 (5 ticks).  Job 2 never waits, and completes at tick 6.  Job 1
+//   starts again then, and completes at tick 25:  5 ticks late, after 1 bump.  All 4 processors
+//   are busy for all 25 ticks, and then idle for the 25 after that.
+void testMetrics()
+{
+    BasicScheduler<ShortestJobFirst> s(4);
+    std::vector<JobMetrics> done;
+    s.setCompletionHandler([&done](const JobMetrics& m) { done.push_back(m); });
+
+    s.addJob(JobInfo{"long", 4, 20});
+    s.tick();
+    s.addJob(JobInfo{"short", 4, 5});
+    s.tick();
+
+    JobMetrics m;
+    if(!s.getJobMetrics(1, m) || m.submitTick != 0 || m.startTick != 0 || m.endTick != NoTick || m.bumps != 1)
+        throw std::runtime_error("wrong metrics for the bumped job\n" + dumpState(s));
+    if(!s.getJobMetrics(2, m) || m.submitTick != 1 || m.startTick != 1 || m.bumps != 0)
+        throw std::runtime_error("wrong metrics for the running job\n" + dumpState(s));
+
+    s.drain();
+    s.advance(25);
+    if(done.size() != 2 || done[0].id != 2 || done[0].endTick != 6 || done[1].id != 1 || done[1].endTick != 25
+       || done[1].startTick != 0 || done[1].bumps != 1 || s.getJobMetrics(1, m))
+        throw std::runtime_error("wrong completions");
+
+    SchedulerMetrics all = s.getMetrics();
+    if(all.jobsCompleted != 2 || all.bumps != 1 || all.wait.max != 5 || all.wait.mean != 2.5
+       || all.slowdown.max != 1.25 || all.slowdown.mean != (1 + 1.25) / 2 || all.utilization.mean != 0.5)
+        throw std::runtime_error("wrong totals");
+
+    s.resetMetrics();
+    if(s.getMetrics().jobsCompleted != 0 || s.getMetrics().wait.count != 0)
+        throw std::runtime_error("resetMetrics didn't");
+}
+
+// A job that finishes early frees its processors for the next schedule, and counts only the
+//   ticks it really ran
+void testFinishJob()
+{
+    BasicScheduler<FirstComeFirstServed> s(4);
+    std::vector<JobMetrics> done;
+    s.setCompletionHandler([&done](const JobMetrics& m) { done.push_back(m); });
+
+    s.addJob(JobInfo{"long", 4, 100});
+    s.addJob(JobInfo{"next", 4, 10});
+    s.advance(3);
+    if(s.finishJob(2) || s.finishJob(99) || !s.finishJob(1) || s.finishJob(1))
+        throw std::runtime_error("finishJob finished the wrong jobs");
+
+    s.schedule();
+    if(s.getJobState(2) != JobState::Active || s.now() != 3)
+        throw std::runtime_error("the next job didn't start at once\n" + dumpState(s));
+    if(done.size() != 1 || done[0].endTick != 3 || done[0].ticksRun != 3 || s.getMetrics().wait.max != 0)
+        throw std::runtime_error("the finished job's metrics are wrong");
+
+    s.drain();
+    if(s.now() != 13 || s.getMetrics().wait.max != 3)
+        throw std::runtime_error("the next job ran at the wrong time");
+}
+
+// Every waiting job's position, and the jobs ahead of it that fit in a random number of
+//   processors, agree with a walk of the queue
+template <typename Sched>
+void testQueuePosition(unsigned seed)
+{
+    srand(seed);
+    Sched s(numprocs);
+    for(int step = 0; step < numsteps; ++step)
+    {
+        if(rand() % 3)
+            s.addJob(JobInfo{"job", unsigned(rand() % numprocs + 1), unsigned(rand() % 50 + 1)});
+        else
+            s.advance(rand() % 10);
+
+        unsigned maxProcs = rand() % numprocs + 1;
+        std::size_t fitting = 0;
+        for(std::size_t k = 0; k < s.numWaiting(); ++k)
+        {
+            const ScheduledJob* job = s.waitingJobAt(k);
+            std::size_t pos = 0, ahead = 0;
+            if(!job || !s.queuePosition(job->id, pos) || pos != k || !s.jobsAhead(job->id, maxProcs, ahead) || ahead != fitting)
+                throw std::runtime_error("job " + to_string(job ? job->id : NoJob) + " is in the wrong place\n" + dumpState(s));
+            if(job->numProcs <= maxProcs)
+                ++fitting;
+        }
+
+        if(s.waitingJobAt(s.numWaiting()))
+            throw std::runtime_error("found a job past the end of the queue");
+        std::size_t pos;
+        for(jobid_t id = 1; id <= numsteps; ++id)      // (some of these IDs haven't been handed out yet)
+        {
+            if(s.getJobState(id) != JobState::Waiting && (s.queuePosition(id, pos) || s.jobsAhead(id, numprocs, pos)))
+                throw std::runtime_error("job " + to_string(id) + " isn't waiting, but has a place in the queue");
+        }
+    }
+}
+
+// Everything but the means, which are sums of doubles that can round differently
+bool sameSummary(const MetricSummary& a, const MetricSummary& b)
+{
+    return a.count == b.count && a.p50 == b.p50 && a.p95 == b.p95 && a.p99 == b.p99 && a.max == b.max
+           && std::abs(a.mean - b.mean) <= 1e-9 * std::max(1.0, std::abs(a.mean));
+}
+
+bool sameMetrics(const SchedulerMetrics& a, const SchedulerMetrics& b)
+{
+    return a.jobsCompleted == b.jobsCompleted && a.bumps == b.bumps && sameSummary(a.wait, b.wait)
+           && sameSummary(a.slowdown, b.slowdown) && sameSummary(a.utilization, b.utilization);
+}
+
+// The scheduler as it was before advance():  on every tick, every running job counts down by one
+//   and completes when it gets to 0, and the wait queue is a sorted vector walked one job at a
+//   time.  It shares the policies, the processor allocator and the string table with
+//   BasicScheduler, but none of its queues, its completion index or its tick skipping, so it
+//   shows what ticking one at a time really gives.
+template <typename Policy>
+class ReferenceScheduler
+{
+public:
+    struct Completed
+    {
+        jobid_t     id;
+        tick_t      tick;
+
+        bool operator == (const Completed& rhs) const   { return id == rhs.id && tick == rhs.tick;     }
+    };
+    std::vector<Completed>      completed;      // every job that has completed, in order
+
+    explicit ReferenceScheduler(unsigned numprocs) : procs(numprocs), scratch(numprocs) {}
+
+    bool addJob(const JobInfo& info)
+    {
+        if(!info.numTicks || !info.numProcs || info.numProcs > procs.size())
+            return false;
+
+        ScheduledJob job;
+        job.id = ++lastId;
+        job.description = descriptions.intern(info.description);
+        job.numProcs = info.numProcs;
+        job.numTicks = info.numTicks;
+        job.ticksRemaining = info.numTicks;
+        job.bumps = 0;
+        job.submitTick = clock;
+        job.startTick = NoTick;
+        enqueue( std::move(job) );
+        needAssign = true;
+        return true;
+    }
+
+    void tick()
+    {
+        if(needAssign)
+            assignProcs();
+
+        ++clock;
+        for(auto i = active.begin(); i != active.end(); )
+        {
+            if(--i->ticksRemaining == 0)        // this job is complete!
+            {
+                completed.push_back(Completed{i->id, clock});
+                freeProcs(*i);
+                if(descriptions.release(i->description))
+                    policy.forget(i->description);
+                i = active.erase(i);
+            }
+            else
+                ++i;
+        }
+
+        if(needAssign)
+            assignProcs();
+    }
+
+    // Same text as BasicScheduler::printActiveJobs followed by printWaitQueue
+    string dump() const
+    {
+        ostringstream s;
+        {
+            char buf[4096];
+            DumpWriter out(buf, sizeof(buf), s);
+            out.write("Active Jobs:\n");
+            out.write("Job Id  | Job Description         | Ticks Left |  Procs Used\n");
+            out.write("----------------------------------------------------------------\n");
+            if(active.empty())
+                out.write("(No Active Jobs)\n");
+            for(auto& job : active)
+                dumpJob(out, job, true);
+
+            out.write("Wait Queue (top is next in queue):\n");
+            out.write("Job Id  | Job Description         | Ticks Left |  Num Procs Needed\n");
+            out.write("----------------------------------------------------------------\n");
+            if(waiting.empty())
+                out.write("(Wait Queue is empty)\n");
+            for(auto& job : waiting)
+                dumpJob(out, job, false);
+        }
+        return s.str();
+    }
+
+private:
+    ProcAllocator               procs;
+    std::vector<procid_t>       scratch;
+    StringTable                 descriptions;
+    Policy                      policy;
+    std::vector<ScheduledJob>   waiting;        // in queue order
+    std::list<ScheduledJob>     active;         // in the order they started
+    jobid_t                     lastId = 0;
+    tick_t                      clock = 0;
+    bool                        needAssign = false;
+
+    void enqueue(ScheduledJob&& job)
+    {
+        job.rank = policy.rank(job);
+        auto pos = std::upper_bound(waiting.begin(), waiting.end(), job);
+        waiting.insert(pos, std::move(job));
+    }
+
+    void freeProcs(ScheduledJob& job)
+    {
+        job.procsUsed.copyTo(scratch.data());
+        procs.release(scratch.data(), job.numProcs);
+        job.procsUsed.clear();
+        needAssign = true;
+    }
+
+    void start(std::size_t k)
+    {
+        ScheduledJob& job = waiting[k];
+        if(!procs.allocate(job.numProcs, scratch.data()))
+            throw std::runtime_error("reference scheduler started a job that doesn't fit");
+        job.procsUsed.assign(scratch.data(), job.numProcs);
+        policy.started(job);
+        if(job.startTick == NoTick)
+            job.startTick = clock;
+        active.push_back( std::move(job) );
+        waiting.erase(waiting.begin() + k);
+    }
+
+    void assignProcs()
+    {
+        if(waiting.empty())
+            return;
+
+        // bump every running job that would finish after the head of the queue, if that makes room for it
+        unsigned needProcs = waiting.front().numProcs;
+        unsigned needTicks = waiting.front().ticksRemaining;
+        if(Policy::bump == BumpRule::Longer && procs.numFree() < needProcs)
+        {
+            std::vector<typename std::list<ScheduledJob>::iterator> longer;
+            unsigned room = procs.numFree();
+            for(auto i = active.begin(); i != active.end(); ++i)
+            {
+                if(i->ticksRemaining > needTicks)
+                {
+                    longer.push_back(i);
+                    room += i->numProcs;
+                }
+            }
+            std::stable_sort(longer.begin(), longer.end(),
+                             [](typename std::list<ScheduledJob>::iterator a, typename std::list<ScheduledJob>::iterator b)
+                             { return a->ticksRemaining < b->ticksRemaining; });
+
+            if(!longer.empty() && room >= needProcs)
+            {
+                for(auto i : longer)
+                {
+                    freeProcs(*i);
+                    ++i->bumps;
+                    enqueue( std::move(*i) );
+                    active.erase(i);
+                }
+            }
+        }
+
+        std::size_t k = 0;
+        while(!procs.empty() && k < waiting.size())
+        {
+            if(waiting[k].numProcs <= procs.numFree())
+                start(k);
+            else if(Policy::fill == FillRule::FirstFit)
+                ++k;
+            else
+            {
+                if(Policy::fill == FillRule::Backfill)
+                    backfill(k);
+                break;
+            }
+        }
+        needAssign = false;
+    }
+
+    // The job at 'head' doesn't fit.  Find the tick enough running jobs will have finished for it
+    //   (running jobs finish in order of ticks left, then in the order they started), and start
+    //   later jobs that are done by then or fit in what it won't need.
+    void backfill(std::size_t head)
+    {
+        std::vector<const ScheduledJob*> ends;
+        for(auto& job : active)
+            ends.push_back(&job);
+        std::stable_sort(ends.begin(), ends.end(), [](const ScheduledJob* a, const ScheduledJob* b) { return a->ticksRemaining < b->ticksRemaining; });
+
+        unsigned need = waiting[head].numProcs - procs.numFree();
+        unsigned freed = 0;
+        unsigned shadow = 0;            // ticks from now
+        for(auto job : ends)
+        {
+            if(freed >= need && job->ticksRemaining > shadow)
+                break;
+            freed += job->numProcs;
+            shadow = job->ticksRemaining;
+        }
+        if(freed < need)
+            throw std::runtime_error("reference scheduler can't find room for the head of the queue");
+        unsigned extra = procs.numFree() + freed - waiting[head].numProcs;
+
+        for(std::size_t k = head + 1; !procs.empty() && k < waiting.size(); )
+        {
+            const ScheduledJob& job = waiting[k];
+            if(job.numProcs > procs.numFree() || (job.ticksRemaining > shadow && job.numProcs > extra))
+            {
+                ++k;
+                continue;
+            }
+            if(job.ticksRemaining > shadow)
+                extra -= job.numProcs;
+            start(k);
+        }
+    }
+
+    void dumpJob(DumpWriter& out, const ScheduledJob& job, bool running) const
+    {
+        const auto& desc = descriptions.get(job.description);
+        out.pad(8, out.writeUInt(job.id));                              out.write("| ");
+        out.pad(24, out.writeText(desc.data(), desc.size()));          out.write("| ");
+        out.pad(11, out.writeUInt(job.ticksRemaining));                 out.write("| ");
+        if(running)
+        {
+            for(unsigned i = 0; i < job.numProcs; ++i)
+            {
+                if(i)       out.write(", ");
+                out.writeUInt(job.procsUsed[i]);
+            }
+        }
+        else
+            out.writeUInt(job.numProcs);
+        out.put('\n');
+    }
+};
+
+// Runs the same random workload through a ReferenceScheduler and two real ones:  one stepped
+//   with tick(), and one with advance().  All three have to be in the same state after every
+//   step, and complete the same jobs on the same ticks.
+template <typename Sched>
+void testAdvance(unsigned seed)
+{
+    srand(seed);
+
+    ReferenceScheduler<typename Sched::policy_type> reference(numprocs);
+    Sched stepped(numprocs);
+    Sched skipped(numprocs);
+    std::vector<typename ReferenceScheduler<typename Sched::policy_type>::Completed> completed;
+    skipped.setCompletionHandler([&completed](const JobMetrics& m) { completed.push_back({m.id, m.endTick}); });
+    jobid_t lastId = 0;
+    PolicyCheck<Sched> checkPolicy;
+
+    for(int step = 0; step < numsteps; ++step)
+    {
+        if(rand() % 3)
+        {
+            JobInfo info;
+            info.description = (step % 2) ? "job" + to_string(step) : "account" + to_string(rand() % 3);     // some shared descriptions, for FairShare
+            info.numProcs = rand() % numprocs + 1;
+            info.numTicks = (rand() % 4) ? (rand() % 10 + 1) : (rand() % 500 + 1);
+
+            bool added = reference.addJob(info);
+            if(added != stepped.addJob(info) || added != skipped.addJob(info))
+                throw std::runtime_error("addJob result mismatch");
+            lastId += added ? 1 : 0;
+        }
+        else
+        {
+            int ticks = rand() % 100;
+            for(int i = 0; i < ticks; ++i)
+            {
+                reference.tick();
+                stepped.tick();
+            }
+            skipped.advance(ticks);
+
+            string expect = reference.dump();
+            if(dumpState(stepped) != expect || dumpState(skipped) != expect)
+                throw std::runtime_error("State mismatch after " + to_string(ticks) + " ticks at step " + to_string(step));
+            if(completed != reference.completed)
+                throw std::runtime_error("Completions differ after " + to_string(ticks) + " ticks at step " + to_string(step));
+            if(!sameMetrics(stepped.getMetrics(), skipped.getMetrics()))
+                throw std::runtime_error("Metrics mismatch after " + to_string(ticks) + " ticks at step " + to_string(step));
+            checkPolicy(skipped, lastId);
+        }
+    }
+}
+
+// Cancels and updates random jobs, waiting or running, in a random workload run through two
+//   schedulers (one ticked, one advanced).  They have to stay identical, cancelled jobs must
+//   never complete, and updated ones complete having run exactly their new ticks.
+template <typename Sched>
+void testCancelUpdate(unsigned seed)
+{
+    srand(seed);
+
+    Sched stepped(numprocs);
+    Sched skipped(numprocs);
+    std::vector<JobMetrics> done;
+    skipped.setCompletionHandler([&done](const JobMetrics& m) { done.push_back(m); });
+
+    std::vector<unsigned> ticks(1);         // per job ID:  the ticks it should complete with (0 if cancelled)
+    std::size_t cancelled = 0;
+    for(int step = 0; step < numsteps; ++step)
+    {
+        int op = rand() % 6;
+        jobid_t id = rand() % ticks.size() + 1;         // sometimes one that hasn't been handed out
+        JobState before = skipped.getJobState(id);
+        if(op < 3)
+        {
+            JobInfo info{"job" + to_string(step % 5), unsigned(rand() % numprocs + 1), unsigned(rand() % 50 + 1)};
+            if(!stepped.addJob(info) || !skipped.addJob(info))
+                throw std::runtime_error("a valid job was rejected");
+            ticks.push_back(info.numTicks);
+        }
+        else if(op == 3)
+        {
+            bool ok = stepped.cancelJob(id);
+            if(ok != skipped.cancelJob(id) || ok != (before != JobState::Unknown))
+                throw std::runtime_error("cancelJob(" + to_string(id) + ") gave the wrong answer");
+            if(ok)
+            {
+                ticks[id] = 0;
+                ++cancelled;
+            }
+            if(skipped.getJobState(id) != JobState::Unknown || skipped.findJob(id))
+                throw std::runtime_error("job " + to_string(id) + " is still there after being cancelled");
+        }
+        else if(op == 4)
+        {
+            unsigned newTicks = rand() % 60 + 1;
+            unsigned newProcs = rand() % (numprocs + 2);
+            JobMetrics m;
+            bool expect = skipped.getJobMetrics(id, m) && newProcs >= 1 && newProcs <= numprocs && newTicks > m.ticksRun
+                          && (before == JobState::Waiting || newProcs == m.numProcs);
+
+            bool ok = stepped.updateJob(id, newTicks, newProcs);
+            if(ok != skipped.updateJob(id, newTicks, newProcs) || ok != expect)
+                throw std::runtime_error("updateJob(" + to_string(id) + ") gave the wrong answer");
+            if(ok)
+            {
+                ticks[id] = newTicks;
+                auto job = skipped.findJob(id);
+                if(!job || job->numTicks != newTicks || job->numProcs != newProcs || skipped.getJobState(id) != before)
+                    throw std::runtime_error("job " + to_string(id) + " didn't take its update");
+            }
+        }
+        else
+        {
+            int n = rand() % 20;
+            for(int i = 0; i < n; ++i)
+                stepped.tick();
+            skipped.advance(n);
+        }
+
+        if(dumpState(stepped) != dumpState(skipped))
+            throw std::runtime_error("State mismatch at step " + to_string(step) + "\n" + dumpState(skipped));
+    }
+
+    skipped.drain();
+    if(done.size() != ticks.size() - 1 - cancelled)
+        throw std::runtime_error("wrong number of jobs completed");
+    for(auto& m : done)
+    {
+        if(!ticks[m.id])
+            throw std::runtime_error("cancelled job " + to_string(m.id) + " completed");
+        if(m.numTicks != ticks[m.id] || m.ticksRun != ticks[m.id])
+            throw std::runtime_error("job " + to_string(m.id) + " ran for the wrong number of ticks");
+    }
+}
+
+// Cancels half of a big queue.  The jobs that are left keep their place in memory (so nothing
+//   looked at them), stay in order, and all run to completion.
+void testMassCancel()
+{
+    const std::size_t count = 100000;
+    Scheduler s(numprocs);
+    std::vector<JobInfo> jobs;
+    for(std::size_t i = 0; i < count; ++i)
+        jobs.push_back(JobInfo{"job", unsigned(rand() % numprocs + 1), unsigned(rand() % 50 + 1)});
+    s.addJobs(jobs.data(), jobs.size());
+    s.tick();
+
+    std::vector<const ScheduledJob*> where(count + 1);
+    for(jobid_t id = 1; id <= count; ++id)
+        where[id] = s.findJob(id);
+
+    std::vector<char> cancelled(count + 1, 0);
+    std::size_t left = s.numWaiting() + s.numActive();     // (some finished on the first tick)
+    for(jobid_t id = 1; id <= count; ++id)
+    {
+        if(rand() % 2 && s.cancelJob(id))
+        {
+            cancelled[id] = 1;
+            --left;
+        }
+    }
+
+    if(s.numWaiting() + s.numActive() != left)
+        throw std::runtime_error("wrong number of jobs left after cancelling");
+    for(jobid_t id = 1; id <= count; ++id)
+    {
+        if(cancelled[id] ? s.findJob(id) != nullptr : s.findJob(id) != where[id])
+            throw std::runtime_error("job " + to_string(id) + " was disturbed by cancelling other jobs");
+    }
+    const ScheduledJob* prev = nullptr;
+    for(std::size_t k = 0; k < s.numWaiting(); ++k)
+    {
+        const ScheduledJob* job = s.waitingJobAt(k);
+        if(prev && job->key() < prev->key())
+            throw std::runtime_error("the queue is out of order after cancelling");
+        prev = job;
+    }
+
+    std::size_t completed = 0;
+    s.setCompletionHandler([&completed](const JobMetrics&) { ++completed; });
+    s.drain();
+    if(completed != left)
+        throw std::runtime_error("not every job left completed");
+}
+
+// Runs a random workload, checkpoints it partway through and restores that into a new
+//   scheduler.  From there on both get the same workload, and have to stay identical.
+template <typename Sched>
+void testCheckpoint(unsigned seed)
+{
+    srand(seed);
+
+    Sched original(numprocs, 4);
+    std::unique_ptr<Sched> restored;
+    int saveAt = rand() % numsteps;
+    std::vector<JobMetrics> fromOriginal, fromRestored;    // jobs completed after the checkpoint
+
+    for(int step = 0; step < numsteps; ++step)
+    {
+        if(step == saveAt)
+        {
+            original.saveCheckpoint(checkpointFile);
+            restored.reset( new Sched(numprocs, 4) );
+            restored->loadCheckpoint(checkpointFile);
+            std::remove(checkpointFile);
+            original.setCompletionHandler([&](const JobMetrics& m) { fromOriginal.push_back(m); });
+            restored->setCompletionHandler([&](const JobMetrics& m) { fromRestored.push_back(m); });
+
+            if(dumpState(*restored) != dumpState(original) || restored->now() != original.now())
+                throw std::runtime_error("State mismatch right after restoring at step " + to_string(step));
+        }
+
+        if(rand() % 3)
+        {
+            JobInfo info;
+            info.description = (step % 2) ? "job" + to_string(step) : "account" + to_string(rand() % 3);
+            info.numProcs = rand() % numprocs + 1;
+            info.numTicks = (rand() % 4) ? (rand() % 10 + 1) : (rand() % 500 + 1);
+
+            bool added = original.addJob(info);
+            if(restored && restored->addJob(info) != added)
+                throw std::runtime_error("addJob result mismatch");
+        }
+        else
+        {
+            int ticks = rand() % 100;
+            original.advance(ticks);
+            if(restored)
+            {
+                restored->advance(ticks);
+                if(dumpState(*restored) != dumpState(original))
+                    throw std::runtime_error("State mismatch after " + to_string(ticks) + " ticks at step " + to_string(step));
+            }
+        }
+    }
+
+    original.drain();
+    restored->drain();
+    if(restored->now() != original.now())
+        throw std::runtime_error("drain finished at different ticks");
+    if(fromRestored.size() != fromOriginal.size()
+       || !std::equal(fromOriginal.begin(), fromOriginal.end(), fromRestored.begin(), [](const JobMetrics& a, const JobMetrics& b)
+          {
+              return a.id == b.id && a.submitTick == b.submitTick && a.startTick == b.startTick && a.endTick == b.endTick && a.bumps == b.bumps;
+          }))
+        throw std::runtime_error("jobs completed with different metrics after restoring");
+}
+
+// Damaged, truncated and mismatched checkpoints are turned down, and leave the scheduler usable
+void testBadCheckpoints()
+{
+    Scheduler s(numprocs);
+    for(int i = 0; i < 50; ++i)
+        s.addJob(JobInfo{"job" + to_string(i % 7), unsigned(i % numprocs + 1), unsigned(i * 3 + 1)});
+    s.advance(5);
+    s.saveCheckpoint(checkpointFile);
+
+    std::string good;
+    {
+        FILE* f = fopen(checkpointFile, "rb");
+        char buf[4096];
+        std::size_t n;
+        while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            good.append(buf, n);
+        fclose(f);
+    }
+    auto writeFile = [](const std::string& data)
+    {
+        FILE* f = fopen(checkpointFile, "wb");
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+    };
+    auto expectFailure = [](const char* what, std::function<void()> load)
+    {
+        bool threw = false;
+        try                         { load();       }
+        catch(SchedulerException&)  { threw = true; }
+        if(!threw)
+            throw std::runtime_error(std::string("loaded a checkpoint that was ") + what);
+    };
+
+    std::string bad = good;
+    bad[bad.size() / 2] ^= 0x10;
+    writeFile(bad);
+    expectFailure("corrupt", [] { Scheduler t(numprocs); t.loadCheckpoint(checkpointFile); });
+
+    writeFile(good.substr(0, good.size() - 8));
+    expectFailure("truncated", [] { Scheduler t(numprocs); t.loadCheckpoint(checkpointFile); });
+
+    writeFile(good);
+    expectFailure("from another policy", [] { BasicScheduler<FirstComeFirstServed> t(numprocs); t.loadCheckpoint(checkpointFile); });
+    expectFailure("for other processors", [] { Scheduler t(numprocs * 2); t.loadCheckpoint(checkpointFile); });
+    expectFailure("loaded into a used scheduler", [&s] { s.loadCheckpoint(checkpointFile); });
+
+    Scheduler t(numprocs);
+    t.loadCheckpoint(checkpointFile);
+    std::remove(checkpointFile);
+    if(dumpState(t) != dumpState(s))
+        throw std::runtime_error("the good checkpoint didn't restore");
+}
+
+// Runs a random workload with an event log, and checks the log tells the story of every job:
+//   submitted once, then admitted, bumped and admitted again any number of times, then completed,
+//   with the clock never going backwards.  Returns the events, to compare between compressions.
+std::vector<EventRecord> runEventLog(unsigned seed, EventCompression compression)
+{
+    srand(seed);
+
+    EventLogOptions opts;
+    opts.capacity = 64;         // small, so the writer has to keep up
+    opts.batch = 16;
+    opts.overflow = EventOverflow::Block;
+    opts.compression = compression;
+
+    Scheduler s(numprocs);
+    s.openEventLog(eventLogFile, opts);
+    std::uint64_t rejected = 0;
+    for(int step = 0; step < numsteps; ++step)
+    {
+        int op = rand() % 8;
+        if(op < 5)
+        {
+            JobInfo info{"job", unsigned(rand() % (numprocs + 2)), unsigned(rand() % 50)};
+            rejected += s.addJob(info) ? 0 : 1;
+        }
+        else if(op == 5)
+            s.cancelJob(rand() % (step + 1) + 1);
+        else if(op == 6)
+            s.updateJob(rand() % (step + 1) + 1, unsigned(rand() % 50 + 1), unsigned(rand() % numprocs + 1));
+        else
+            s.advance(rand() % 100);
+    }
+    s.drain();
+    EventLogStats stats = s.closeEventLog();
+
+    std::vector<EventRecord> events;
+    EventLogReader log(eventLogFile);
+    EventRecord e;
+    while(log.next(e))
+        events.push_back(e);
+    std::remove(eventLogFile);
+
+    if(stats.dropped || stats.recorded != events.size() || stats.written != events.size())
+        throw std::runtime_error("event counts don't add up");
+
+    std::vector<int> state;     // per job:  0 never seen, 1 waiting, 2 running, 3 completed or cancelled
+    std::uint64_t rejects = 0;
+    tick_t last = 0;
+    for(auto& ev : events)
+    {
+        if(ev.tick < last)
+            throw std::runtime_error("event ticks went backwards");
+        last = ev.tick;
+
+        auto kind = static_cast<EventKind>(ev.kind);
+        if(kind == EventKind::Reject)
+        {
+            ++rejects;
+            continue;
+        }
+        if(ev.job >= state.size())
+            state.resize(ev.job + 1, 0);
+        int& st = state[ev.job];
+        switch(kind)
+        {
+        case EventKind::Submit:     if(st != 0)     throw std::runtime_error("job submitted twice");        st = 1;     break;
+        case EventKind::Admit:      if(st != 1)     throw std::runtime_error("job admitted while not waiting"); st = 2; break;
+        case EventKind::Bump:       if(st != 2)     throw std::runtime_error("job bumped while not running");   st = 1; break;
+        case EventKind::Complete:   if(st != 2)     throw std::runtime_error("job completed while not running"); st = 3; break;
+        case EventKind::Cancel:     if(st != 1 && st != 2)  throw std::runtime_error("job cancelled while not there");   st = 3; break;
+        case EventKind::Update:     if(st != 1 && st != 2)  throw std::runtime_error("job updated while not there");     break;
+        default:                    throw std::runtime_error("unexpected event kind");
+        }
+        if(kind == EventKind::Admit && ev.firstProc >= numprocs)
+            throw std::runtime_error("admitted on a processor that doesn't exist");
+    }
+    if(rejects != rejected)
+        throw std::runtime_error("rejections weren't all logged");
+    for(std::size_t id = 1; id < state.size(); ++id)
+    {
+        if(state[id] != 3)
+            throw std::runtime_error("job " + to_string(id) + " never completed in the log");
+    }
+    return events;
+}
+
+// Both compressions log the same thing, and a ring that overflows in Drop mode counts every event
+//   it loses
+void testEventLog(unsigned seed)
+{
+    auto raw = runEventLog(seed, EventCompression::None);
+    auto delta = runEventLog(seed, EventCompression::Delta);
+    if(raw.size() != delta.size() || !std::equal(raw.begin(), raw.end(), delta.begin(),
+                                                  [](const EventRecord& a, const EventRecord& b) { return !std::memcmp(&a, &b, sizeof(a)); }))
+        throw std::runtime_error("the raw and delta compressed logs differ");
+
+    EventLogOptions opts;
+    opts.capacity = 2;
+    opts.batch = 1;
+    EventLog log(eventLogFile, opts);
+    EventRecord e{0, 1, static_cast<std::uint32_t>(EventKind::Submit), 1, 1, NoEventProc};
+    const std::uint64_t total = 100000;
+    for(std::uint64_t i = 0; i < total; ++i)
+        log.record(e);
+    log.close();
+    EventLogStats stats = log.stats();
+
+    std::uint64_t decoded = 0;
+    EventLogReader reader(eventLogFile);
+    while(reader.next(e))
+        ++decoded;
+    std::remove(eventLogFile);
+    if(stats.recorded + stats.dropped != total || stats.written != stats.recorded || decoded != stats.written)
+        throw std::runtime_error("dropped events weren't counted right");
+}
+
+template <typename Policy>
+bool runTests(const std::vector<unsigned>& seeds)
+{
+    for(auto& seed : seeds)
+    {
+        cout << "Beginning " << setw(9) << Policy::name() << " advance test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+        try
+        {
+            testAdvance<BasicScheduler<Policy>>(seed);
+            testCheckpoint<BasicScheduler<Policy>>(seed);
+            testCancelUpdate<BasicScheduler<Policy>>(seed);
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED: " << e.what() << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    srand((unsigned)time(nullptr));
+
+    std::vector<unsigned> seeds;
+    seeds.reserve(iterations);
+    for(int i = 0; i < iterations; ++i)
+        seeds.push_back( rand() );
+
+    if(!runTests<ShortestJobFirst>(seeds))          return 1;
+    if(!runTests<FirstComeFirstServed>(seeds))      return 1;
+    if(!runTests<FairShare>(seeds))                 return 1;
+    if(!runTests<EasyBackfill>(seeds))              return 1;
+
+    cout << "Beginning backfill test:  ";
+    try
+    {
+        testBackfill();
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Beginning queue position test:  ";
+    try
+    {
+        testQueuePosition<Scheduler>(seeds.front());
+        testQueuePosition<BasicScheduler<EasyBackfill>>(seeds.back());
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Beginning mass cancel test:  ";
+    try
+    {
+        testMassCancel();
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Beginning metrics test:  ";
+    try
+    {
+        testQuantileSketch(seeds.front());
+        testMetrics();
+        testFinishJob();
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Beginning event log test:  ";
+    try
+    {
+        testEventLog(seeds.front());
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Beginning checkpoint test:  ";
+    try
+    {
+        testBadCheckpoints();
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
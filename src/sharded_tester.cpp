@@ -0,0 +1,274 @@
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include "shardedscheduler.h"
+
+using namespace std;
+
+//  Tests for ShardedScheduler and the WorkStealingPool under it.  Build with 'make TSAN=1' to
+//  run them under ThreadSanitizer.
+
+static const int iterations = 10;       // number of tests to perform
+static const int numsteps = 300;        // number of submissions/advances in each test
+static const std::vector<unsigned> partitions = { 4, 8, 8, 16 };
+
+// Every task of every batch runs exactly once, and an exception gets back to the caller
+void testPool(unsigned threads)
+{
+    WorkStealingPool pool(threads);
+    for(int round = 0; round < 200; ++round)
+    {
+        std::size_t count = rand() % 300;
+        std::vector<std::atomic<int>> runs(count);
+        for(auto& r : runs)
+            r = 0;
+        pool.run(count, [&](std::size_t i) { ++runs[i]; });
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(runs[i] != 1)
+                throw std::runtime_error("task " + to_string(i) + " ran " + to_string(runs[i]) + " times");
+        }
+    }
+
+    std::atomic<int> ran(0);
+    bool caught = false;
+    try
+    {
+        pool.run(100, [&](std::size_t i)
+        {
+            ++ran;
+            if(i == 7)
+                throw std::runtime_error("task failed");
+        });
+    }
+    catch(std::runtime_error&)
+    {
+        caught = true;
+    }
+    if(!caught || ran != 100)
+        throw std::runtime_error("a throwing task wasn't reported, or stopped the rest of the batch");
+}
+
+template <typename Sched>
+string dumpState(const Sched& s)
+{
+    ostringstream out;
+    for(unsigned i = 0; i < s.numPartitions(); ++i)
+    {
+        out << "Partition " << i << ":\n";
+        s.partition(i).printActiveJobs(out);
+        s.partition(i).printWaitQueue(out);
+    }
+    return out.str();
+}
+
+// partitionOf has to name the one partition that knows each job, and nothing once no partition does
+template <typename Sched>
+void checkOwners(const Sched& s, const std::vector<jobid_t>& ids)
+{
+    for(auto id : ids)
+    {
+        unsigned owner = Sched::NoPartition;
+        for(unsigned i = 0; i < s.numPartitions(); ++i)
+        {
+            if(s.partition(i).getJobState(id) != JobState::Unknown)
+                owner = i;
+        }
+        if(s.partitionOf(id) != owner)
+            throw std::runtime_error("job " + to_string(id) + " is in the wrong partition");
+        if(s.getJobState(id) != (owner == Sched::NoPartition ? JobState::Unknown : s.partition(owner).getJobState(id)))
+            throw std::runtime_error("job " + to_string(id) + " has the wrong state");
+    }
+}
+
+// Runs the same random workload through three sharded schedulers that only differ in how many
+//   threads they use, one of them stepped with tick().  They have to agree on every job ID and
+//   on the state of every partition after every step.
+template <typename Policy>
+void testDeterminism(unsigned seed, Routing routing, bool migration)
+{
+    srand(seed);
+
+    typedef BasicShardedScheduler<Policy> Sched;
+    Sched serial(partitions, routing, 1);
+    Sched parallel(partitions, routing, 4);
+    Sched stepped(partitions, routing, 3);
+    serial.setMigration(migration);
+    parallel.setMigration(migration);
+    stepped.setMigration(migration);
+
+    std::vector<jobid_t> ids;
+    for(int step = 0; step < numsteps; ++step)
+    {
+        if(rand() % 3)
+        {
+            JobInfo info;
+            info.description = "account" + to_string(rand() % 5);
+            info.numProcs = rand() % 17 + 1;        // 17 fits nowhere
+            info.numTicks = (rand() % 4) ? (rand() % 10 + 1) : (rand() % 500 + 1);
+
+            jobid_t id = serial.addJob(info);
+            if(parallel.addJob(info) != id || stepped.addJob(info) != id)
+                throw std::runtime_error("addJob result mismatch");
+            if((id == NoJob) != (info.numProcs > 16))
+                throw std::runtime_error("addJob accepted a job that can't run, or turned down one that can");
+            if(id != NoJob)
+                ids.push_back(id);
+        }
+        else if(rand() % 4 == 0 && !ids.empty())
+        {
+            jobid_t id = ids[rand() % ids.size()];
+            bool cancelled = serial.cancelJob(id);
+            if(parallel.cancelJob(id) != cancelled || stepped.cancelJob(id) != cancelled)
+                throw std::runtime_error("cancelJob result mismatch");
+            if(serial.cancelJob(id) || serial.getJobState(id) != JobState::Unknown)
+                throw std::runtime_error("job " + to_string(id) + " is still around after cancelJob");
+        }
+        else
+        {
+            int ticks = rand() % 100;
+            serial.advance(ticks);
+            parallel.advance(ticks);
+            for(int i = 0; i < ticks; ++i)
+                stepped.tick();
+
+            string expect = dumpState(serial);
+            if(dumpState(parallel) != expect || dumpState(stepped) != expect)
+                throw std::runtime_error("State mismatch after " + to_string(ticks) + " ticks at step " + to_string(step));
+            checkOwners(serial, ids);
+        }
+    }
+
+    if(serial.migrations() != parallel.migrations() || serial.migrations() != stepped.migrations())
+        throw std::runtime_error("migration counts differ");
+    if(!migration && serial.migrations())
+        throw std::runtime_error("jobs migrated with migration off");
+
+    serial.drain();
+    parallel.drain();
+    stepped.drain();
+    if(serial.now() != parallel.now() || serial.now() != stepped.now())
+        throw std::runtime_error("drain finished at different ticks");
+    for(auto id : ids)
+    {
+        if(serial.getJobState(id) != JobState::Unknown)
+            throw std::runtime_error("job " + to_string(id) + " is still around after drain");
+    }
+}
+
+// Two partitions, and hash routing sends every job to the same one.  Migration has to hand half
+//   of them to the idle partition, which halves the time to run them all.
+void testMigration()
+{
+    for(int on = 0; on < 2; ++on)
+    {
+        ShardedScheduler s({ 4, 4 }, Routing::Hash, 2);
+        s.setMigration(on != 0);
+
+        std::vector<jobid_t> ids;
+        for(int i = 0; i < 4; ++i)
+            ids.push_back( s.addJob(JobInfo{"same", 4, 10}) );
+        unsigned home = s.partitionOf(ids[0]);
+        for(auto id : ids)
+        {
+            if(s.partitionOf(id) != home)
+                throw std::runtime_error("hash routing split jobs with the same description");
+        }
+
+        // after the first tick, one job runs at home and (with migration) one in the other partition
+        s.tick();
+        unsigned moved = 0;
+        for(auto id : ids)
+            moved += (s.partitionOf(id) == 1 - home);
+        if(moved != (on ? 1u : 0u))
+            throw std::runtime_error("partitionOf doesn't follow migrated jobs");
+
+        s.drain();
+        tick_t expect = on ? 20 : 40;
+        if(s.now() != expect || s.migrations() != (on ? 2u : 0u))
+            throw std::runtime_error("with migration " + string(on ? "on" : "off") + ", drain took " + to_string(s.now())
+                                     + " ticks and moved " + to_string(s.migrations()) + " jobs");
+
+        // with migration, two jobs wait 10 ticks; without, they wait 10, 20 and 30
+        SchedulerMetrics m = s.getMetrics();
+        if(m.jobsCompleted != 4 || m.wait.mean != (on ? 5 : 15) || m.utilization.mean != (on ? 1 : 0.5))
+            throw std::runtime_error("with migration " + string(on ? "on" : "off") + ", the merged metrics are wrong");
+    }
+}
+
+template <typename Policy>
+bool runTests(const std::vector<unsigned>& seeds)
+{
+    const Routing routings[] = { Routing::LeastLoaded, Routing::Hash, Routing::SizeClass };
+    const char* routingNames[] = { "least", "hash", "size" };
+
+    for(auto& seed : seeds)
+    {
+        cout << "Beginning " << setw(9) << Policy::name() << " sharded test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+        int r = 0;
+        int migration = 0;
+        try
+        {
+            for(r = 0; r < 3; ++r)
+            {
+                for(migration = 0; migration < 2; ++migration)
+                    testDeterminism<Policy>(seed, routings[r], migration != 0);
+            }
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED (" << routingNames[r] << (migration ? ", migrating" : "") << "): " << e.what() << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    srand((unsigned)time(nullptr));
+
+    std::vector<unsigned> seeds;
+    seeds.reserve(iterations);
+    for(int i = 0; i < iterations; ++i)
+        seeds.push_back( rand() );
+
+    cout << "Beginning thread pool test:  ";
+    try
+    {
+        for(unsigned threads = 1; threads <= 8; threads *= 2)
+            testPool(threads);
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    if(!runTests<ShortestJobFirst>(seeds))          return 1;
+    if(!runTests<FirstComeFirstServed>(seeds))      return 1;
+    if(!runTests<FairShare>(seeds))                 return 1;
+    if(!runTests<EasyBackfill>(seeds))              return 1;
+
+    cout << "Beginning migration test:  ";
+    try
+    {
+        testMigration();
+        cout << "SUCCESS!" << endl;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
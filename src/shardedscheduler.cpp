@@ -0,0 +1,329 @@
+
+#include "shardedscheduler.h"
+#include <algorithm>
+
+namespace
+{
+    const std::size_t MinSweep = 64;        // don't bother sweeping the owner table below this
+}
+
+template <typename P>
+BasicShardedScheduler<P>::BasicShardedScheduler(const std::vector<unsigned>& partitions, Routing routing_,
+                                                 unsigned threads, unsigned groupsize)
+    : pool( threads )
+    , routing( routing_ )
+    , widest( 0 )
+    , migration( false )
+    , numMigrations( 0 )
+    , lastJobId( 0 )
+    , clock( 0 )
+    , sweepAt( MinSweep )
+{
+    if(partitions.empty())
+        throw SchedulerException("A sharded scheduler needs at least one partition");
+
+    for(auto procs : partitions)
+    {
+        if(procs == 0)
+            throw SchedulerException("A partition needs at least one processor");
+        parts.emplace_back( new partition_type(procs, groupsize) );
+        widest = std::max(widest, procs);
+    }
+    received.resize(parts.size());
+}
+
+template <typename P>
+jobid_t BasicShardedScheduler<P>::addJob(const JobInfo& jobinfo)
+{
+    if(jobinfo.numTicks == 0)
+        return NoJob;
+    unsigned p = route(jobinfo);
+    if(p == NoPartition)
+        return NoJob;
+
+    PortableJob job;
+    job.id = getUniqueJobId();
+    job.info = jobinfo;
+    job.ticksRemaining = jobinfo.numTicks;
+    job.bumps = 0;
+    job.submitTick = clock;
+    job.startTick = NoTick;
+    if(!parts[p]->adoptJob(job))
+        throw SchedulerException("Internal Error:  a partition turned down the job routed to it");
+    setOwner(job.id, p);
+    return job.id;
+}
+
+template <typename P>
+jobid_t BasicShardedScheduler<P>::getUniqueJobId()
+{
+    // the partitions never pick IDs themselves, so only this has to skip IDs still in use
+    jobid_t id;
+    do
+    {
+        id = ++lastJobId;
+    }while( id == NoJob || partitionOf(id) != NoPartition );
+
+    return id;
+}
+
+template <typename P>
+unsigned BasicShardedScheduler<P>::route(const JobInfo& jobinfo) const
+{
+    unsigned n = numPartitions();
+    if(jobinfo.numProcs == 0 || jobinfo.numProcs > widest)
+        return NoPartition;
+
+    switch(routing)
+    {
+    case Routing::Hash:
+        return fitFrom(StringTable::hashOf(jobinfo.description) % n, jobinfo.numProcs);
+
+    case Routing::SizeClass:
+        return fitFrom(static_cast<unsigned>((std::uint64_t(jobinfo.numProcs) - 1) * n / widest), jobinfo.numProcs);
+
+    case Routing::LeastLoaded:
+    default:
+        {
+            // compare jobs/procs as a cross product, to stay in integers
+            unsigned best = NoPartition;
+            std::uint64_t bestJobs = 0, bestProcs = 1;
+            for(unsigned i = 0; i < n; ++i)
+            {
+                auto& p = *parts[i];
+                if(p.numProcs() < jobinfo.numProcs)
+                    continue;
+                std::uint64_t jobs = p.numWaiting() + p.numActive();
+                if(best == NoPartition || jobs * bestProcs < bestJobs * p.numProcs())
+                {
+                    best = i;
+                    bestJobs = jobs;
+                    bestProcs = p.numProcs();
+                }
+            }
+            return best;
+        }
+    }
+}
+
+// The first partition from 'first' on (wrapping around) with at least 'numprocs' processors
+template <typename P>
+unsigned BasicShardedScheduler<P>::fitFrom(unsigned first, unsigned numprocs) const
+{
+    unsigned n = numPartitions();
+    for(unsigned k = 0; k < n; ++k)
+    {
+        unsigned i = (first + k) % n;
+        if(parts[i]->numProcs() >= numprocs)
+            return i;
+    }
+    return NoPartition;
+}
+
+//////////////////////////////////////////////
+
+template <typename P>
+void BasicShardedScheduler<P>::tick()
+{
+    advance(1);
+}
+
+// Without migration the partitions don't affect each other, so each one just advances on its
+//   own.  With it, we stop at every tick where a job completes somewhere (nothing can move in
+//   between), let every partition start what it can, and then migrate until nothing more moves.
+template <typename P>
+void BasicShardedScheduler<P>::advance(tick_t ticks)
+{
+    if(!migration)
+    {
+        pool.run(parts.size(), [&](std::size_t i) { parts[i]->advance(ticks); });
+        clock += ticks;
+        return;
+    }
+
+    while(ticks > 0)
+    {
+        schedule();
+        while(migrate())
+            schedule();
+
+        tick_t step = ticks;
+        tick_t next = nextCompletion();
+        if(next != NoTick && next - clock < step)
+            step = next - clock;
+
+        pool.run(parts.size(), [&](std::size_t i) { parts[i]->advance(step); });
+        clock += step;
+        ticks -= step;
+    }
+}
+
+template <typename P>
+void BasicShardedScheduler<P>::drain()
+{
+    // Without migration every partition can drain on its own.  Then the ones that finished first
+    //   catch up to the last (they're idle, so that's just moving their clocks).
+    if(!migration)
+    {
+        pool.run(parts.size(), [this](std::size_t i) { parts[i]->drain(); });
+        for(auto& p : parts)
+            clock = std::max(clock, p->now());
+        for(auto& p : parts)
+            p->advance(clock - p->now());
+        return;
+    }
+
+    while(!idle())
+    {
+        schedule();
+
+        // Every job fits in its partition, so if anything is waiting, something must be running.
+        tick_t next = nextCompletion();
+        if(next == NoTick)
+            throw SchedulerException("Internal Error:  jobs are waiting but none are running");
+
+        advance(next - clock);
+    }
+}
+
+template <typename P>
+void BasicShardedScheduler<P>::schedule()
+{
+    pool.run(parts.size(), [this](std::size_t i) { parts[i]->schedule(); });
+}
+
+// Every partition with free processors and nothing waiting takes jobs that fit from the others,
+//   the ones with the most waiting first.  A partition that takes jobs will start them all on its
+//   next schedule, so it isn't a donor this time around.  Returns true if any job moved.
+template <typename P>
+bool BasicShardedScheduler<P>::migrate()
+{
+    unsigned n = numPartitions();
+    donors.clear();
+    for(unsigned i = 0; i < n; ++i)
+    {
+        if(parts[i]->numWaiting())
+            donors.push_back(i);
+    }
+    if(donors.empty())
+        return false;
+    std::stable_sort(donors.begin(), donors.end(), [this](unsigned a, unsigned b) { return parts[a]->numWaiting() > parts[b]->numWaiting(); });
+
+    std::fill(received.begin(), received.end(), 0);
+    bool moved = false;
+    PortableJob job;
+    for(unsigned d = 0; d < n; ++d)
+    {
+        auto& dest = *parts[d];
+        if(dest.numWaiting())
+            continue;
+
+        unsigned budget = dest.numFreeProcs();
+        for(unsigned k = 0; k < donors.size() && budget > 0; ++k)
+        {
+            unsigned s = donors[k];
+            if(received[s])
+                continue;
+
+            while(budget > 0 && parts[s]->takeWaitingJob(budget, job))
+            {
+                if(!dest.adoptJob(job))
+                    throw SchedulerException("Internal Error:  a partition turned down a migrating job");
+                setOwner(job.id, d);
+                budget -= job.info.numProcs;
+                received[d] = 1;
+                moved = true;
+                ++numMigrations;
+            }
+        }
+    }
+    return moved;
+}
+
+template <typename P>
+tick_t BasicShardedScheduler<P>::nextCompletion() const
+{
+    tick_t next = NoTick;
+    for(auto& p : parts)
+        next = std::min(next, p->nextCompletion());
+    return next;
+}
+
+//////////////////////////////////////////////
+
+template <typename P>
+bool BasicShardedScheduler<P>::idle() const
+{
+    for(auto& p : parts)
+    {
+        if(!p->idle())
+            return false;
+    }
+    return true;
+}
+
+template <typename P>
+JobState BasicShardedScheduler<P>::getJobState(jobid_t id) const
+{
+    unsigned p = partitionOf(id);
+    return p == NoPartition ? JobState::Unknown : parts[p]->getJobState(id);
+}
+
+template <typename P>
+bool BasicShardedScheduler<P>::cancelJob(jobid_t id)
+{
+    unsigned p = partitionOf(id);
+    return p != NoPartition && parts[p]->cancelJob(id);
+}
+
+template <typename P>
+bool BasicShardedScheduler<P>::updateJob(jobid_t id, unsigned numTicks, unsigned numProcs)
+{
+    unsigned p = partitionOf(id);
+    return p != NoPartition && parts[p]->updateJob(id, numTicks, numProcs);
+}
+
+template <typename P>
+SchedulerMetrics BasicShardedScheduler<P>::getMetrics() const
+{
+    SchedMetrics all;
+    for(auto& p : parts)
+        all.merge(p->metricsCollector());
+    return all.get();
+}
+
+template <typename P>
+unsigned BasicShardedScheduler<P>::partitionOf(jobid_t id) const
+{
+    const unsigned* p = owners.find(id);
+    if(!p || parts[*p]->getJobState(id) == JobState::Unknown)
+        return NoPartition;
+    return *p;
+}
+
+// Records that job 'id' is now in partition 'p'.  If the table has doubled since the last sweep,
+//   first drop every job that has since completed or been cancelled.  The inserts since then pay
+//   for the sweep.
+template <typename P>
+void BasicShardedScheduler<P>::setOwner(jobid_t id, unsigned p)
+{
+    if(owners.size() >= sweepAt)
+    {
+        JobIdMap<unsigned> live;
+        owners.forEach([&](jobid_t job, unsigned part)
+        {
+            if(parts[part]->getJobState(job) != JobState::Unknown)
+                live.insert(job, part);
+        });
+        owners = std::move(live);
+        sweepAt = std::max(MinSweep, owners.size() * 2);
+    }
+    owners.insert(id, p);
+}
+
+
+// Every policy scheduler.cpp instantiates
+template class BasicShardedScheduler<ShortestJobFirst>;
+template class BasicShardedScheduler<FirstComeFirstServed>;
+template class BasicShardedScheduler<FairShare>;
+template class BasicShardedScheduler<EasyBackfill>;
@@ -0,0 +1,103 @@
+
+#ifndef SHARDEDSCHEDULER_H_INCLUDED
+#define SHARDEDSCHEDULER_H_INCLUDED
+
+#include <vector>
+#include <memory>
+#include "scheduler.h"
+#include "jobidmap.h"
+#include "threadpool.h"
+
+// How a sharded scheduler picks the partition for a new job.  A job only ever goes to a
+//   partition with enough processors for it; if the one picked is too small, the next one that
+//   is big enough (in partition order, wrapping around) gets it.
+enum class Routing
+{
+    LeastLoaded,    // the partition with the fewest jobs (waiting and running) per processor
+    Hash,           // by a hash of the description:  jobs with the same description share a partition
+    SizeClass       // by width:  the narrowest jobs go to the first partition and the widest to the
+                    //   last, so list the partitions smallest first
+};
+
+//  A machine split into independent partitions, each with its own BasicScheduler.  Jobs are routed
+//  to a partition when they're added, and only run there (unless migration moves them while they
+//  wait).  The partitions tick in parallel on a WorkStealingPool.
+//
+//  Each partition only ever sees its own jobs, and everything that crosses partitions -- routing
+//  and migration -- happens on the calling thread, between parallel steps, in partition order.
+//  So the results are the same whatever the number of threads.
+template <typename Policy>
+class BasicShardedScheduler
+{
+public:
+    typedef BasicScheduler<Policy>  partition_type;
+    static const unsigned           NoPartition = ~0u;
+
+    // 'partitions' is the number of processors in each partition.  'threads' is passed on to the
+    //   WorkStealingPool (0 for one per core).
+                BasicShardedScheduler(const std::vector<unsigned>& partitions, Routing routing = Routing::LeastLoaded,
+                                      unsigned threads = 0, unsigned groupsize = 0);
+
+    jobid_t     addJob(const JobInfo& jobinfo);     // the job's ID, or NoJob if no partition can run it
+
+    // BasicScheduler::cancelJob/updateJob, in whichever partition has the job.  A job stays in its
+    //   partition, so updateJob fails if it would need more processors than that partition has.
+    bool        cancelJob(jobid_t id);
+    bool        updateJob(jobid_t id, unsigned numTicks, unsigned numProcs);
+
+    void        tick();
+    void        advance(tick_t ticks);      // same as calling tick() 'ticks' times
+    void        drain();                    // runs until every job has completed
+
+    // Off to start with.  With migration on, whenever a partition has free processors and nothing
+    //   waiting, it takes waiting jobs that fit from the other partitions (the ones with the most
+    //   waiting first).  This only happens at tick boundaries, after every partition has started
+    //   what it can.
+    void            setMigration(bool on)       { migration = on;           }
+    std::uint64_t   migrations() const          { return numMigrations;     }   // jobs moved so far
+
+    tick_t      now() const                 { return clock;                 }
+    bool        idle() const;
+
+    // A job is found through the partition it was last routed or migrated to:  O(1)
+    JobState    getJobState(jobid_t id) const;
+    unsigned    partitionOf(jobid_t id) const;      // NoPartition if the job isn't here
+
+    SchedulerMetrics    getMetrics() const;         // every partition's, merged
+
+    unsigned                numPartitions() const       { return static_cast<unsigned>(parts.size());  }
+    const partition_type&   partition(unsigned i) const { return *parts[i];     }
+    unsigned                numThreads() const          { return pool.size();   }
+
+private:
+    std::vector<std::unique_ptr<partition_type>>    parts;
+    WorkStealingPool            pool;
+    Routing                     routing;
+    unsigned                    widest;             // processors in the biggest partition
+    bool                        migration;
+    std::uint64_t               numMigrations;
+    jobid_t                     lastJobId;
+    tick_t                      clock;
+
+    std::vector<unsigned>       donors;             // scratch space for migrate
+    std::vector<char>           received;
+
+    // The partition each job was last sent to.  Partitions complete and cancel jobs on their own,
+    //   so an entry may be stale:  it only counts if that partition still knows the job.  Stale
+    //   entries are swept out once the table doubles in size since the last sweep.
+    JobIdMap<unsigned>          owners;
+    std::size_t                 sweepAt;
+
+    jobid_t     getUniqueJobId();
+    unsigned    route(const JobInfo& jobinfo) const;
+    unsigned    fitFrom(unsigned first, unsigned numprocs) const;
+    tick_t      nextCompletion() const;
+    void        setOwner(jobid_t id, unsigned p);
+
+    void        schedule();
+    bool        migrate();
+};
+
+typedef BasicShardedScheduler<ShortestJobFirst>     ShardedScheduler;
+
+#endif
@@ -0,0 +1,333 @@
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <new>
+#include <cstdlib>
+#include <ctime>
+#include "procset.h"
+#include "stringtable.h"
+
+using namespace std;
+
+//  Tests for the compact pieces of a ScheduledJob:  ProcSet and StringTable.
+
+static const int iterations = 20;       // number of random tests to perform
+static const int numsteps = 20000;      // interns/releases in each random test
+
+//////////////////////////////////////////////
+//  Allocation counting (so we can tell when ProcSet goes to the heap)
+
+namespace
+{
+    std::uint64_t allocCount = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocCount;
+    if(void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size)                      { return operator new(size);    }
+void  operator delete(void* p) noexcept                     { std::free(p);                 }
+void  operator delete[](void* p) noexcept                   { std::free(p);                 }
+void  operator delete(void* p, std::size_t) noexcept        { std::free(p);                 }
+void  operator delete[](void* p, std::size_t) noexcept      { std::free(p);                 }
+
+//////////////////////////////////////////////
+//  ProcSet
+
+static void checkSet(const ProcSet& set, const vector<procid_t>& expected, const char* what)
+{
+    if(set.size() != expected.size() || set.empty() != expected.empty())
+        throw std::runtime_error(string(what) + ":  size is " + to_string(set.size()) + ", expected " + to_string(expected.size()));
+
+    vector<procid_t> copied(expected.size());
+    set.copyTo(copied.data());
+    for(unsigned i = 0; i < expected.size(); ++i)
+    {
+        if(set[i] != expected[i] || copied[i] != expected[i])
+            throw std::runtime_error(string(what) + ":  processor " + to_string(i) + " is wrong");
+    }
+}
+
+// Assigns 'ids' and checks the result, and whether that took a heap allocation
+static void assignSet(ProcSet& set, const vector<procid_t>& ids, bool allocates, const char* what)
+{
+    auto before = allocCount;
+    set.assign(ids.data(), static_cast<unsigned>(ids.size()));
+    if((allocCount != before) != allocates)
+        throw std::runtime_error(string(what) + (allocates ? ":  didn't allocate" : ":  allocated"));
+    checkSet(set, ids, what);
+}
+
+void testProcSet()
+{
+    if(sizeof(ProcSet) != 16)
+        throw std::runtime_error("ProcSet is " + to_string(sizeof(ProcSet)) + " bytes");
+
+    ProcSet set;
+    checkSet(set, {}, "default");
+
+    // runs of any length, and small scattered sets, are stored in place
+    assignSet(set, {5, 6, 7, 8, 9, 10, 11, 12}, false, "run");
+    assignSet(set, {40}, false, "single");
+    assignSet(set, {9, 3}, false, "inline");
+
+    // bigger scattered sets need a list
+    assignSet(set, {1, 4, 9, 12}, true, "heap");
+
+    // which is then used for anything that fits, whatever its shape
+    assignSet(set, {20, 21, 22}, false, "run in a list");
+    assignSet(set, {7, 2}, false, "inline in a list");
+
+    // a bump empties the set but keeps the list, so readmission doesn't allocate
+    assignSet(set, {1, 4, 9, 12}, false, "heap again");
+    set.vacate();
+    checkSet(set, {}, "vacated");
+    assignSet(set, {30, 2, 17, 8}, false, "readmitted");
+
+    // a bigger set needs a bigger list
+    assignSet(set, {1, 3, 5, 7, 9}, true, "bigger list");
+
+    // moving takes the list along and leaves an empty set behind
+    ProcSet moved(std::move(set));
+    checkSet(set, {}, "moved from");
+    checkSet(moved, {1, 3, 5, 7, 9}, "moved to");
+
+    ProcSet assigned;
+    assignSet(assigned, {2, 4, 6}, true, "target");
+    assigned = std::move(moved);
+    checkSet(moved, {}, "move assigned from");
+    checkSet(assigned, {1, 3, 5, 7, 9}, "move assigned to");
+    assignSet(moved, {8, 1}, false, "reused after move");
+
+    // clear gives the list back
+    assigned.clear();
+    checkSet(assigned, {}, "cleared");
+    assignSet(assigned, {1, 4, 9, 12}, true, "heap after clear");
+}
+
+//////////////////////////////////////////////
+//  StringTable
+
+static void checkRefs(const StringTable& table, strid_t id, std::uint32_t refs, const char* what)
+{
+    if(table.refCount(id) != refs)
+        throw std::runtime_error(string(what) + ":  " + to_string(table.refCount(id)) + " references, expected " + to_string(refs));
+}
+
+// Strings that all land in hash slot 'home' of the initial 64 slot index
+static vector<string> collidingStrings(std::uint32_t home, unsigned count)
+{
+    vector<string> out;
+    for(unsigned i = 0; out.size() < count; ++i)
+    {
+        string s = "job" + to_string(i);
+        if((StringTable::hashOf(s) & 63) == home)
+            out.push_back(s);
+    }
+    return out;
+}
+
+void testStringTable()
+{
+    StringTable table;
+
+    // the same string always gets the same ID, and holds a reference for each intern
+    strid_t a = table.intern("alpha");
+    strid_t b = table.intern("beta");
+    if(table.intern("alpha") != a || a == b || table.size() != 2)
+        throw std::runtime_error("interning the same string twice gave a new ID");
+    checkRefs(table, a, 2, "alpha");
+    checkRefs(table, b, 1, "beta");
+    if(table.get(a) != "alpha" || table.get(b) != "beta")
+        throw std::runtime_error("get returned the wrong string");
+
+    if(table.release(a) || table.size() != 2)
+        throw std::runtime_error("released a string that still has references");
+    if(!table.release(a) || table.size() != 1)
+        throw std::runtime_error("the last release didn't remove the string");
+
+    // freed IDs are handed out again, most recently freed first
+    strid_t c = table.intern("gamma");
+    strid_t d = table.intern("delta");
+    if(c != a || d != table.endId() - 1)
+        throw std::runtime_error("freed ID wasn't reused");
+    table.release(b);
+    table.release(d);
+    if(table.intern("epsilon") != d || table.intern("zeta") != b)
+        throw std::runtime_error("freed IDs weren't reused in the right order");
+
+    // Deleting from the middle of a probe run has to pull the rest of the run back, including
+    //   across the end of the index:  these go to slots 63, 0, 1, 2 (homes 63, 63, 0, 63).
+    StringTable wrap;
+    auto homeEnd = collidingStrings(63, 3);
+    auto homeStart = collidingStrings(0, 1);
+    vector<string> order = {homeEnd[0], homeEnd[1], homeStart[0], homeEnd[2]};
+    vector<strid_t> ids;
+    for(auto& s : order)
+        ids.push_back(wrap.intern(s));
+
+    for(unsigned gone = 0; gone < order.size(); ++gone)
+    {
+        if(!wrap.release(ids[gone]))
+            throw std::runtime_error("colliding string wasn't removed");
+        for(unsigned i = gone + 1; i < order.size(); ++i)
+        {
+            if(wrap.intern(order[i]) != ids[i])
+                throw std::runtime_error("lost '" + order[i] + "' after removing '" + order[gone] + "'");
+            wrap.release(ids[i]);
+        }
+        if(wrap.size() != order.size() - gone - 1)
+            throw std::runtime_error("wrong size after removing colliding strings");
+    }
+}
+
+// Saves 'table' the way a checkpoint does and restores it into a fresh one
+static void checkRestore(const StringTable& table, const map<string, pair<strid_t, std::uint32_t>>& model)
+{
+    vector<string> texts;
+    vector<std::uint32_t> refs;
+    for(strid_t id = 0; id < table.endId(); ++id)
+    {
+        refs.push_back(table.refCount(id));
+        texts.push_back(refs.back() ? table.get(id) : string());
+    }
+    vector<strid_t> unused = table.unusedIds();
+
+    StringTable copy;
+    copy.restore(std::move(texts), refs, std::move(unused));
+    if(copy.size() != table.size() || copy.endId() != table.endId() || copy.unusedIds() != table.unusedIds())
+        throw std::runtime_error("restored table doesn't match the original");
+    for(auto& m : model)
+    {
+        if(copy.get(m.second.first) != m.first || copy.refCount(m.second.first) != m.second.second)
+            throw std::runtime_error("restored table lost '" + m.first + "'");
+        if(copy.intern(m.first) != m.second.first)
+            throw std::runtime_error("restored table can't find '" + m.first + "'");
+    }
+
+    // and it refuses anything that doesn't add up
+    bool threw = false;
+    try                                     { copy.restore({}, {}, {});                     }
+    catch(SchedulerException&)              { threw = true;                                 }
+    if(!threw)
+        throw std::runtime_error("restore into a table in use didn't throw");
+
+    threw = false;
+    try                                     { StringTable().restore({"a", "a"}, {1, 1}, {});}
+    catch(SchedulerException&)              { threw = true;                                 }
+    if(!threw)
+        throw std::runtime_error("restore with a duplicate string didn't throw");
+
+    threw = false;
+    try                                     { StringTable().restore({"a", ""}, {1, 0}, {}); }
+    catch(SchedulerException&)              { threw = true;                                 }
+    if(!threw)
+        throw std::runtime_error("restore with a missing unused ID didn't throw");
+}
+
+// Random interns and releases from a small pool of names, checked against a map
+void testStrings(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    unsigned poolsize = 50 + rng() % 1000;
+
+    StringTable table;
+    map<string, pair<strid_t, std::uint32_t>> model;        // string -> ID, references
+
+    for(int step = 0; step < numsteps; ++step)
+    {
+        string s = "desc" + to_string(rng() % poolsize);
+        auto i = model.find(s);
+        if(i == model.end() || rng() % 2)
+        {
+            strid_t id = table.intern(s);
+            if(i == model.end())
+            {
+                for(auto& m : model)
+                {
+                    if(m.second.first == id)
+                        throw std::runtime_error("'" + s + "' was given the ID of '" + m.first + "'");
+                }
+                model[s] = make_pair(id, 1u);
+            }
+            else if(id != i->second.first)
+                throw std::runtime_error("'" + s + "' changed ID");
+            else
+                ++i->second.second;
+        }
+        else
+        {
+            bool last = table.release(i->second.first);
+            if(last != (i->second.second == 1))
+                throw std::runtime_error("release of '" + s + "' returned the wrong result");
+            if(last)    model.erase(i);
+            else        --i->second.second;
+        }
+
+        if(table.size() != model.size())
+            throw std::runtime_error("size is " + to_string(table.size()) + ", expected " + to_string(model.size()));
+    }
+
+    for(auto& m : model)
+    {
+        if(table.get(m.second.first) != m.first)
+            throw std::runtime_error("ID of '" + m.first + "' has the wrong string");
+        checkRefs(table, m.second.first, m.second.second, m.first.c_str());
+    }
+    checkRestore(table, model);
+}
+
+int main()
+{
+    struct { const char* name; void (*test)(); } fixed[] = {
+        {"procset",     testProcSet     },
+        {"strings",     testStringTable },
+    };
+
+    for(auto& f : fixed)
+    {
+        cout << "Beginning storage test (" << setw(10) << setfill(' ') << f.name << "):  ";
+        try
+        {
+            f.test();
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    srand((unsigned)time(nullptr));
+
+    std::vector<unsigned> seeds;
+    seeds.reserve(iterations);
+    for(int i = 0; i < iterations; ++i)
+        seeds.push_back( rand() );
+
+    for(auto& seed : seeds)
+    {
+        cout << "Beginning string table test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+        try
+        {
+            testStrings(seed);
+            cout << "SUCCESS!" << endl;
+        }
+        catch(std::exception& e)
+        {
+            cout << "FAILED: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
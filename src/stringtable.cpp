@@ -0,0 +1,164 @@
+
+#include "stringtable.h"
+
+// FNV-1a
+std::uint32_t StringTable::hashOf(const std::string& s)
+{
+    std::uint32_t h = 2166136261u;
+    for(unsigned char c : s)
+    {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+strid_t StringTable::intern(const std::string& s)
+{
+    // keep the index at most half full
+    if((live + 1) * 2 > index.size())
+        grow();
+
+    std::uint32_t h = hashOf(s);
+    std::size_t mask = index.size() - 1;
+    for(std::size_t slot = h & mask; ; slot = (slot + 1) & mask)
+    {
+        strid_t id = index[slot];
+        if(id == NoString)
+        {
+            if(freeIds.empty())
+            {
+                id = static_cast<strid_t>(entries.size());
+                if(id == NoString)
+                    throw SchedulerException("StringTable is full");
+                entries.emplace_back();
+            }
+            else
+            {
+                id = freeIds.back();
+                freeIds.pop_back();
+            }
+
+            Entry& e = entries[id];
+            e.text = s;
+            e.hash = h;
+            e.refs = 1;
+            index[slot] = id;
+            ++live;
+            return id;
+        }
+
+        Entry& e = entries[id];
+        if(e.hash == h && e.text == s)
+        {
+            ++e.refs;
+            return id;
+        }
+    }
+}
+
+bool StringTable::release(strid_t id)
+{
+    Entry& e = entries[id];
+    if(--e.refs)
+        return false;
+
+    std::size_t mask = index.size() - 1;
+    std::size_t slot = e.hash & mask;
+    while(index[slot] != id)
+        slot = (slot + 1) & mask;
+
+    // Close the gap rather than leave a tombstone:  pull back every later entry in the probe run
+    //   whose home slot isn't between the gap and where it sits now.
+    for(std::size_t next = (slot + 1) & mask; index[next] != NoString; next = (next + 1) & mask)
+    {
+        std::size_t home = entries[index[next]].hash & mask;
+        bool stays = (slot <= next) ? (slot < home && home <= next)
+                                    : (slot < home || home <= next);
+        if(!stays)
+        {
+            index[slot] = index[next];
+            slot = next;
+        }
+    }
+    index[slot] = NoString;
+
+    std::string().swap(e.text);     // give back long strings' storage now
+    freeIds.push_back(id);
+    --live;
+    return true;
+}
+
+void StringTable::restore(std::vector<std::string>&& texts, const std::vector<std::uint32_t>& refs,
+                          std::vector<strid_t>&& unused)
+{
+    if(!entries.empty())
+        throw SchedulerException("StringTable::restore needs an empty table");
+    if(texts.size() != refs.size() || texts.size() >= NoString)
+        throw SchedulerException("StringTable::restore was given mismatched strings and counts");
+
+    entries.resize(texts.size());
+    std::size_t numUnused = 0;
+    for(std::size_t id = 0; id < texts.size(); ++id)
+    {
+        Entry& e = entries[id];
+        e.refs = refs[id];
+        if(!e.refs)
+        {
+            ++numUnused;
+            continue;
+        }
+        e.text = std::move(texts[id]);
+        e.hash = hashOf(e.text);
+        ++live;
+    }
+
+    // every unused ID has to be on the free list, once
+    if(unused.size() != numUnused)
+        throw SchedulerException("StringTable::restore was given the wrong number of unused IDs");
+    std::vector<char> listed(entries.size(), 0);
+    for(auto id : unused)
+    {
+        if(id >= entries.size() || entries[id].refs || listed[id])
+            throw SchedulerException("StringTable::restore was given a bad unused ID");
+        listed[id] = 1;
+    }
+    freeIds = std::move(unused);
+
+    std::size_t size = 64;
+    while(size < live * 2)
+        size *= 2;
+    index.assign(size, NoString);
+    std::size_t mask = size - 1;
+    for(strid_t id = 0; id < entries.size(); ++id)
+    {
+        const Entry& e = entries[id];
+        if(!e.refs)
+            continue;
+
+        std::size_t slot = e.hash & mask;
+        for(; index[slot] != NoString; slot = (slot + 1) & mask)
+        {
+            const Entry& other = entries[index[slot]];
+            if(other.hash == e.hash && other.text == e.text)
+                throw SchedulerException("StringTable::restore was given the same string twice");
+        }
+        index[slot] = id;
+    }
+}
+
+void StringTable::grow()
+{
+    std::vector<strid_t> bigger(index.empty() ? 64 : index.size() * 2, NoString);
+    std::size_t mask = bigger.size() - 1;
+    for(auto id : index)
+    {
+        if(id == NoString)
+            continue;
+        std::size_t slot = entries[id].hash & mask;
+        while(bigger[slot] != NoString)
+            slot = (slot + 1) & mask;
+        bigger[slot] = id;
+    }
+    index.swap(bigger);
+}
@@ -0,0 +1,54 @@
+
+#ifndef STRINGTABLE_H_INCLUDED
+#define STRINGTABLE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "types.h"
+
+//  StringTable keeps one copy of each distinct string, referenced by a 32-bit ID.
+//
+//  Every 'intern' adds a reference and every 'release' drops one; a string is removed when its
+//  last reference goes, and its ID is reused later.  Lookup is an open addressed hash (linear
+//  probing) over the IDs, so the index costs 4 bytes a slot on top of the strings themselves.
+class StringTable
+{
+public:
+    // Returns the ID of 's', adding it if it isn't here yet
+    strid_t             intern(const std::string& s);
+    bool                release(strid_t id);        // true if that was the last reference
+
+    const std::string&  get(strid_t id) const       { return entries[id].text;  }
+
+    std::size_t         size() const                { return live;              }   // number of distinct strings
+    bool                empty() const               { return !live;             }
+
+    static std::uint32_t    hashOf(const std::string& s);   // FNV-1a
+
+    // Checkpoints save every ID below endId() -- its string and reference count, both empty if
+    //   the ID isn't in use -- and the unused IDs in the order they'll be handed out again.
+    //   restore rebuilds an empty table from exactly that.
+    strid_t                     endId() const               { return static_cast<strid_t>(entries.size());  }
+    std::uint32_t               refCount(strid_t id) const  { return entries[id].refs;  }
+    const std::vector<strid_t>& unusedIds() const           { return freeIds;           }
+    void                        restore(std::vector<std::string>&& texts, const std::vector<std::uint32_t>& refs,
+                                        std::vector<strid_t>&& unused);
+
+private:
+    struct Entry
+    {
+        std::string     text;
+        std::uint32_t   hash;
+        std::uint32_t   refs;
+    };
+
+    std::vector<Entry>      entries;        // indexed by ID
+    std::vector<strid_t>    freeIds;        // entries that can be reused
+    std::vector<strid_t>    index;          // hash slots (NoString if empty); size is a power of 2
+    std::size_t             live = 0;
+
+    void                    grow();
+};
+
+#endif
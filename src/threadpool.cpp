@@ -0,0 +1,126 @@
+
+#include "threadpool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(unsigned i = 0; i < threads; ++i)
+        queues.emplace_back( new Queue );
+    for(unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> g(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto& t : workers)
+        t.join();
+}
+
+void WorkStealingPool::run(std::size_t count, const std::function<void(std::size_t)>& fn)
+{
+    if(count == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> g(lock);
+        pending = count;
+        error = nullptr;
+        ++batch;
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            Queue& q = *queues[i % queues.size()];
+            std::lock_guard<std::mutex> qg(q.lock);
+            q.tasks.push_back( Task{&fn, i} );
+        }
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> g(lock);
+        finished.wait(g, [this]() { return pending == 0; });
+        std::swap(e, error);
+    }
+    if(e)
+        std::rethrow_exception(e);
+}
+
+void WorkStealingPool::workerLoop(unsigned self)
+{
+    std::uint64_t seen = 0;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> g(lock);
+            wake.wait(g, [&]() { return stopping || batch != seen; });
+            if(stopping)
+                return;
+            seen = batch;
+        }
+        work(self);
+    }
+}
+
+// Runs tasks until there are none left anywhere
+void WorkStealingPool::work(unsigned self)
+{
+    Task t;
+    while(next(self, t))
+    {
+        try
+        {
+            (*t.fn)(t.index);
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if(!error)
+                error = std::current_exception();
+        }
+
+        // notify while still holding the lock:  once 'pending' hits 0, run can return and the
+        //   pool can be destroyed
+        std::lock_guard<std::mutex> g(lock);
+        if(--pending == 0)
+            finished.notify_all();
+    }
+}
+
+// The newest task in our own queue, or else the oldest one in someone else's
+bool WorkStealingPool::next(unsigned self, Task& t)
+{
+    {
+        Queue& q = *queues[self];
+        std::lock_guard<std::mutex> g(q.lock);
+        if(!q.tasks.empty())
+        {
+            t = q.tasks.back();
+            q.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for(std::size_t k = 1; k < queues.size(); ++k)
+    {
+        Queue& q = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> g(q.lock);
+        if(!q.tasks.empty())
+        {
+            t = q.tasks.front();
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
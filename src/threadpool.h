@@ -0,0 +1,69 @@
+
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+//  A fixed set of threads for running batches of independent tasks.
+//
+//  run(count, task) calls task(0) .. task(count-1) and returns once they have all finished.  The
+//  indices are dealt out round robin to one deque per thread (the calling thread has one too, and
+//  works like the others).  A thread takes from the back of its own deque, and when that's empty
+//  it steals from the front of someone else's, so a few slow tasks don't leave the other threads
+//  idle.  Which thread runs which task is not fixed, so tasks must not depend on each other.
+class WorkStealingPool
+{
+public:
+    // 'threads' counts the calling thread:  1 runs everything on the calling thread, and 0 uses
+    //   one thread per core.
+    explicit    WorkStealingPool(unsigned threads = 0);
+                ~WorkStealingPool();
+
+                WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool&   operator = (const WorkStealingPool&) = delete;
+
+    // If tasks throw, the rest still run, and then the first exception is rethrown here.  Only
+    //   one thread may call this at a time.
+    void        run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    unsigned    size() const        { return static_cast<unsigned>(queues.size());  }
+
+private:
+    // Each task carries its batch's function, so a thread that wakes up late can't run one
+    //   batch's task with another's function.
+    struct Task
+    {
+        const std::function<void(std::size_t)>*     fn;
+        std::size_t                                 index;
+    };
+    struct Queue
+    {
+        std::mutex                  lock;
+        std::deque<Task>            tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>>     queues;     // [0] belongs to the calling thread
+    std::vector<std::thread>                workers;
+
+    std::mutex                  lock;           // guards everything below
+    std::condition_variable     wake;           // a new batch has started (or we're shutting down)
+    std::condition_variable     finished;       // the last task of the batch is done
+    std::uint64_t               batch = 0;      // incremented for every run
+    std::size_t                 pending = 0;    // tasks of this batch not yet finished
+    std::exception_ptr          error;
+    bool                        stopping = false;
+
+    void        workerLoop(unsigned self);
+    void        work(unsigned self);
+    bool        next(unsigned self, Task& t);
+};
+
+#endif
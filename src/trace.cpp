@@ -0,0 +1,227 @@
+
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include "trace.h"
+
+namespace
+{
+    const char          TraceMagic[8] = { 'D','S','T','R','A','C','E','\0' };
+    const std::uint32_t TraceVersion = 2;       // 1 had fixed size descriptions, cut off at 24 characters
+
+    inline bool isSpace(char c)     { return c == ' ' || c == '\t' || c == '\r';    }
+    inline bool isDigit(char c)     { return c >= '0' && c <= '9';                  }
+
+    // Reads a decimal number at 'p', which has to end at whitespace or the end of the line and be
+    //   no bigger than 'max'
+    std::uint64_t parseNumber(const char*& p, const char* lineend, std::uint64_t max, std::uint64_t lineNumber)
+    {
+        if(p == lineend || !isDigit(*p))
+            throw SchedulerException("Malformed trace on line " + std::to_string(lineNumber));
+
+        std::uint64_t value = 0;
+        for(; p < lineend && isDigit(*p); ++p)
+        {
+            unsigned digit = *p - '0';
+            if(value > (max - digit) / 10)
+                throw SchedulerException("Number out of range in trace on line " + std::to_string(lineNumber));
+            value = value * 10 + digit;
+        }
+        if(p < lineend && !isSpace(*p))
+            throw SchedulerException("Malformed trace on line " + std::to_string(lineNumber));
+        return value;
+    }
+
+    // An output file that is removed again unless it's finished, so a failure part way through
+    //   doesn't leave half a file behind (the same as CheckpointWriter)
+    struct OutputFile
+    {
+        std::string     path;
+        FILE*           file;
+
+        explicit OutputFile(const std::string& path_) : path(path_), file(std::fopen(path_.c_str(), "wb"))    {}
+        ~OutputFile()
+        {
+            if(file)
+            {
+                std::fclose(file);
+                std::remove(path.c_str());
+            }
+        }
+
+        OutputFile(const OutputFile&) = delete;
+        OutputFile& operator = (const OutputFile&) = delete;
+
+        // Closes the file, and throws (after removing it) if anything failed to write
+        void finish()
+        {
+            bool failed = std::ferror(file) != 0;
+            failed = (std::fclose(file) != 0) || failed;
+            file = nullptr;
+            if(failed)
+            {
+                std::remove(path.c_str());
+                throw SchedulerException("Error writing '" + path + "'");
+            }
+        }
+    };
+}
+
+TraceReader::TraceReader(const std::string& path)
+    : file(path)
+{
+    pos = file.data();
+    end = pos + file.size();
+
+    if(file.size() >= sizeof(TraceHeader) && !std::memcmp(pos, TraceMagic, sizeof(TraceMagic)))
+    {
+        TraceHeader hdr;
+        std::memcpy(&hdr, pos, sizeof(hdr));
+        if(hdr.version != TraceVersion)
+            throw SchedulerException("'" + path + "' has unsupported trace version " + std::to_string(hdr.version)
+                                     + " (convert the text trace again)");
+        if(hdr.recordSize != sizeof(TraceBinRecord))
+            throw SchedulerException("'" + path + "' has an unexpected record size");
+        if(hdr.count > (file.size() - sizeof(hdr)) / sizeof(TraceBinRecord))
+            throw SchedulerException("'" + path + "' is truncated");
+
+        fmt = TraceFormat::Binary;
+        binCount = hdr.count;
+        pos += sizeof(hdr);
+        end = pos + binCount * sizeof(TraceBinRecord);
+        strings = end;
+        stringsSize = file.data() + file.size() - end;
+    }
+    else
+        fmt = TraceFormat::Text;
+}
+
+bool TraceReader::next(TraceRecord& rec)
+{
+    if(fmt == TraceFormat::Binary)      return nextBinary(rec);
+    return nextText(rec);
+}
+
+bool TraceReader::nextBinary(TraceRecord& rec)
+{
+    if(pos == end)
+        return false;
+
+    TraceBinRecord bin;
+    std::memcpy(&bin, pos, sizeof(bin));        // memcpy, since the mapping is only guaranteed to be byte aligned
+
+    if(bin.descOffset > stringsSize || bin.descLength > stringsSize - bin.descOffset)
+        throw SchedulerException("Description of trace record " + std::to_string(binCount - (end - pos) / sizeof(bin) + 1)
+                                 + " is past the end of the file");
+
+    rec.arrival = bin.arrival;
+    rec.numProcs = bin.numProcs;
+    rec.numTicks = bin.numTicks;
+    rec.description = strings + bin.descOffset;
+    rec.descLength = bin.descLength;
+
+    pos += sizeof(bin);
+    return true;
+}
+
+bool TraceReader::nextText(TraceRecord& rec)
+{
+    while(pos < end)
+    {
+        ++lineNumber;
+        const char* lineend = static_cast<const char*>( std::memchr(pos, '\n', end - pos) );
+        if(!lineend)        lineend = end;
+
+        const char* p = pos;
+        pos = (lineend == end) ? end : lineend + 1;
+
+        while(p < lineend && isSpace(*p))       ++p;
+        if(p == lineend || *p == '#')           continue;       // blank line or comment
+
+        // three numbers:  arrival, procs, ticks
+        static const std::uint64_t limits[3] = { UINT64_MAX, UINT_MAX, UINT_MAX };
+        std::uint64_t fields[3];
+        for(int f = 0; f < 3; ++f)
+        {
+            while(p < lineend && isSpace(*p))   ++p;
+            fields[f] = parseNumber(p, lineend, limits[f], lineNumber);
+        }
+
+        // the rest of the line (trimmed) is the description
+        while(p < lineend && isSpace(*p))           ++p;
+        const char* descend = lineend;
+        while(descend > p && isSpace(descend[-1]))  --descend;
+
+        rec.arrival = fields[0];
+        rec.numProcs = static_cast<unsigned>(fields[1]);
+        rec.numTicks = static_cast<unsigned>(fields[2]);
+        rec.description = p;
+        rec.descLength = descend - p;
+        return true;
+    }
+    return false;
+}
+
+LoadedTrace::LoadedTrace(const std::string& path)
+    : reader(path)
+{
+    if(reader.format() == TraceFormat::Binary)
+        recs.reserve(reader.count());
+
+    TraceRecord rec;
+    while(reader.next(rec))
+        recs.push_back(rec);
+}
+
+std::uint64_t convertTrace(const std::string& textpath, const std::string& binpath)
+{
+    TraceReader in(textpath);
+    if(in.format() != TraceFormat::Text)
+        throw SchedulerException("'" + textpath + "' is not a text trace");
+
+    OutputFile file(binpath);
+    if(!file.file)
+        throw SchedulerException("Unable to open '" + binpath + "' for writing");
+    FILE* out = file.file;
+
+    TraceHeader hdr;
+    std::memcpy(hdr.magic, TraceMagic, sizeof(hdr.magic));
+    hdr.version = TraceVersion;
+    hdr.recordSize = sizeof(TraceBinRecord);
+    hdr.count = 0;
+    std::fwrite(&hdr, sizeof(hdr), 1, out);      // the count gets filled in at the end
+
+    // the descriptions are collected as the records go out, and written after them
+    std::string strings;
+    std::unordered_map<std::string, std::uint64_t> offsets;
+    TraceRecord rec;
+    TraceBinRecord bin;
+    while(in.next(rec))
+    {
+        if(rec.descLength > UINT32_MAX)
+            throw SchedulerException("A description in '" + textpath + "' is too long");
+
+        auto found = offsets.emplace(std::string(rec.description, rec.descLength), strings.size());
+        if(found.second)
+            strings.append(rec.description, rec.descLength);
+
+        std::memset(&bin, 0, sizeof(bin));
+        bin.arrival = rec.arrival;
+        bin.numProcs = rec.numProcs;
+        bin.numTicks = rec.numTicks;
+        bin.descOffset = found.first->second;
+        bin.descLength = static_cast<std::uint32_t>(rec.descLength);
+
+        std::fwrite(&bin, sizeof(bin), 1, out);
+        ++hdr.count;
+    }
+    std::fwrite(strings.data(), 1, strings.size(), out);
+
+    std::fseek(out, 0, SEEK_SET);
+    std::fwrite(&hdr, sizeof(hdr), 1, out);
+    file.finish();
+
+    return hdr.count;
+}
@@ -0,0 +1,111 @@
+
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "mappedfile.h"
+
+//  Job traces for batch replay.
+//
+//  Text format:  one job per line
+//      <arrival tick> <num procs> <num ticks> <description>
+//  Blank lines and lines starting with '#' are ignored.  The description is the rest of the line.
+//
+//  Binary format:  a TraceHeader, 'count' fixed size TraceBinRecords, then a string section
+//  holding the descriptions (each record gives its description's offset into the section and
+//  its length; records with the same description share it).  All values are stored in the
+//  host's byte order.
+//
+//  In both formats, jobs must be in order of arrival tick.
+
+struct TraceHeader
+{
+    char            magic[8];       // TraceMagic
+    std::uint32_t   version;        // TraceVersion
+    std::uint32_t   recordSize;     // sizeof(TraceBinRecord)
+    std::uint64_t   count;          // number of records that follow
+};
+
+struct TraceBinRecord
+{
+    std::uint64_t   arrival;
+    std::uint32_t   numProcs;
+    std::uint32_t   numTicks;
+    std::uint64_t   descOffset;     // from the start of the string section
+    std::uint32_t   descLength;
+    std::uint32_t   reserved;       // zero
+};
+
+static_assert(sizeof(TraceHeader) == 24,        "TraceHeader must not have padding");
+static_assert(sizeof(TraceBinRecord) == 32,     "TraceBinRecord must not have padding");
+
+// One job from a trace.  'description' points into the trace's memory, and is not null terminated.
+struct TraceRecord
+{
+    tick_t          arrival;
+    unsigned        numProcs;
+    unsigned        numTicks;
+    const char*     description;
+    std::size_t     descLength;
+};
+
+enum class TraceFormat
+{
+    Text,
+    Binary
+};
+
+//  Reads a trace of either format out of a memory mapped file.  The format is detected from
+//  the file's contents.
+class TraceReader
+{
+public:
+    explicit        TraceReader(const std::string& path);      // throws SchedulerException on failure
+
+    TraceFormat     format() const          { return fmt;           }
+
+    // Returns false at the end of the trace.  Throws SchedulerException if the trace is malformed.
+    bool            next(TraceRecord& rec);
+
+    // Binary traces only:  the total number of records
+    std::uint64_t   count() const           { return binCount;      }
+
+private:
+    MappedFile      file;
+    TraceFormat     fmt;
+    const char*     pos;
+    const char*     end;
+    const char*     strings = nullptr;      // binary traces:  the string section
+    std::uint64_t   stringsSize = 0;
+    std::uint64_t   binCount = 0;
+    std::uint64_t   lineNumber = 0;
+
+    bool            nextText(TraceRecord& rec);
+    bool            nextBinary(TraceRecord& rec);
+};
+
+//  A whole trace, parsed once and kept in memory so it can be replayed many times over -- by
+//  several threads at once, since nothing changes it after loading.  The descriptions still point
+//  into the mapped file, so every replay shares the one copy.
+class LoadedTrace
+{
+public:
+    explicit        LoadedTrace(const std::string& path);      // throws SchedulerException on failure
+
+    TraceFormat         format() const          { return reader.format();       }
+    std::size_t         size() const            { return recs.size();           }
+    const TraceRecord*  begin() const           { return recs.data();           }
+    const TraceRecord*  end() const             { return recs.data() + recs.size();     }
+
+private:
+    TraceReader                 reader;         // keeps the file mapped
+    std::vector<TraceRecord>    recs;
+};
+
+// Converts a text trace to a binary one.  Returns the number of records written.
+std::uint64_t convertTrace(const std::string& textpath, const std::string& binpath);
+
+#endif
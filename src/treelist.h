@@ -3,15 +3,30 @@
 #define TREELIST_H_INCLUDED
 
 #include <string>
-
-template <typename T>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include "nodepool.h"
+#include "treelist_balance.hpp"
+#include "treelist_augment.hpp"
+
+template <typename T, typename Balance = TreeListUnbalanced, typename Alloc = PoolAllocator<T>, typename Augment = TreeListNoAugment>
 class TreeList
 {
 public:
     class iterator;
     class const_iterator;
 
+    // A stable reference to an element (see BlockList).  Valid until the element is erased, like
+    //   an iterator, but just the node pointer -- half the size.
+    class handle_type;
+
     TreeList() = default;
+    explicit TreeList(const Alloc& a) : nodeAlloc(a) {}
     ~TreeList()                 { clear();      }
 
     // no copying
@@ -23,8 +38,25 @@ public:
     TreeList& operator = (TreeList&& rhs);
 
     
-    void insert(const T& obj);
-    void insert(T&& obj);
+    // Inserting past Augment::maxSize elements throws std::length_error
+    iterator        insert(const T& obj);
+    iterator        insert(T&& obj);
+
+    // Adds every element in the range [first, last), which is walked twice (once to count it),
+    //   so it needs forward iterators.  Large batches are sorted (on several threads if they are
+    //   big enough), merged with the existing list, and the tree is rebuilt perfectly balanced:
+    //   O(n + k log k) instead of k descents from the root.  Small batches are just inserted one
+    //   at a time.  Existing iterators stay valid either way, and equal elements end up in the
+    //   same order as if they had been inserted one by one.
+    //   The second form also writes a handle to each new element to 'positions', in the same
+    //   order as the input.
+    static const std::ptrdiff_t     BulkMinBatch = 32;      // smaller batches are always inserted one at a time
+
+    template <typename ForwardIt>
+    void            insert_bulk(ForwardIt first, ForwardIt last);
+    template <typename ForwardIt, typename OutputIt>
+    OutputIt        insert_bulk(ForwardIt first, ForwardIt last, OutputIt positions);
+
     void clear();
 
     iterator        erase(const iterator& i);
@@ -37,7 +69,77 @@ public:
     iterator        find(const T& v)            { return internalFind<iterator>(root, v);       }
     const_iterator  find(const T& v) const      { return internalFind<const_iterator>(root, v); }
 
-    int             size() const  {     return numNodes;    }
+    // first element not less than 'v' / first element greater than 'v' (end() if there is none)
+    iterator        lower_bound(const T& v)         { return internalBound<iterator>(root, v, false);      }
+    const_iterator  lower_bound(const T& v) const   { return internalBound<const_iterator>(root, v, false);}
+    iterator        upper_bound(const T& v)         { return internalBound<iterator>(root, v, true);       }
+    const_iterator  upper_bound(const T& v) const   { return internalBound<const_iterator>(root, v, true); }
+
+    // Augmented trees only:  returns the first element at or after 'from' whose summary satisfies
+    //   'pred' (end() if there is none).  'pred' is called with Augment::value_type, and must be
+    //   monotone:  if it fails for a subtree's summary, it must fail for every element in that
+    //   subtree.  O(log n) with a balanced tree when 'pred' is exact (it only passes a subtree that
+    //   has a match).  A looser 'pred' still works, but pays for every subtree it lets in.
+    template <typename Pred>
+    iterator        findNext(const iterator& from, Pred pred);
+
+    // Augmented trees only:  the summary of every element from 'from' to the end of the list.
+    //   'from' must not be end().  O(log n) with a balanced tree.
+    typename Augment::value_type    summarizeFrom(const iterator& from) const       { return summarizeFrom(from.node);  }
+    typename Augment::value_type    summarizeFrom(const const_iterator& from) const { return summarizeFrom(from.node);  }
+
+    // Augmented trees only:  returns the first element where the summary of everything from
+    //   begin() up to and including it satisfies 'pred' (end() if there is none), and sets 'sum' to
+    //   that summary.  'pred' must be monotone the other way:  once it holds for a prefix, it has
+    //   to hold for every longer one.  O(log n) with a balanced tree.
+    template <typename Pred, typename Sum>
+    iterator        findPrefix(Pred pred, Sum& sum);
+
+    // Augmented trees only:  order statistics, from the subtree sizes every augmented node keeps.
+    //   rank is how many elements come before 'i' (size() for end()), nth is the element with
+    //   'k' elements before it (end() if there isn't one), and count is how many elements are in
+    //   [first, last).  O(log n) with a balanced tree.
+    std::size_t     rank(const iterator& i) const               { return rankOf(i.node);                    }
+    std::size_t     rank(const const_iterator& i) const         { return rankOf(i.node);                    }
+    iterator        nth(std::size_t k)                          { return iterator(this, nthNode(k));        }
+    const_iterator  nth(std::size_t k) const                    { return const_iterator(this, nthNode(k));  }
+    std::size_t     count(const iterator& first, const iterator& last) const                { return rankOf(last.node) - rankOf(first.node);    }
+    std::size_t     count(const const_iterator& first, const const_iterator& last) const    { return rankOf(last.node) - rankOf(first.node);    }
+
+    // Augmented trees only:  how many elements in [first, last) satisfy 'pred', which is called
+    //   with Augment::value_type and has to be monotone like findNext's.  Subtrees whose summary
+    //   fails it are skipped whole.  The second form also takes 'whole', which says from a
+    //   subtree's summary that every element in it satisfies 'pred', so the subtree is counted
+    //   by its size instead of gone down into.  This costs O(log n) for the path to 'last', plus
+    //   a walk down into every subtree before it that 'pred' lets in and 'whole' doesn't.
+    template <typename Pred>
+    std::size_t     countIf(const iterator& first, const iterator& last, Pred pred) const
+    {
+        return countIf(first, last, pred, Never());
+    }
+    template <typename Pred>
+    std::size_t     countIf(const const_iterator& first, const const_iterator& last, Pred pred) const
+    {
+        return countIf(first, last, pred, Never());
+    }
+    template <typename Pred, typename Whole>
+    std::size_t     countIf(const iterator& first, const iterator& last, Pred pred, Whole whole) const
+    {
+        return countBefore(last.node, pred, whole) - countBefore(first.node, pred, whole);
+    }
+    template <typename Pred, typename Whole>
+    std::size_t     countIf(const const_iterator& first, const const_iterator& last, Pred pred, Whole whole) const
+    {
+        return countBefore(last.node, pred, whole) - countBefore(first.node, pred, whole);
+    }
+
+    handle_type     handle(const iterator& i) const;
+    T&              get(handle_type h);
+    const T&        get(handle_type h) const;
+    iterator        locate(handle_type h)               { return iterator(this, h.node);        }
+    const_iterator  locate(handle_type h) const         { return const_iterator(this, h.node);  }
+
+    std::size_t     size() const  {     return numNodes;    }
     bool            empty() const {     return !root;       }
 
     // For debugging
@@ -47,7 +149,9 @@ public:
 private:
     friend class iterator;
     friend class const_iterator;
-    struct Node
+    friend class handle_type;
+    friend Balance;
+    struct Node : public Balance::NodeData, public Augment::NodeData
     {
         Node*   parent = nullptr;
         Node*   left = nullptr;
@@ -59,16 +163,49 @@ private:
         Node(const T& rhs) : obj(rhs) {}
         Node(T&& rhs) : obj(std::move(rhs)) {}
     };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node>     NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc>                                        NodeTraits;
 
     Node*       root = nullptr;
     Node*       head = nullptr;
-    int         numNodes = 0;
+    std::size_t numNodes = 0;
+    NodeAlloc   nodeAlloc;
 
-    static void recursiveDelete(Node* n);
+    template <typename... Args>
+    Node*       createNode(Args&&... args);
+    void        destroyNode(Node* n);
+    void        recursiveDelete(Node* n);
     void        internalInsert(Node* n);
+    void        rotateLeft(Node* n);
+    void        rotateRight(Node* n);
+    void        propagate(Node* n);         // refreshes augmented data from 'n' up to the root
+
+    bool        worthRebuilding(std::ptrdiff_t k) const;
+    template <typename ForwardIt>
+    void        createNodes(ForwardIt first, ForwardIt last, std::vector<Node*>& out);
+    void        linkBulk(std::vector<Node*>& added);
+    static void sortNodes(std::vector<Node*>& nodes);
+    static Node* buildTree(Node** nodes, std::size_t count, Node* parent, int depth, int maxDepth);
+
+    template <typename Pred>
+    Node*       firstMatch(Node* n, Pred& pred);
+    void        checkRoom(std::size_t k) const;
+    std::size_t rankOf(const Node* n) const;
+    Node*       nthNode(std::size_t k) const;
+    struct Never
+    {
+        template <typename V>   bool operator () (const V&) const   { return false;     }
+    };
+    template <typename Pred, typename Whole>
+    std::size_t countBefore(const Node* n, Pred& pred, Whole& whole) const;
+    template <typename Pred, typename Whole>
+    std::size_t countMatches(const Node* n, Pred& pred, Whole& whole) const;
+    typename Augment::value_type    summarizeFrom(const Node* n) const;
 
     template <typename iter_t, typename node_t>
     iter_t internalFind(node_t* node, const T& v) const;
+    template <typename iter_t, typename node_t>
+    iter_t internalBound(node_t* node, const T& v, bool upper) const;
 
 
     // For debugging
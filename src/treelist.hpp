@@ -1,16 +1,18 @@
 
-template <typename T>
-TreeList<T>::TreeList(TreeList&& rhs)
+template <typename T, typename B, typename A, typename G>
+TreeList<T,B,A,G>::TreeList(TreeList&& rhs)
+    : nodeAlloc(rhs.nodeAlloc)      // nodes have to go back to the pool they came from
 {
     numNodes = rhs.numNodes;
     root = rhs.root;
     head = rhs.head;
     rhs.root = nullptr;
     rhs.head = nullptr;
+    rhs.numNodes = 0;
 }
 
-template <typename T>
-TreeList<T>& TreeList<T>::operator = (TreeList&& rhs)
+template <typename T, typename B, typename A, typename G>
+TreeList<T,B,A,G>& TreeList<T,B,A,G>::operator = (TreeList&& rhs)
 {
     if(this != &rhs)
     {
@@ -18,38 +20,64 @@ TreeList<T>& TreeList<T>::operator = (TreeList&& rhs)
         numNodes = rhs.numNodes;
         root = rhs.root;
         head = rhs.head;
+        nodeAlloc = rhs.nodeAlloc;
         rhs.root = nullptr;
         rhs.head = nullptr;
+        rhs.numNodes = 0;
     }
     return *this;
 }
 
-template <typename T>
-void TreeList<T>::clear()
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::clear()
 {
     recursiveDelete(root);
     root = head = nullptr;
     numNodes = 0;
 }
 
-template <typename T>
-inline void TreeList<T>::recursiveDelete(Node* n)
+template <typename T, typename B, typename A, typename G>
+inline void TreeList<T,B,A,G>::recursiveDelete(Node* n)
 {
     if(n)
     {
         recursiveDelete(n->left);
         recursiveDelete(n->right);
-        delete n;
+        destroyNode(n);
     }
 }
 
-template <typename T> auto TreeList<T>::begin() -> iterator                 { return iterator(this, head);          }
-template <typename T> auto TreeList<T>::begin() const -> const_iterator     { return const_iterator(this, head);    }
-template <typename T> auto TreeList<T>::end() -> iterator                   { return iterator(this, nullptr);       }
-template <typename T> auto TreeList<T>::end() const -> const_iterator       { return const_iterator(this, nullptr); }
+template <typename T, typename B, typename A, typename G>
+template <typename... Args>
+auto TreeList<T,B,A,G>::createNode(Args&&... args) -> Node*
+{
+    Node* n = NodeTraits::allocate(nodeAlloc, 1);
+    try
+    {
+        NodeTraits::construct(nodeAlloc, n, std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+        NodeTraits::deallocate(nodeAlloc, n, 1);
+        throw;
+    }
+    return n;
+}
 
-template <typename T>
-auto TreeList<T>::erase(const iterator& i) -> iterator
+template <typename T, typename B, typename A, typename G>
+inline void TreeList<T,B,A,G>::destroyNode(Node* n)
+{
+    NodeTraits::destroy(nodeAlloc, n);
+    NodeTraits::deallocate(nodeAlloc, n, 1);
+}
+
+template <typename T, typename B, typename A, typename G> auto TreeList<T,B,A,G>::begin() -> iterator                 { return iterator(this, head);          }
+template <typename T, typename B, typename A, typename G> auto TreeList<T,B,A,G>::begin() const -> const_iterator     { return const_iterator(this, head);    }
+template <typename T, typename B, typename A, typename G> auto TreeList<T,B,A,G>::end() -> iterator                   { return iterator(this, nullptr);       }
+template <typename T, typename B, typename A, typename G> auto TreeList<T,B,A,G>::end() const -> const_iterator       { return const_iterator(this, nullptr); }
+
+template <typename T, typename B, typename A, typename G>
+auto TreeList<T,B,A,G>::erase(const iterator& i) -> iterator
 {
     Node* out = i.node->next;
 
@@ -68,17 +96,27 @@ auto TreeList<T>::erase(const iterator& i) -> iterator
     Node* l = i.node->left;
     Node* r = i.node->right;
 
+    // 'fix' is the node that ends up in the position that was actually vacated (possibly null), and
+    //   'fixparent' is its parent.  The balancing policy needs these to repair the tree afterward.
+    Node* fix = nullptr;
+    Node* fixparent = i.node->parent;
+    auto  st = B::eraseState(i.node);
+
     if(l && r)          // we have two children!  take the rightmost left child (which is 'prev')
     {
         newme = i.node->prev;
+        st = B::eraseState(newme);
+        fix = newme->left;
         // 'newme' by definition can't have a right child, because it's the rightmost left child of this node
         if(newme == l)      // rightmost left child was our direct left child
         {
+            fixparent = newme;
             newme->parent = i.node->parent;
             newme->right = r;
         }
         else                // it was some descendent
         {
+            fixparent = newme->parent;
             // newme must have been the right child of its parent
             newme->parent->right = newme->left;
             if(newme->left)     newme->left->parent = newme->parent;
@@ -88,30 +126,58 @@ auto TreeList<T>::erase(const iterator& i) -> iterator
         if(newme->left)             // it's possible for the newme to not have a left if it's our direct child
             newme->left->parent = newme;
         newme->right->parent = newme;
+        B::inherit(newme, i.node);
     }
     else if(l)          // only 1 child
-        newme = l;
+        newme = fix = l;
     else if(r)
-        newme = r;
+        newme = fix = r;
 
     // adjust the parent
     if(newme)       newme->parent = i.node->parent;
     *mech = newme;
 
+    propagate(fixparent);
+    B::afterErase(*this, fix, fixparent, st);
+
     --numNodes;
-    delete i.node;
+    destroyNode(i.node);
     return iterator(this, out);
 }
 
-template <typename T> void TreeList<T>::insert(const T& obj)    { internalInsert(new Node(obj));            }
-template <typename T> void TreeList<T>::insert(T&& obj)         { internalInsert(new Node(std::move(obj))); }
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::checkRoom(std::size_t k) const
+{
+    if(k > G::maxSize - numNodes)
+        throw std::length_error("TreeList can't hold more than " + std::to_string(G::maxSize) + " elements");
+}
+
+template <typename T, typename B, typename A, typename G>
+auto TreeList<T,B,A,G>::insert(const T& obj) -> iterator
+{
+    checkRoom(1);
+    Node* n = createNode(obj);
+    internalInsert(n);
+    return iterator(this, n);
+}
+
+template <typename T, typename B, typename A, typename G>
+auto TreeList<T,B,A,G>::insert(T&& obj) -> iterator
+{
+    checkRoom(1);
+    Node* n = createNode(std::move(obj));
+    internalInsert(n);
+    return iterator(this, n);
+}
 
-template <typename T> void TreeList<T>::internalInsert(Node* n)
+template <typename T, typename B, typename A, typename G> void TreeList<T,B,A,G>::internalInsert(Node* n)
 {
     ++numNodes;
     if(!root)
     {
         root = head = n;
+        propagate(n);
+        B::afterInsert(*this, n);
         return;
     }
 
@@ -152,11 +218,420 @@ template <typename T> void TreeList<T>::internalInsert(Node* n)
 
     if(!n->prev)
         head = n;
+
+    propagate(n);
+    B::afterInsert(*this, n);
 }
 
-template <typename T>
+template <typename T, typename B, typename A, typename G>
+template <typename ForwardIt>
+void TreeList<T,B,A,G>::insert_bulk(ForwardIt first, ForwardIt last)
+{
+    static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<ForwardIt>::iterator_category>::value,
+                  "insert_bulk walks the range twice, so it needs forward iterators");
+
+    auto k = std::distance(first, last);
+    if(!worthRebuilding(k))
+    {
+        for(; first != last; ++first)
+            insert(*first);
+        return;
+    }
+
+    checkRoom(k);
+    std::vector<Node*> added;
+    createNodes(first, last, added);
+    linkBulk(added);
+}
+
+template <typename T, typename B, typename A, typename G>
+template <typename ForwardIt, typename OutputIt>
+OutputIt TreeList<T,B,A,G>::insert_bulk(ForwardIt first, ForwardIt last, OutputIt positions)
+{
+    static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<ForwardIt>::iterator_category>::value,
+                  "insert_bulk walks the range twice, so it needs forward iterators");
+
+    auto k = std::distance(first, last);
+    if(!worthRebuilding(k))
+    {
+        for(; first != last; ++first)
+            *positions++ = handle( insert(*first) );
+        return positions;
+    }
+
+    checkRoom(k);
+    std::vector<Node*> added;
+    createNodes(first, last, added);
+
+    std::vector<Node*> inorder(added);      // linkBulk sorts what it's given
+    linkBulk(inorder);
+
+    for(auto n : added)
+        *positions++ = handle_type(n);
+    return positions;
+}
+
+template <typename T, typename B, typename A, typename G>
+const std::ptrdiff_t TreeList<T,B,A,G>::BulkMinBatch;
+
+// Rebuilding touches every node already in the tree, and has to set up some scratch space.  If
+//   the batch is small, or small next to the tree, k descents of ~log n each are cheaper.
+template <typename T, typename B, typename A, typename G>
+bool TreeList<T,B,A,G>::worthRebuilding(std::ptrdiff_t k) const
+{
+    if(k < BulkMinBatch)
+        return false;
+
+    std::size_t depth = 1;
+    while(((numNodes + k) >> depth) != 0)
+        ++depth;
+    return k * depth >= numNodes;
+}
+
+template <typename T, typename B, typename A, typename G>
+template <typename ForwardIt>
+void TreeList<T,B,A,G>::createNodes(ForwardIt first, ForwardIt last, std::vector<Node*>& out)
+{
+    try
+    {
+        for(; first != last; ++first)
+            out.push_back( createNode(*first) );
+    }
+    catch(...)
+    {
+        for(auto n : out)
+            destroyNode(n);
+        throw;
+    }
+}
+
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::linkBulk(std::vector<Node*>& added)
+{
+    std::size_t total = numNodes + added.size();
+
+    int maxDepth = 0;                       // floor(log2(total)):  the depth of the rebuilt tree
+    while((total >> (maxDepth + 1)) != 0)
+        ++maxDepth;
+
+    sortNodes(added);
+
+    // Merge with the existing list.  Ties go to the existing node first, same as insert does.
+    std::vector<Node*> all;
+    all.reserve(total);
+    Node* old = head;
+    auto a = added.begin();
+    while(old || a != added.end())
+    {
+        if(a == added.end() || (old && !((*a)->obj < old->obj)))
+        {
+            all.push_back(old);
+            old = old->next;
+        }
+        else
+            all.push_back(*a++);
+    }
+
+    // rethread the list
+    for(std::size_t i = 0; i < total; ++i)
+    {
+        all[i]->prev = i > 0 ? all[i-1] : nullptr;
+        all[i]->next = i + 1 < total ? all[i+1] : nullptr;
+    }
+    head = all[0];
+    root = buildTree(all.data(), total, nullptr, 0, maxDepth);
+    numNodes = total;
+}
+
+// Stable so that equal elements keep the order they were given in.  Big batches are cut into
+//   one piece per core, sorted in parallel, and merged back together.
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::sortNodes(std::vector<Node*>& nodes)
+{
+    static const std::size_t    ParallelMin = 1 << 15;      // smaller than this isn't worth starting threads for
+    static const unsigned       MaxThreads = 8;
+
+    auto less = [](const Node* a, const Node* b) { return a->obj < b->obj; };
+    if(std::is_sorted(nodes.begin(), nodes.end(), less))     // already in order (restoring a checkpoint):  O(n)
+        return;
+
+    unsigned pieces = 1;
+    if(nodes.size() >= ParallelMin)     // (asking for the core count is a system call, so only do it when it matters)
+        pieces = std::min(std::thread::hardware_concurrency(), MaxThreads);
+    if(pieces < 2)
+    {
+        std::stable_sort(nodes.begin(), nodes.end(), less);
+        return;
+    }
+
+    std::vector<std::size_t> bounds;
+    for(unsigned i = 0; i <= pieces; ++i)
+        bounds.push_back(nodes.size() * i / pieces);
+
+    std::vector<std::thread> workers;
+    for(unsigned i = 1; i < pieces; ++i)
+        workers.emplace_back([&, i]() { std::stable_sort(nodes.begin() + bounds[i], nodes.begin() + bounds[i+1], less); });
+    std::stable_sort(nodes.begin(), nodes.begin() + bounds[1], less);
+    for(auto& w : workers)
+        w.join();
+
+    for(unsigned i = 1; i < pieces; ++i)
+        std::inplace_merge(nodes.begin(), nodes.begin() + bounds[i], nodes.begin() + bounds[i+1], less);
+}
+
+// Midpoint of the range at the root, each half below it, so the two sides never differ in size
+//   by more than one node.
+template <typename T, typename B, typename A, typename G>
+auto TreeList<T,B,A,G>::buildTree(Node** nodes, std::size_t count, Node* parent, int depth, int maxDepth) -> Node*
+{
+    if(!count)          return nullptr;
+
+    std::size_t mid = count / 2;
+    Node* n = nodes[mid];
+    n->parent = parent;
+    n->left = buildTree(nodes, mid, n, depth + 1, maxDepth);
+    n->right = buildTree(nodes + mid + 1, count - mid - 1, n, depth + 1, maxDepth);
+
+    B::afterBuild(n, depth, maxDepth);
+    G::update(n);
+    return n;
+}
+
+// Rotations only change the tree links -- the in-order sequence (and therefore the prev/next
+//   threading) is the same before and after.
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::rotateLeft(Node* n)
+{
+    Node* r = n->right;
+    n->right = r->left;
+    if(r->left)                     r->left->parent = n;
+
+    r->parent = n->parent;
+    if(!n->parent)                  root = r;
+    else if(n->parent->left == n)   n->parent->left = r;
+    else                            n->parent->right = r;
+
+    r->left = n;
+    n->parent = r;
+
+    // 'n' is now below 'r', so it has to be refreshed first.  Nothing above changes, the subtree
+    //   as a whole holds the same elements as before.
+    G::update(n);
+    G::update(r);
+}
+
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::rotateRight(Node* n)
+{
+    Node* l = n->left;
+    n->left = l->right;
+    if(l->right)                    l->right->parent = n;
+
+    l->parent = n->parent;
+    if(!n->parent)                  root = l;
+    else if(n->parent->right == n)  n->parent->right = l;
+    else                            n->parent->left = l;
+
+    l->right = n;
+    n->parent = l;
+
+    G::update(n);
+    G::update(l);
+}
+
+template <typename T, typename B, typename A, typename G>
+inline void TreeList<T,B,A,G>::propagate(Node* n)
+{
+    if(!G::enabled)     return;
+    for(; n; n = n->parent)
+        G::update(n);
+}
+
+template <typename T, typename B, typename A, typename G>
+template <typename Pred>
+auto TreeList<T,B,A,G>::findNext(const iterator& from, Pred pred) -> iterator
+{
+    Node* n = from.node;
+    if(!n)                                              return end();
+    if(pred(G::value(n->obj)))                          return iterator(this, n);
+    if(n->right && pred(G::summary(n->right)))
+    {
+        if(Node* m = firstMatch(n->right, pred))        return iterator(this, m);
+    }
+
+    // Everything after 'n' that isn't in its right subtree is in some ancestor that we reach from
+    //   the left (and in that ancestor's right subtree)
+    for(; n->parent; n = n->parent)
+    {
+        Node* p = n->parent;
+        if(p->left != n)                                continue;
+        if(pred(G::value(p->obj)))                      return iterator(this, p);
+        if(p->right && pred(G::summary(p->right)))
+        {
+            if(Node* m = firstMatch(p->right, pred))    return iterator(this, m);
+        }
+    }
+    return end();
+}
+
+template <typename T, typename B, typename A, typename G>
+auto TreeList<T,B,A,G>::summarizeFrom(const Node* n) const -> typename G::value_type
+{
+    // 'n' itself and its right subtree, then every ancestor we reach from the left (with its
+    //   right subtree) -- the same path findNext takes
+    auto sum = G::value(n->obj);
+    if(n->right)    sum = G::combine(sum, G::summary(n->right));
+
+    for(; n->parent; n = n->parent)
+    {
+        const Node* p = n->parent;
+        if(p->left != n)        continue;
+        sum = G::combine(sum, G::value(p->obj));
+        if(p->right)            sum = G::combine(sum, G::summary(p->right));
+    }
+    return sum;
+}
+
+template <typename T, typename B, typename A, typename G>
+template <typename Pred, typename Sum>
+auto TreeList<T,B,A,G>::findPrefix(Pred pred, Sum& sum) -> iterator
+{
+    // 'acc' is the summary of everything before the subtree at 'n' ('have' is false while that's
+    //   nothing yet).  If the prefix ends in the left subtree, go left; otherwise take in the left
+    //   subtree and 'n', and go right.
+    typename G::value_type acc = typename G::value_type();
+    bool have = false;
+
+    Node* n = root;
+    while(n)
+    {
+        if(n->left)
+        {
+            auto withleft = have ? G::combine(acc, G::summary(n->left)) : G::summary(n->left);
+            if(pred(withleft))
+            {
+                n = n->left;
+                continue;
+            }
+            acc = withleft;
+            have = true;
+        }
+
+        auto here = have ? G::combine(acc, G::value(n->obj)) : G::value(n->obj);
+        if(pred(here))
+        {
+            sum = here;
+            return iterator(this, n);
+        }
+        acc = here;
+        have = true;
+        n = n->right;
+    }
+    return end();
+}
+
+template <typename T, typename B, typename A, typename G>
+std::size_t TreeList<T,B,A,G>::rankOf(const Node* n) const
+{
+    if(!n)          return numNodes;        // end()
+
+    // everything in the left subtree, then every ancestor we reach from the right (with its left subtree)
+    std::size_t r = G::count(n->left);
+    for(; n->parent; n = n->parent)
+    {
+        if(n->parent->right == n)
+            r += G::count(n->parent->left) + 1;
+    }
+    return r;
+}
+
+template <typename T, typename B, typename A, typename G>
+auto TreeList<T,B,A,G>::nthNode(std::size_t k) const -> Node*
+{
+    if(k >= numNodes)               return nullptr;
+
+    Node* n = root;
+    for(;;)
+    {
+        std::size_t left = G::count(n->left);
+        if(k == left)               return n;
+        if(k < left)                n = n->left;
+        else
+        {
+            k -= left + 1;
+            n = n->right;
+        }
+    }
+}
+
+// Matches before 'n' (in the whole list, for end()):  the same path as rankOf, but counting only
+//   the elements that satisfy 'pred'
+template <typename T, typename B, typename A, typename G>
+template <typename Pred, typename Whole>
+std::size_t TreeList<T,B,A,G>::countBefore(const Node* n, Pred& pred, Whole& whole) const
+{
+    if(!n)          return countMatches(root, pred, whole);
+
+    std::size_t c = countMatches(n->left, pred, whole);
+    for(; n->parent; n = n->parent)
+    {
+        const Node* p = n->parent;
+        if(p->right != n)           continue;
+        c += countMatches(p->left, pred, whole);
+        if(pred(G::value(p->obj)))  ++c;
+    }
+    return c;
+}
+
+template <typename T, typename B, typename A, typename G>
+template <typename Pred, typename Whole>
+std::size_t TreeList<T,B,A,G>::countMatches(const Node* n, Pred& pred, Whole& whole) const
+{
+    if(!n || !pred(G::summary(n)))  return 0;
+    if(whole(G::summary(n)))        return G::count(n);
+    return countMatches(n->left, pred, whole) + (pred(G::value(n->obj)) ? 1 : 0) + countMatches(n->right, pred, whole);
+}
+
+// First match (in order) within the subtree at 'top', whose summary passed (null if nothing in it
+//   does).  With an exact 'pred' this is a single walk down; a loose one can send it down a
+//   subtree with no match, and then it climbs back out and carries on to the right.
+template <typename T, typename B, typename A, typename G>
+template <typename Pred>
+auto TreeList<T,B,A,G>::firstMatch(Node* top, Pred& pred) -> Node*
+{
+    Node* n = top;
+    while(true)
+    {
+        if(n->left && pred(G::summary(n->left)))
+        {
+            n = n->left;
+            continue;
+        }
+
+        // nothing left of 'n':  try 'n', then its right subtree, then the ancestors we climb to from the left
+        while(true)
+        {
+            if(pred(G::value(n->obj)))                  return n;
+            if(n->right && pred(G::summary(n->right)))
+            {
+                n = n->right;
+                break;
+            }
+
+            Node* from;
+            do
+            {
+                if(n == top)                            return nullptr;
+                from = n;
+                n = n->parent;
+            } while(n->left != from);
+        }
+    }
+}
+
+template <typename T, typename B, typename A, typename G>
 template <typename iter_t, typename node_t>
-iter_t TreeList<T>::internalFind(node_t* node, const T& v) const
+iter_t TreeList<T,B,A,G>::internalFind(node_t* node, const T& v) const
 {
     if(!node)               return iter_t(this, nullptr);
     if(v < node->obj)       return internalFind<iter_t>(node->left, v);
@@ -165,10 +640,24 @@ iter_t TreeList<T>::internalFind(node_t* node, const T& v) const
     return iter_t(this, node);
 }
 
+template <typename T, typename B, typename A, typename G>
+template <typename iter_t, typename node_t>
+iter_t TreeList<T,B,A,G>::internalBound(node_t* node, const T& v, bool upper) const
+{
+    node_t* best = nullptr;
+    while(node)
+    {
+        bool after = upper ? (v < node->obj) : !(node->obj < v);
+        if(after)       { best = node;  node = node->left;      }
+        else            {               node = node->right;     }
+    }
+    return iter_t(this, best);
+}
+
 //////////////////////////////////////////////
 //////////////////////////////////////////////
-template <typename T>
-void TreeList<T>::validate() const
+template <typename T, typename B, typename A, typename G>
+void TreeList<T,B,A,G>::validate() const
 {
     if(!root != !head)          throw std::runtime_error("Head/Root mismatch");
     if(!root)                   return;
@@ -178,10 +667,15 @@ void TreeList<T>::validate() const
 
     if(treecount != listcount)
         throw std::runtime_error("treecount / listcount mismatch");
+    if(static_cast<std::size_t>(treecount) != numNodes)
+        throw std::runtime_error("treecount / numNodes mismatch");
+
+    B::validateNode(root);      // balance invariants (if any)
+    G::validateNode(root);      // augmented data (if any)
 }
 
-template <typename T>
-int TreeList<T>::validateTree(const Node* n, int rec) const
+template <typename T, typename B, typename A, typename G>
+int TreeList<T,B,A,G>::validateTree(const Node* n, int rec) const
 {
     if(rec <= 0)                    throw std::runtime_error("Tree recursive counter expired. Possible infinite loop");
     if(!n)                          return 0;
@@ -201,8 +695,8 @@ int TreeList<T>::validateTree(const Node* n, int rec) const
     return validateTree(n->left, rec-1) + validateTree(n->right, rec-1) + 1;
 }
 
-template <typename T>
-int TreeList<T>::validateList(const Node* n, int rec) const
+template <typename T, typename B, typename A, typename G>
+int TreeList<T,B,A,G>::validateList(const Node* n, int rec) const
 {
     if(rec <= 0)                    throw std::runtime_error("List recursive counter expired. Possible infinite loop");
     if(!n)                          return 0;
@@ -0,0 +1,81 @@
+
+//  Augmentation policies for TreeList.
+//
+//  An augmentation keeps a summary of every subtree in its root node, which lets TreeList answer
+//  "first element after X whose <something> matches" queries in O(log n) by skipping whole
+//  subtrees whose summary can't match (see TreeList::findNext).  Every augmented node also
+//  counts the elements in its subtree, which is what TreeList::rank and nth go by.
+//
+//  A policy supplies per-node data ('NodeData', which Node inherits from), and 'update', which
+//  recomputes a node's summary from its own element and its children's summaries.  TreeList
+//  calls it on every node whose subtree changes.  'maxSize' is the most elements the per-node
+//  data can count; TreeList won't grow past it.
+
+#include <cstddef>
+#include <cstdint>
+
+// No augmentation.  Costs nothing.
+struct TreeListNoAugment
+{
+    typedef void        value_type;     // nothing to summarize
+    static const bool   enabled = false;
+    static const std::size_t    maxSize = static_cast<std::size_t>(-1);
+    struct NodeData {};
+
+    template <typename Node>    static void update(Node*)       {}
+    template <typename Node>    static void validateNode(const Node*)   {}
+};
+
+//  Summarizes each subtree by folding a value taken from every element with an associative
+//  'combine'.  'Traits' must provide:
+//      typedef ... value_type;
+//      static value_type value(const T& obj);
+//      static value_type combine(const value_type& a, const value_type& b);
+template <typename Traits>
+struct TreeListAggregate
+{
+    typedef typename Traits::value_type     value_type;
+
+    static const bool   enabled = true;
+    static const std::size_t    maxSize = UINT32_MAX;
+    struct NodeData
+    {
+        value_type      agg;
+        std::uint32_t   count;          // elements in the subtree (32 bits fits in what would be padding)
+    };
+
+    template <typename Node>
+    static void update(Node* n)
+    {
+        value_type v = Traits::value(n->obj);
+        if(n->left)     v = Traits::combine(n->left->agg, v);
+        if(n->right)    v = Traits::combine(v, n->right->agg);
+        n->agg = v;
+        n->count = static_cast<std::uint32_t>(count(n->left) + 1 + count(n->right));
+    }
+
+    // Throws if any summary in the subtree at 'n' is stale
+    template <typename Node>
+    static void validateNode(const Node* n)
+    {
+        if(!n)          return;
+        validateNode(n->left);
+        validateNode(n->right);
+
+        value_type v = Traits::value(n->obj);
+        if(n->left)     v = Traits::combine(n->left->agg, v);
+        if(n->right)    v = Traits::combine(v, n->right->agg);
+        if(!(v == n->agg))
+            throw std::runtime_error("Augmented node data is out of date");
+        if(n->count != count(n->left) + 1 + count(n->right))
+            throw std::runtime_error("Subtree size is out of date");
+    }
+
+    template <typename T>
+    static value_type           value(const T& obj)             { return Traits::value(obj);    }
+    static value_type           combine(const value_type& a, const value_type& b)   { return Traits::combine(a, b); }
+    template <typename Node>
+    static const value_type&    summary(const Node* n)          { return n->agg;                }
+    template <typename Node>
+    static std::size_t          count(const Node* n)            { return n ? n->count : 0;      }
+};
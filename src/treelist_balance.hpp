@@ -0,0 +1,207 @@
+
+//  Balancing policies for TreeList.
+//
+//  A policy supplies any extra per-node data it needs ('NodeData', which Node inherits from),
+//  and hooks that are called by TreeList after a node has been linked into the tree or
+//  unlinked from it, or after the whole tree has been rebuilt (insert_bulk).  The prev/next threading is never touched by a policy -- rotations don't
+//  change the in-order sequence, so the list stays valid no matter what the policy does.
+
+// The original behavior:  a plain BST.  Insertion is O(n) worst case if items arrive in order.
+struct TreeListUnbalanced
+{
+    struct NodeData {};
+    struct EraseState {};
+
+    template <typename Node>    static EraseState   eraseState(const Node*)                     { return EraseState();  }
+    template <typename Node>    static void         inherit(Node*, const Node*)                 {}
+
+    template <typename Tree, typename Node>
+    static void afterInsert(Tree&, Node*)                                                       {}
+    template <typename Tree, typename Node>
+    static void afterErase(Tree&, Node*, Node*, EraseState)                                     {}
+    template <typename Node>    static void         afterBuild(Node*, int, int)                 {}
+
+    template <typename Node>    static int          validateNode(const Node*)                   { return 0;             }
+};
+
+// Red-black balancing.  Insertion is O(log n) worst case.  Erase stays O(1) amortized -- the
+//   fixup does at most 3 rotations and the recoloring walk up the tree is amortized constant.
+struct TreeListRedBlack
+{
+    struct NodeData
+    {
+        bool    red = true;
+    };
+    struct EraseState
+    {
+        bool    removedRed;
+    };
+
+    template <typename Node>
+    static bool isRed(const Node* n)        { return n && n->red;       }
+
+    // the color that is being removed from the tree when 'n' is pulled out of its position
+    template <typename Node>
+    static EraseState eraseState(const Node* n)
+    {
+        EraseState st;
+        st.removedRed = n->red;
+        return st;
+    }
+
+    // 'dst' is taking 'src's position in the tree, so it takes its color as well
+    template <typename Node>
+    static void inherit(Node* dst, const Node* src)     { dst->red = src->red;  }
+
+    // A rebuilt tree is as short as possible, so every path from the root to a null child has
+    //   'maxDepth' or 'maxDepth+1' nodes on it.  Making the deepest level red (and everything
+    //   else black) evens out the black height.
+    template <typename Node>
+    static void afterBuild(Node* n, int depth, int maxDepth)    { n->red = (depth > 0 && depth == maxDepth);    }
+
+    template <typename Tree, typename Node>
+    static void afterInsert(Tree& tree, Node* n)
+    {
+        n->red = true;
+        Node* p;
+        while((p = n->parent) && p->red)
+        {
+            // 'p' is red, so it can't be the root -- 'g' must exist
+            Node* g = p->parent;
+            if(p == g->left)
+            {
+                Node* u = g->right;
+                if(isRed(u))
+                {
+                    p->red = u->red = false;
+                    g->red = true;
+                    n = g;
+                    continue;
+                }
+                if(n == p->right)
+                {
+                    n = p;
+                    tree.rotateLeft(n);
+                    p = n->parent;
+                }
+                p->red = false;
+                g->red = true;
+                tree.rotateRight(g);
+            }
+            else
+            {
+                Node* u = g->left;
+                if(isRed(u))
+                {
+                    p->red = u->red = false;
+                    g->red = true;
+                    n = g;
+                    continue;
+                }
+                if(n == p->left)
+                {
+                    n = p;
+                    tree.rotateRight(n);
+                    p = n->parent;
+                }
+                p->red = false;
+                g->red = true;
+                tree.rotateLeft(g);
+            }
+        }
+        tree.root->red = false;
+    }
+
+    // 'x' is the node that moved into the removed position (possibly null), 'xp' is its parent
+    template <typename Tree, typename Node>
+    static void afterErase(Tree& tree, Node* x, Node* xp, EraseState st)
+    {
+        if(st.removedRed)           return;     // removing a red node never breaks anything
+
+        while(x != tree.root && !isRed(x))
+        {
+            if(x == xp->left)
+            {
+                Node* w = xp->right;            // sibling can't be null, it has a black height of at least 1
+                if(w->red)
+                {
+                    w->red = false;
+                    xp->red = true;
+                    tree.rotateLeft(xp);
+                    w = xp->right;
+                }
+                if(!isRed(w->left) && !isRed(w->right))
+                {
+                    w->red = true;
+                    x = xp;
+                    xp = x->parent;
+                }
+                else
+                {
+                    if(!isRed(w->right))
+                    {
+                        w->left->red = false;
+                        w->red = true;
+                        tree.rotateRight(w);
+                        w = xp->right;
+                    }
+                    w->red = xp->red;
+                    xp->red = false;
+                    w->right->red = false;
+                    tree.rotateLeft(xp);
+                    x = tree.root;
+                }
+            }
+            else
+            {
+                Node* w = xp->left;
+                if(w->red)
+                {
+                    w->red = false;
+                    xp->red = true;
+                    tree.rotateRight(xp);
+                    w = xp->left;
+                }
+                if(!isRed(w->left) && !isRed(w->right))
+                {
+                    w->red = true;
+                    x = xp;
+                    xp = x->parent;
+                }
+                else
+                {
+                    if(!isRed(w->left))
+                    {
+                        w->right->red = false;
+                        w->red = true;
+                        tree.rotateLeft(w);
+                        w = xp->left;
+                    }
+                    w->red = xp->red;
+                    xp->red = false;
+                    w->left->red = false;
+                    tree.rotateRight(xp);
+                    x = tree.root;
+                }
+            }
+        }
+        if(x)       x->red = false;
+    }
+
+    // For debugging.  Returns the black height of the subtree at 'n', throws if the
+    //   red-black rules are broken.
+    template <typename Node>
+    static int validateNode(const Node* n)
+    {
+        if(!n)                                          return 1;
+        if(!n->parent && n->red)                        throw std::runtime_error("Root node is red");
+        if(n->red && (isRed(n->left) || isRed(n->right)))
+            throw std::runtime_error("Red node has a red child");
+
+        int lh = validateNode(n->left);
+        int rh = validateNode(n->right);
+        if(lh != rh)                                    throw std::runtime_error("Black height mismatch");
+
+        return lh + (n->red ? 0 : 1);
+    }
+};
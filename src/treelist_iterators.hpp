@@ -1,7 +1,7 @@
 
 
-template<typename T>
-class TreeList<T>::iterator
+template<typename T, typename B, typename A, typename G>
+class TreeList<T,B,A,G>::iterator
 {
 public:
     iterator() = default;
@@ -19,16 +19,16 @@ public:
     const T* operator -> () const       { return &node->obj;   }
 
 private:
-    typedef TreeList<T>         Host;
+    typedef TreeList<T,B,A,G>   Host;
     typedef typename Host::Node Node;
-    friend class TreeList<T>;
+    friend class TreeList<T,B,A,G>;
     iterator(const Host* h, Node* n) : host(h), node(n) {}
     const Host* host = nullptr;
     Node*       node = nullptr;
 };
 
-template<typename T>
-class TreeList<T>::const_iterator
+template<typename T, typename B, typename A, typename G>
+class TreeList<T,B,A,G>::const_iterator
 {
 public:
     const_iterator() = default;
@@ -43,10 +43,43 @@ public:
     const T* operator -> () const       { return &node->obj;   }
 
 private:
-    typedef TreeList<T>         Host;
+    typedef TreeList<T,B,A,G>   Host;
     typedef typename Host::Node Node;
-    friend class TreeList<T>;
+    friend class TreeList<T,B,A,G>;
     const_iterator(const Host* h, const Node* n) : host(h), node(n) {}
     const Host* host = nullptr;
     const Node* node = nullptr;
 };
+
+template<typename T, typename B, typename A, typename G>
+class TreeList<T,B,A,G>::handle_type
+{
+public:
+    handle_type() = default;
+    bool operator == (const handle_type& rhs) const     { return node == rhs.node;  }
+    bool operator != (const handle_type& rhs) const     { return node != rhs.node;  }
+
+private:
+    typedef typename TreeList<T,B,A,G>::Node Node;
+    friend class TreeList<T,B,A,G>;
+    explicit handle_type(Node* n) : node(n) {}
+    Node*       node = nullptr;
+};
+
+template<typename T, typename B, typename A, typename G>
+inline auto TreeList<T,B,A,G>::handle(const iterator& i) const -> handle_type
+{
+    return handle_type(i.node);
+}
+
+template<typename T, typename B, typename A, typename G>
+inline T& TreeList<T,B,A,G>::get(handle_type h)
+{
+    return h.node->obj;
+}
+
+template<typename T, typename B, typename A, typename G>
+inline const T& TreeList<T,B,A,G>::get(handle_type h) const
+{
+    return h.node->obj;
+}
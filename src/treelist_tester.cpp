@@ -2,27 +2,62 @@
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <cstdlib>
 #include <ctime>
 #include "treelist.h"
+#include "blocklist.h"
 
 using namespace std;
 
 static const int iterations = 200;      // number of tests to perform
 static const int testsize = 100;        // number of elements in each test
 
-TreeList<int> buildTree(unsigned seed)
+// the order elements are fed into the tree
+enum class Workload
+{
+    Random,
+    Sorted,             // already in order -- the worst case for an unbalanced tree
+    ReverseSorted
+};
+
+static const char* workloadName(Workload w)
+{
+    switch(w)
+    {
+    case Workload::Random:          return "random";
+    case Workload::Sorted:          return "sorted";
+    case Workload::ReverseSorted:   return "reverse";
+    }
+    return "?";
+}
+
+template <typename Tree>
+Tree buildTree(unsigned seed, Workload w)
 {
     srand(seed);
 
-    TreeList<int>   x;
+    std::vector<int> values;
     for(int i = 0; i < testsize; ++i)
-        x.insert( rand() );
+        values.push_back( rand() );
+
+    if(w == Workload::Sorted)               std::sort(values.begin(), values.end());
+    if(w == Workload::ReverseSorted)        std::sort(values.begin(), values.end(), std::greater<int>());
+
+    Tree x;
+    for(auto& v : values)
+    {
+        x.insert(v);
+        x.validate();
+    }
 
     return x;
 }
 
-void eraseElement(TreeList<int>& x, int index)
+template <typename Tree>
+void eraseElement(Tree& x, int index)
 {
     auto i = x.begin();
     while(index > 0)
@@ -33,37 +68,406 @@ void eraseElement(TreeList<int>& x, int index)
     x.erase(i);
 }
 
-int main()
+// Subtree minimum, for exercising TreeListAggregate / findNext
+struct MinValue
 {
-    srand((unsigned)time(nullptr));
+    typedef int     value_type;
+    static int      value(int v)                { return v;                 }
+    static int      combine(int a, int b)       { return std::min(a, b);    }
+};
 
-    std::vector<unsigned> seeds;
-    seeds.reserve(iterations);
-    for(int i = 0; i < iterations; ++i)
-        seeds.push_back( rand() );
+// The smallest of two unrelated parts of each element (its low and high 16 bits), which may come
+//   from different elements -- so a test on both is only a bound for findNext, not exact
+struct MinHalves
+{
+    struct value_type
+    {
+        int         lo;
+        int         hi;
 
-    for(auto& seed : seeds)
+        bool operator == (const value_type& rhs) const  { return lo == rhs.lo && hi == rhs.hi;  }
+    };
+    static value_type   value(int v)                            { return value_type{v & 0xFFFF, (v >> 16) & 0x7FFF};     }
+    static value_type   combine(value_type a, value_type b)     { return value_type{std::min(a.lo, b.lo), std::min(a.hi, b.hi)};   }
+};
+
+// Smallest and largest element, for countIf with a 'whole' test
+struct RangeValue
+{
+    struct value_type
+    {
+        int         lo;
+        int         hi;
+
+        bool operator == (const value_type& rhs) const  { return lo == rhs.lo && hi == rhs.hi;  }
+    };
+    static value_type   value(int v)                            { return value_type{v, v};     }
+    static value_type   combine(value_type a, value_type b)     { return value_type{std::min(a.lo, b.lo), std::max(a.hi, b.hi)};   }
+};
+
+// Sum of every element, for exercising findPrefix
+struct SumValue
+{
+    typedef long long   value_type;
+    static long long    value(int v)                        { return v;         }
+    static long long    combine(long long a, long long b)   { return a + b;     }
+};
+
+// Checks findPrefix against running sums, for a random target
+template <typename Tree>
+void checkFindPrefix(Tree& x)
+{
+    long long total = 0;
+    for(auto& i : x)
+        total += i;
+    long long target = total ? (static_cast<long long>(rand()) * rand()) % (total + 1) : 0;
+    auto pred = [target](long long sum) { return sum >= target; };
+
+    auto expect = x.end();
+    long long running = 0;
+    for(auto i = x.begin(); i != x.end(); ++i)
+    {
+        running += *i;
+        if(pred(running))
+        {
+            expect = i;
+            break;
+        }
+    }
+
+    long long sum = -1;
+    auto found = x.findPrefix(pred, sum);
+    if(found != expect || (found != x.end() && sum != running))
+        throw std::runtime_error("findPrefix disagrees with a linear scan");
+    if(x.findPrefix([total](long long s) { return s > total; }, sum) != x.end())
+        throw std::runtime_error("findPrefix found a prefix bigger than the whole list");
+}
+
+// Checks findNext with a loose predicate against a plain walk of the list
+template <typename Tree>
+void checkFindNextLoose(Tree& x)
+{
+    if(x.empty())       return;
+
+    auto from = x.begin();
+    for(int skip = rand() % x.size(); skip > 0; --skip)
+        ++from;
+
+    int lo = rand() & 0xFFFF;
+    int hi = rand() & 0x7FFF;
+    auto pred = [lo, hi](MinHalves::value_type s) { return s.lo <= lo && s.hi <= hi; };
+
+    auto expect = from;
+    while(expect != x.end() && !pred(MinHalves::value(*expect)))
+        ++expect;
+
+    if(x.findNext(from, pred) != expect)
+        throw std::runtime_error("findNext with a loose predicate disagrees with a linear scan");
+}
+
+// Checks findNext against a plain walk of the list, for a random start and threshold
+template <typename Tree>
+void checkFindNext(Tree& x)
+{
+    if(x.empty())       return;
+
+    auto from = x.begin();
+    for(int skip = rand() % x.size(); skip > 0; --skip)
+        ++from;
+
+    int limit = rand();
+    auto pred = [limit](int v) { return v <= limit; };
+
+    auto expect = from;
+    while(expect != x.end() && !pred(*expect))
+        ++expect;
+
+    if(x.findNext(from, pred) != expect)
+        throw std::runtime_error("findNext disagrees with a linear scan");
+
+    // the minimum of everything from 'from' on is the same thing as a suffix summary
+    int suffixmin = *from;
+    for(auto i = from; i != x.end(); ++i)
+        suffixmin = std::min(suffixmin, *i);
+    if(x.summarizeFrom(from) != suffixmin)
+        throw std::runtime_error("summarizeFrom disagrees with a linear scan");
+
+    // bounds, for a value that's in the tree
+    auto lower = x.begin();
+    while(*lower < *from)       ++lower;
+    auto upper = lower;
+    while(upper != x.end() && !(*from < *upper))    ++upper;
+    if(x.lower_bound(*from) != lower || x.upper_bound(*from) != upper)
+        throw std::runtime_error("lower_bound / upper_bound disagree with a linear scan");
+}
+
+// Checks rank, nth, count and countIf against positions found by walking the list
+template <typename Tree>
+void checkRank(Tree& x)
+{
+    std::size_t lo = rand() % (x.size() + 1);
+    std::size_t hi = lo + rand() % (x.size() - lo + 1);
+    auto first = x.end(), last = x.end();
+
+    int limit = rand();
+    auto pred = [limit](int v) { return v <= limit; };
+
+    std::size_t pos = 0, matches = 0;
+    for(auto i = x.begin(); i != x.end(); ++i, ++pos)
+    {
+        if(x.rank(i) != pos || x.nth(pos) != i)
+            throw std::runtime_error("rank / nth disagree with a linear scan");
+        if(pos == lo)       first = i;
+        if(pos == hi)       last = i;
+        if(pos >= lo && pos < hi && pred(*i))
+            ++matches;
+    }
+
+    if(x.rank(x.end()) != x.size() || x.nth(x.size()) != x.end() || x.nth(static_cast<std::size_t>(-1)) != x.end())
+        throw std::runtime_error("rank / nth are wrong at the end");
+    if(x.count(first, last) != hi - lo || x.countIf(first, last, pred) != matches)
+        throw std::runtime_error("count / countIf disagree with a linear scan");
+}
+
+// Checks countIf, counting subtrees whose largest element passes by their size, against a walk
+template <typename Tree>
+void checkCountWhole(Tree& x)
+{
+    std::size_t lo = rand() % (x.size() + 1);
+    std::size_t hi = lo + rand() % (x.size() - lo + 1);
+    int limit = rand();
+    auto pred = [limit](RangeValue::value_type s) { return s.lo <= limit; };
+    auto whole = [limit](RangeValue::value_type s) { return s.hi <= limit; };
+
+    std::size_t matches = 0, pos = 0;
+    for(auto i = x.begin(); i != x.end(); ++i, ++pos)
+    {
+        if(pos >= lo && pos < hi && *i <= limit)
+            ++matches;
+    }
+    if(x.countIf(x.nth(lo), x.nth(hi), pred, whole) != matches || x.countIf(x.nth(lo), x.nth(hi), pred) != matches)
+        throw std::runtime_error("countIf with a whole test disagrees with a linear scan");
+}
+
+template <typename Tree>
+bool runTest(unsigned seed, Workload w, const char* treename, void (*extraCheck)(Tree&) = nullptr)
+{
+    cout << "Beginning " << setw(10) << setfill(' ') << treename << " " << setw(7) << workloadName(w)
+         << " test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+    try
+    {
+        auto x = buildTree<Tree>(seed, w);
+        x.validate();
+
+        while(!x.empty())
+        {
+            if(extraCheck)      extraCheck(x);
+            eraseElement(x, rand() % x.size());
+            x.validate();
+        }
+
+        cout << "SUCCESS!" << endl;
+        return true;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return false;
+    }
+}
+
+// Builds a tree from several batches through insert_bulk.  Batch sizes vary so that some are
+//   inserted one at a time and some force a rebuild.
+template <typename Tree>
+bool runBulkTest(unsigned seed, const char* treename)
+{
+    cout << "Beginning " << setw(10) << setfill(' ') << treename << " " << setw(7) << "bulk"
+         << " test with seed (" << setw(10) << setfill(' ') << seed << "):  ";
+    try
     {
-        cout << "Beginning test with seed (" << setw(8) << setfill(' ') << seed << "):  ";
-        try
+        srand(seed);
+
+        Tree x;
+        std::vector<int> all;
+        for(int batch = 0; batch < 6; ++batch)
         {
-            auto x = buildTree(seed);
+            std::vector<int> values;
+            int count = (batch % 2) ? (rand() % 5 + 1) : (rand() % testsize + 1);
+            for(int i = 0; i < count; ++i)
+                values.push_back( rand() % 1000 );      // small range, so there are plenty of duplicates
+
+            std::vector<typename Tree::handle_type> positions;
+            x.insert_bulk(values.begin(), values.end(), std::back_inserter(positions));
             x.validate();
 
-            while(!x.empty())
+            for(int i = 0; i < count; ++i)
             {
-                eraseElement(x, rand() % x.size());
-                x.validate();
+                if(x.get(positions[i]) != values[i] || *x.locate(positions[i]) != values[i])
+                    throw std::runtime_error("insert_bulk returned the wrong position");
             }
+            all.insert(all.end(), values.begin(), values.end());
+        }
+
+        std::sort(all.begin(), all.end());
+        if(!std::equal(all.begin(), all.end(), x.begin()))
+            throw std::runtime_error("bulk built tree has the wrong contents");
 
-            cout << "SUCCESS!" << endl;
+        while(!x.empty())
+        {
+            eraseElement(x, rand() % x.size());
+            x.validate();
         }
-        catch(std::exception& e)
+
+        cout << "SUCCESS!" << endl;
+        return true;
+    }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return false;
+    }
+}
+
+// One batch big enough to take the parallel sort (if there's more than one core).  Too big for
+//   validate(), so this only checks the order.
+bool runLargeBulkTest()
+{
+    cout << "Beginning large bulk test:  ";
+
+    std::vector<int> values;
+    for(int i = 0; i < 100000; ++i)
+        values.push_back( rand() );
+
+    TreeList<int, TreeListRedBlack> x;
+    x.insert_bulk(values.begin(), values.end());
+
+    std::sort(values.begin(), values.end());
+    if(x.size() != values.size() || !std::equal(values.begin(), values.end(), x.begin()))
+    {
+        cout << "FAILED: bulk built tree has the wrong contents" << endl;
+        return false;
+    }
+
+    cout << "SUCCESS!" << endl;
+    return true;
+}
+
+// A BlockList big enough for several index levels, grown and shrunk at random (mostly from the
+//   front, like a wait queue), so index nodes split, merge and the root grows and shrinks.
+//   validate() is run every so often, with the full checks now and then.
+bool runDeepBlockTest()
+{
+    cout << "Beginning deep blocklist test:  ";
+    try
+    {
+        typedef BlockList<int, BlockListKeyIsValue<int>, PoolAllocator<int>, BlockListSummary<MinValue>> MinBlocks;
+        MinBlocks x;
+        std::vector<int> expect;
+
+        for(int round = 0; round < 3; ++round)
         {
-            cout << "FAILED: " << e.what() << endl;
-            break;
+            for(int op = 0; op < 30000; ++op)
+            {
+                int v = rand();
+                x.insert(v);
+                expect.insert(std::upper_bound(expect.begin(), expect.end(), v), v);
+                if(op % 3 == 2)
+                {
+                    int k = (rand() % 4) ? 0 : rand() % x.size();
+                    x.erase(x.nth(k));
+                    expect.erase(expect.begin() + k);
+                }
+                if(op % 1000 == 0)
+                    x.validate();
+            }
+
+            // and a batch big enough to repack everything
+            std::vector<int> batch;
+            for(int i = 0; i < 3000; ++i)
+                batch.push_back( rand() );
+            x.insert_bulk(batch.begin(), batch.end());
+            expect.insert(expect.end(), batch.begin(), batch.end());
+            std::stable_sort(expect.begin(), expect.end());
+
+            x.validate();
+            checkFindNext(x);
+            checkRank(x);
+
+            while(x.size() > static_cast<std::size_t>(round) * 1000)
+            {
+                int k = (rand() % 4) ? 0 : rand() % x.size();
+                x.erase(x.nth(k));
+                expect.erase(expect.begin() + k);
+                if(x.size() % 1000 == 0)
+                    x.validate();
+            }
+            if(x.size() != expect.size() || !std::equal(expect.begin(), expect.end(), x.begin()))
+                throw std::runtime_error("contents differ from a sorted vector");
         }
+
+        cout << "SUCCESS!" << endl;
+        return true;
     }
+    catch(std::exception& e)
+    {
+        cout << "FAILED: " << e.what() << endl;
+        return false;
+    }
+}
+
+int main()
+{
+    srand((unsigned)time(nullptr));
+
+    std::vector<unsigned> seeds;
+    seeds.reserve(iterations);
+    for(int i = 0; i < iterations; ++i)
+        seeds.push_back( rand() );
+
+    for(auto& seed : seeds)
+    {
+        // An unbalanced tree can't take sorted input at this size without tripping the
+        //   recursion guard in validate(), so it only gets the random workload.
+        if(!runTest<TreeList<int, TreeListUnbalanced>>(seed, Workload::Random, "unbalanced"))      return 1;
+
+        if(!runTest<TreeList<int, TreeListRedBlack>>(seed, Workload::Random, "red-black"))         return 1;
+        if(!runTest<TreeList<int, TreeListRedBlack>>(seed, Workload::Sorted, "red-black"))         return 1;
+        if(!runTest<TreeList<int, TreeListRedBlack>>(seed, Workload::ReverseSorted, "red-black"))  return 1;
+
+        typedef TreeList<int, TreeListRedBlack, PoolAllocator<int>, TreeListAggregate<MinValue>> MinTree;
+        if(!runTest<MinTree>(seed, Workload::Random, "rb-min", &checkFindNext<MinTree>))          return 1;
+        if(!runTest<MinTree>(seed, Workload::Sorted, "rb-min", &checkFindNext<MinTree>))          return 1;
+        if(!runTest<MinTree>(seed, Workload::Random, "rb-rank", &checkRank<MinTree>))             return 1;
+
+        typedef TreeList<int, TreeListRedBlack, PoolAllocator<int>, TreeListAggregate<MinHalves>> HalvesTree;
+        if(!runTest<HalvesTree>(seed, Workload::Random, "rb-halves", &checkFindNextLoose<HalvesTree>))  return 1;
+
+        typedef TreeList<int, TreeListRedBlack, PoolAllocator<int>, TreeListAggregate<RangeValue>> RangeTree;
+        if(!runTest<RangeTree>(seed, Workload::Random, "rb-range", &checkCountWhole<RangeTree>))  return 1;
+
+        typedef TreeList<int, TreeListRedBlack, PoolAllocator<int>, TreeListAggregate<SumValue>> SumTree;
+        if(!runTest<SumTree>(seed, Workload::Random, "rb-sum", &checkFindPrefix<SumTree>))        return 1;
+
+        if(!runBulkTest<TreeList<int, TreeListUnbalanced>>(seed, "unbalanced"))                     return 1;
+        if(!runBulkTest<TreeList<int, TreeListRedBlack>>(seed, "red-black"))                        return 1;
+        if(!runBulkTest<MinTree>(seed, "rb-min"))                                                   return 1;
+
+        typedef BlockList<int, BlockListKeyIsValue<int>, PoolAllocator<int>, BlockListSummary<MinValue>> MinBlocks;
+        if(!runTest<BlockList<int>>(seed, Workload::Random, "blocklist"))                           return 1;
+        if(!runTest<BlockList<int>>(seed, Workload::ReverseSorted, "blocklist"))                    return 1;
+        if(!runTest<MinBlocks>(seed, Workload::Random, "block-min", &checkFindNext<MinBlocks>))     return 1;
+        if(!runTest<MinBlocks>(seed, Workload::Random, "block-rank", &checkRank<MinBlocks>))       return 1;
+        if(!runBulkTest<MinBlocks>(seed, "block-min"))                                              return 1;
+
+        typedef BlockList<int, BlockListKeyIsValue<int>, PoolAllocator<int>, BlockListSummary<RangeValue>> RangeBlocks;
+        if(!runTest<RangeBlocks>(seed, Workload::Random, "block-range", &checkCountWhole<RangeBlocks>))  return 1;
+
+        typedef BlockList<int, BlockListKeyIsValue<int>, PoolAllocator<int>, BlockListSummary<SumValue>> SumBlocks;
+        if(!runTest<SumBlocks>(seed, Workload::Random, "block-sum", &checkFindPrefix<SumBlocks>))   return 1;
+    }
+
+    if(!runLargeBulkTest())     return 1;
+    if(!runDeepBlockTest())     return 1;
 
     return 0;
 }
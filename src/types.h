@@ -2,17 +2,22 @@
 #ifndef TYPES_H_INCLUDED
 #define TYPES_H_INCLUDED
 
+#include <cstdint>
 #include <limits>
 #include <string>
 #include <stdexcept>
 
 typedef std::size_t     jobid_t;
 typedef std::size_t     procid_t;
+typedef std::uint64_t   tick_t;         // absolute point in time (number of ticks since the scheduler started)
+typedef std::uint32_t   strid_t;        // a string in a StringTable
 
 namespace
 {
     constexpr jobid_t   NoJob = std::numeric_limits<jobid_t>::max();
     constexpr procid_t  NoProc = std::numeric_limits<procid_t>::max();
+    constexpr strid_t   NoString = std::numeric_limits<strid_t>::max();
+    constexpr tick_t    NoTick = std::numeric_limits<tick_t>::max();
 }
 
 class SchedulerException : public std::runtime_error